@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+#include "nn/autobackend.h"
+#include "utils/cli.h"
+#include "utils/tuning_cache.h"
+
+/**
+ * @brief Model and threshold settings shared by all command line modes.
+ *
+ * Defaults match the original demo, every field can be overridden (e.g. `--model=yolov8n.onnx --conf=0.5`).
+ */
+struct ModelOptions {
+    std::string model_path = "../checkpoints/best.onnx";
+    std::string provider = OnnxProviders::CPUExecutionProvider;
+    std::string logid = "yolov8_inference";
+    float conf = 0.3f;
+    float iou = 0.45f;
+    float mask_threshold = 0.5f;
+    int conversion_code = cv::COLOR_BGR2RGB;
+    bool with_masks = true;       ///< `--outputs=boxes|kpts|masks|all`
+    bool with_keypoints = true;
+    std::vector<int> classes;     ///< `--classes=0,2:0.4,7`: allowlist, optionally with per-class thresholds
+    std::vector<float> class_conf;
+    OnnxSessionConfig session;    ///< `--intra-threads=N`, `--parallel-exec`, `--low-memory`, `--arena-mb=N`
+    /**
+     * @brief `--tuned[=cache.tsv]`: settings `--autotune` stored for this model on this host. Their session
+     * settings are already in `session` (explicit flags win), modes apply batch size and pipeline depth themselves.
+     */
+    bool has_tuned = false;
+    TunedConfig tuned;
+
+    static ModelOptions fromArgs(const CliArgs& args);
+    PredictParams params() const;
+};
+
+/**
+ * @brief `--threads=N`: one thread budget for the whole process. Must run before any model is created.
+ *
+ * Sessions share ORT's global intra-op pool of N threads (non-spinning), Helmsman's own ThreadPool::global()
+ * gets N workers and OpenCV's internal threading is turned off, so pre/postprocessing runs on our pool instead
+ * of a third set of threads. Without `--threads` every session keeps its own default pools.
+ * `--cpus=0-7,16-23` restricts the whole process (every thread created later) to those CPUs.
+ */
+void apply_thread_budget(const CliArgs& args);
+
+/**
+ * @brief `--serve[=socket]`: keeps one model loaded and serves HelmsmanClient requests until SIGINT/SIGTERM.
+ * `--timeout-ms` is the deadline of requests that don't bring their own.
+ */
+int run_serve(const CliArgs& args);
+
+/**
+ * @brief `--batch=<dir|list.txt>`: headless reprocessing of an image archive.
+ *
+ * Images are decoded on a thread pool (`--decode-threads`), run through `predict_batch` (`--batch-size`)
+ * and written as JSON Lines or binary records (`--format=jsonl|bin`, `--out=file`, stdout by default).
+ * Prints the aggregate throughput to stderr. `--refine=second.onnx` runs every detection crop (of `--classes`, if
+ * given) through a classify or pose model in batches (CropCascade); it needs `--format=jsonl`.
+ * `--models=b.onnx,c.onnx` runs more models on the same preprocessed batches (MultiModelRunner), each writing
+ * a file next to `--out`.
+ */
+int run_batch(const CliArgs& args);
+
+/**
+ * @brief `--realtime <camera|file|url>`: latency-bounded live inference.
+ *
+ * Always infers the newest frame, drops frames older than `--budget-ms` and degrades the work per frame
+ * (no masks, smaller input for dynamic models) while over budget. Prints grab/drop counts and latency when done.
+ * `--abort-late` aborts frames at capture time + budget instead of finishing them late.
+ * `--escalate=larger.onnx` sends frames the model is unsure about to a larger one (ModelCascade, `--band`,
+ * `--min-ambiguous`, `--count-jump`, `--escalate-regions`). `--adaptive-res` picks the input size of dynamic-shape models
+ * per frame from the previous frame's box sizes (ResolutionController, `--min-object-px`, `--res-target-ms`).
+ */
+int run_realtime(const CliArgs& args);
+
+/**
+ * @brief `--multi <source>... | --streams=list.txt`: many video streams on a few shared sessions (`--sessions`),
+ * with frames batched across streams, per-stream priorities and fps caps. Prints per-stream stats.
+ * `--numa` loads the sessions once per NUMA node, pins them to it and routes every stream to one node.
+ */
+int run_multi_stream(const CliArgs& args);
+
+/**
+ * @brief `--autotune[=images/|list.txt|video.mp4]`: benchmarks intra-op threads, execution mode, batch size and
+ * pipeline depth on the model (with the given inputs, or noise) and stores the best in the tuning cache
+ * (`--tune-cache`, default_tuning_cache_path()), keyed by model fingerprint and CPU. Other modes load it with `--tuned`.
+ */
+int run_autotune(const CliArgs& args);
+
+/**
+ * @brief `--soak[=video/test.mp4]`: loops predict_once, predict_batch and rendering over the video for
+ * `--soak-minutes`, samples RSS, heap, open fds, threads and per-stage latency every `--sample-seconds`, and compares
+ * the last quarter of the run against the first one after `--warmup-seconds`. Writes a TSV report (`--report`) and
+ * returns 3 if memory, handles or latency grew beyond `--max-rss-growth-mb`, `--max-fd-growth`, `--max-thread-growth`
+ * or `--max-latency-drift`.
+ */
+int run_soak(const CliArgs& args);
+
+/**
+ * @brief `--capture=trace.hfa <source>`: writes the decoded frames of a source to a frame archive, or with `--blobs`
+ * the preprocessed network inputs of the model (`--max-frames=N`, Ctrl+C stops live sources).
+ */
+int run_capture(const CliArgs& args);
+
+/**
+ * @brief `--replay=trace.hfa`: runs the model over a frame archive straight from the mapping, `--loops` times, and
+ * prints per-stage latency: preprocessing and inference+postprocessing for frames (`--once` times predict_once),
+ * inference+postprocessing only for blobs. Frame archives also work as a source in every video mode.
+ */
+int run_replay(const CliArgs& args);
+
+/**
+ * @brief `--raw=WxH`: headerless BGR24 or NV12 frames (`--pix-fmt`) from stdin or a named pipe (`--input`), results
+ * streamed to stdout as JSON lines (or `--out`, `--format`) and flushed after every `--batch-size` frames. Frames are read
+ * into reused buffers on a reader thread while the previous batch is in the model; logs go to stderr.
+ */
+int run_raw(const CliArgs& args);
@@ -11,12 +11,18 @@ namespace MetadataConstants {
     inline const std::string TASK = "task";
     inline const std::string BATCH = "batch";
     inline const std::string NAMES = "names";
+    inline const std::string KPT_SHAPE = "kpt_shape";
+    inline const std::string END2END = "end2end";
 }
 
 namespace OnnxProviders {
     inline const std::string CPU = "cpu";
     inline const std::string CUDA = "cuda";
     inline const std::string CPUExecutionProvider = "CPUExecutionProvider";
+    inline const std::string DNNL = "dnnl";
+    inline const std::string OPENVINO = "openvino";
+    inline const std::string XNNPACK = "xnnpack";
+    inline const std::string AUTO = "auto";    ///< benchmark the available CPU providers and keep the fastest
 }
 
 namespace OnnxInitializers
@@ -0,0 +1,98 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "autobackend.h"
+
+/**
+ * @brief Batching window of the AsyncPredictor scheduler.
+ */
+struct AsyncPredictorConfig {
+    int max_batch = 8;                              ///< Max number of requests coalesced into one forward() call.
+    std::chrono::microseconds max_delay{ 2000 };    ///< Max time the oldest pending request waits for the batch to fill.
+    size_t max_queue = 256;                         ///< submit() blocks while this many requests are pending (0 - unbounded).
+};
+
+struct AsyncPredictorStats {
+    uint64_t requests = 0;      ///< Requests completed (successfully or not).
+    uint64_t batches = 0;       ///< forward() batches executed.
+    uint64_t failed = 0;        ///< Requests completed with an exception.
+    uint64_t timed_out = 0;     ///< Of those, requests whose PredictParams::deadline passed (DeadlineExceededError).
+    double mean_batch_size() const { return batches ? static_cast<double>(requests) / batches : 0.0; }
+};
+
+/**
+ * @brief Asynchronous front end for AutoBackendOnnx with dynamic micro-batching.
+ *
+ * Requests from any number of threads are queued; a single scheduler thread waits until either `max_batch`
+ * requests are pending or the oldest one has waited `max_delay`, runs them through one `predict_batch` call
+ * and fans the results back out to the futures/callbacks.
+ *
+ * Batching only pays off for graphs exported with a dynamic (or > 1) batch dimension, see getMaxBatch().
+ * Requests with a PredictParams::deadline that expire in the queue are failed without running, and requests
+ * whose deadline passed by the time their batch finished get DeadlineExceededError instead of late results.
+ */
+class AsyncPredictor {
+public:
+    using Callback = std::function<void(std::vector<YoloResults> results, std::exception_ptr error)>;
+
+    AsyncPredictor(AutoBackendOnnx& model, AsyncPredictorConfig config = {});
+    ~AsyncPredictor();
+
+    AsyncPredictor(const AsyncPredictor&) = delete;
+    AsyncPredictor& operator=(const AsyncPredictor&) = delete;
+
+    /**
+     * @brief Queues an image for prediction.
+     *
+     * The image is referenced, not copied - it must not be modified until the result is ready.
+     *
+     * @return A future that receives the detected objects or the exception thrown while predicting.
+     */
+    std::future<std::vector<YoloResults>> submit(const cv::Mat& image, const PredictParams& params);
+    /**
+     * @brief Queues an image for prediction, `callback` is invoked on the scheduler thread when done.
+     */
+    void submit(const cv::Mat& image, const PredictParams& params, Callback callback);
+
+    /**
+     * @brief Stops accepting requests, finishes the pending ones and joins the scheduler thread.
+     */
+    void shutdown();
+
+    AsyncPredictorStats getStats();
+
+private:
+    struct Request {
+        cv::Mat image;
+        PredictParams params;
+        std::promise<std::vector<YoloResults>> promise;
+        Callback callback;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    void enqueue(Request&& request);
+    void run();
+    void process(std::vector<Request>& batch);
+
+    AutoBackendOnnx& model_;
+    AsyncPredictorConfig config_;
+    size_t max_batch_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable space_cv_;
+    std::deque<Request> queue_;
+    bool stopping_ = false;
+    AsyncPredictorStats stats_;
+    std::thread worker_;
+};
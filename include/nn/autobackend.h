@@ -1,11 +1,16 @@
 #pragma once
+#include <atomic>
 #include <filesystem>
+#include <functional>
 #include <vector>
 #include <unordered_map>
 #include <opencv2/core/mat.hpp>
 
 #include "onnx_model_base.h"
 #include "../constants.h"
+#include "../utils/class_filter.h"
+
+class ThreadPool;
 
 /**
  * @brief Represents the results of YOLO prediction.
@@ -19,21 +24,68 @@ struct YoloResults {
     cv::Rect_<float> bbox;            ///< The bounding box of the detected object.
     cv::Mat mask;                     ///< The semantic segmentation mask (if available).
     std::vector<float> keypoints{};   ///< Keypoints representing the object's pose (if available).
+    int sub_class_idx = -1;           ///< Class assigned by a second-stage classifier (see CropCascade), -1 - none.
+    float sub_conf{};                 ///< Confidence of the second-stage class.
 };
 
 struct ImageInfo {
     cv::Size raw_size;  // add additional attrs if you need
+    cv::Size input_size;  ///< letterboxed network input size, empty - the model's default (getCvSize())
+    Deadline deadline;    ///< postprocessing gives up with DeadlineExceededError once this passes, default - none
+};
+
+/**
+ * @brief Per-call prediction parameters.
+ *
+ * Bundles the thresholds `predict_once` takes as separate arguments so that calls can be queued
+ * and batched together (see `predict_batch` and `AsyncPredictor`).
+ */
+struct PredictParams {
+    float conf = 0.25f;               ///< The confidence threshold for object detection.
+    float iou = 0.7f;                 ///< The IoU threshold for non-maximum suppression.
+    float mask_threshold = 0.5f;      ///< The threshold for the semantic segmentation mask.
+    int conversionCode = -1;          ///< Optional color conversion code (e.g. cv::COLOR_BGR2RGB), -1 - no conversion.
+    bool with_masks = true;           ///< Segmentation models: decode instance masks (boxes only if false).
+                                      ///< predict_batch doesn't even fetch the protos when no image of a forward() call wants masks.
+    bool with_keypoints = true;       ///< Pose models: scale and return keypoints (boxes only if false).
+    std::vector<int> classes;         ///< Class allowlist, empty - all classes. Other score columns are never read.
+    std::vector<float> class_conf;    ///< Per-class thresholds parallel to `classes`, missing or <= 0 - `conf`.
+    cv::Size imgsz;                   ///< Network input size for models with dynamic height/width, empty - getCvSize().
+    Deadline deadline;                ///< Give up with DeadlineExceededError once this passes, default - none. Checked between
+                                      ///< preprocessing, forward() (which is terminated), decoding and mask decoding.
+                                      ///< Images sharing a forward() call are only abandoned once the latest of them expired.
+};
+
+/**
+ * @brief Where a model's memory goes, peaks over its lifetime (see AutoBackendOnnx::getMemoryStats()).
+ */
+struct ModelMemoryStats {
+    size_t model_file_bytes = 0;         ///< the .onnx file; the session holds its weights at least once
+    size_t peak_input_bytes = 0;         ///< largest input blob of one forward() call
+    size_t peak_output_bytes = 0;        ///< largest set of output tensors of one forward() call
+    size_t peak_mask_bytes = 0;          ///< largest total of the decoded masks of one image
+    size_t peak_mask_scratch_bytes = 0;  ///< largest temporary buffers for decoding one mask
 };
 
 
 class AutoBackendOnnx : public OnnxModelBase {
 public:
+    /**
+     * @brief Receives the results of image `index` as soon as they are decoded, on a pool thread (calls for different
+     * images run concurrently). The results are released when it returns.
+     */
+    using ResultSink = std::function<void(size_t index, std::vector<YoloResults>& results)>;
+
     // constructors
     AutoBackendOnnx(const char* modelPath, const char* logid, const char* provider,
         const std::vector<int>& imgsz, const int& stride,
         const int& nc, std::unordered_map<int, std::string> names);
 
     AutoBackendOnnx(const char* modelPath, const char* logid, const char* provider);
+    /**
+     * @brief Same as above with extra session settings, e.g. prepacked weights shared with other sessions.
+     */
+    AutoBackendOnnx(const char* modelPath, const char* logid, const char* provider, const OnnxSessionConfig& config);
 
     // getters
     virtual const std::vector<int>& getImgsz();
@@ -46,6 +98,31 @@ public:
     virtual const int& getHeight();
     virtual const cv::Size& getCvSize();
     virtual const std::string& getTask();
+    /**
+     * @brief Fixed batch size of the exported graph or -1 if the batch dimension is dynamic.
+     */
+    virtual int64_t getMaxBatch();
+    /**
+     * @brief Whether the exported graph accepts inputs of any height/width (`dynamic=True` export).
+     */
+    virtual bool hasDynamicInputSize();
+    /**
+     * @brief Network input size used for a requested `imgsz`: the requested size rounded up to the stride
+     * for dynamic models, getCvSize() otherwise or if nothing was requested.
+     */
+    virtual cv::Size resolveInputSize(const cv::Size& imgsz);
+    /**
+     * @brief Whether the graph already contains the decode and NMS (`end2end` metadata or a `[bs, max_det, 6 + extra]`
+     * first output: x1, y1, x2, y2, score, class, then mask coefficients or keypoints). Such outputs skip the
+     * C++ decode and NMS entirely.
+     */
+    virtual bool isEndToEnd();
+    /**
+     * @brief Pool for the per-image pre/postprocessing of predict_batch, nullptr - ThreadPool::global().
+     *
+     * A replica pinned to one NUMA node should get a pool pinned to the same node. The pool must outlive the model.
+     */
+    void setThreadPool(ThreadPool* pool);
     /**
      * @brief Runs object detection on an input image.
      *
@@ -65,19 +142,118 @@ public:
     virtual std::vector<YoloResults> predict_once(const std::filesystem::path& imagePath, float& conf, float& iou, float& mask_threshold, int conversionCode = -1, bool verbose = true);
     virtual std::vector<YoloResults> predict_once(const std::string& imagePath, float& conf, float& iou, float& mask_threshold, int conversionCode = -1, bool verbose = true);
 
+    /**
+     * @brief Runs prediction on several images with as few `forward()` calls as the graph allows.
+     *
+     * Graphs exported with a dynamic batch dimension get all images in a single call, graphs with a fixed
+     * batch size are fed in chunks of that size (the last chunk is zero-padded).
+     * Unlike `predict_once`, the input images are never modified in place. If any chunk throws (e.g. on its
+     * deadline), the whole call throws; callers that need per-chunk outcomes call it once per getMaxBatch() images.
+     *
+     * @param images The input images.
+     * @param params Either one PredictParams per image or a single one shared by all of them.
+     *               Images fed through one `forward()` call share an input size, taken from the first image's `imgsz`.
+     *
+     * @return Detected objects for every input image, in input order.
+     */
+    virtual std::vector<std::vector<YoloResults>> predict_batch(const std::vector<cv::Mat>& images,
+        const std::vector<PredictParams>& params);
+    /**
+     * @brief Same as above, but every image's results go to `sink` instead of being returned, so at most one image per
+     * pool thread holds its masks at a time.
+     */
+    virtual void predict_batch(const std::vector<cv::Mat>& images, const std::vector<PredictParams>& params,
+        const ResultSink& sink);
+
+    /**
+     * @brief First half of predict_batch: preprocesses images [begin, end) into one NCHW `blob` (resized to the
+     * batch size the graph needs, returned in `batch_size`). Returns the network input size used.
+     */
+    virtual cv::Size fill_batch(const std::vector<cv::Mat>& images, size_t begin, size_t end,
+        const std::vector<PredictParams>& params, std::vector<float>& blob, int64_t& batch_size);
+    /**
+     * @brief Second half of predict_batch: runs forward() on a blob filled by fill_batch() (possibly by another
+     * model with the same input, see MultiModelRunner) and postprocesses images [begin, end) into `results[i]`.
+     * The blob is only read, so several models may run on it concurrently. With a `sink`, `results[i]` is handed to
+     * it and released right away.
+     */
+    virtual void infer_batch(std::vector<float>& blob, int64_t batch_size, const cv::Size& new_shape,
+        const std::vector<cv::Mat>& images, size_t begin, size_t end, const std::vector<PredictParams>& params,
+        std::vector<std::vector<YoloResults>>& results, const ResultSink& sink = ResultSink());
+
+    /**
+     * @brief forward() and postprocessing of an already preprocessed blob, e.g. one replayed from a FrameArchive.
+     *
+     * @param blob `batch_size` planar CHW images of `input_size` (a size the model accepts), as fill_batch() writes them.
+     * @param channels Planes per image in `blob`; must be getCh(), std::invalid_argument otherwise.
+     * @param raw_sizes Size of the frame each blob image was letterboxed from; results are mapped back to it.
+     */
+    std::vector<std::vector<YoloResults>> predict_blob(float* blob, int64_t batch_size, const cv::Size& input_size,
+        int channels, const std::vector<cv::Size>& raw_sizes, const std::vector<PredictParams>& params);
+
+    /**
+     * @brief Allocation breakdown of this model, see ModelMemoryStats.
+     */
+    ModelMemoryStats getMemoryStats();
+
+    /**
+     * @brief Letterboxes the image to `new_shape` and writes it as CHW floats into `blob`.
+     *
+     * `blob` must have room for getCh() * new_shape.area() values.
+     */
+    virtual void preprocess(const cv::Mat& image, float* blob, const cv::Size& new_shape);
+    /**
+     * @brief Decodes the `batch_idx`-th image of the raw model outputs into `results` based on the task.
+     */
+    virtual void postprocess(std::vector<Ort::Value>& outputTensors, int64_t batch_idx, const ImageInfo& image_info,
+        const PredictParams& params, std::vector<YoloResults>& results);
+
     virtual void fill_blob(cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape);
+    virtual void fill_blob(const cv::Mat& image, float* blob);
     virtual void postprocess_masks(cv::Mat& output0, cv::Mat& output1, ImageInfo para, std::vector<YoloResults>& output,
         int& class_names_num, float& conf_threshold, float& iou_threshold,
-        int& iw, int& ih, int& mw, int& mh, int& masks_features_num, float mask_threshold = 0.50f);
+        int& masks_features_num, float mask_threshold = 0.50f, bool with_masks = true,
+        const ClassFilter& class_filter = ClassFilter());
 
     virtual void postprocess_detects(cv::Mat& output0, ImageInfo image_info, std::vector<YoloResults>& output,
-        int& class_names_num, float& conf_threshold, float& iou_threshold);
+        int& class_names_num, float& conf_threshold, float& iou_threshold, const ClassFilter& class_filter = ClassFilter());
     virtual void postprocess_kpts(cv::Mat& output0, ImageInfo& image_info, std::vector<YoloResults>& output,
-                                  int& class_names_num, float& conf_threshold, float& iou_threshold);
+                                  int& class_names_num, float& conf_threshold, float& iou_threshold, bool with_keypoints = true,
+                                  const ClassFilter& class_filter = ClassFilter());
+    /**
+     * @brief Converts the rows of an end-to-end output (`[max_det, 6 + extra]` for one image) above the confidence
+     * threshold into results. `output1` holds the protos of segmentation models and is ignored otherwise.
+     */
+    virtual void postprocess_end2end(const cv::Mat& output0, const cv::Mat& output1, const ImageInfo& image_info,
+        const PredictParams& params, std::vector<YoloResults>& output, const ClassFilter& class_filter = ClassFilter());
+    /**
+     * @brief Top-1 class of a classification output (`probs` holds `class_names_num` probabilities of one image),
+     * reported as a single result covering the whole image if it clears the threshold.
+     */
+    virtual void postprocess_classify(const float* probs, int class_names_num, const ImageInfo& image_info,
+        const PredictParams& params, std::vector<YoloResults>& output, const ClassFilter& class_filter = ClassFilter());
+    /**
+     * @brief Fills the masks of `output` (boxes already clipped to the image) from per-instance mask `coefficients`
+     * and the protos in `output1` (`[1, masks_features_num, mh, mw]`).
+     */
+    virtual void decode_masks(const cv::Mat& output1, const ImageInfo& image_info,
+        const std::vector<std::vector<float>>& coefficients, float mask_threshold, std::vector<YoloResults>& output);
     static void _get_mask2(const cv::Mat& mask_info, const cv::Mat& mask_data, const ImageInfo& image_info, cv::Rect bound, cv::Mat& mask_out,
         float& mask_thresh, int& iw, int& ih, int& mw, int& mh, int& masks_features_num, bool round_downsampled = false);
+    /**
+     * @brief Low-memory variant of _get_mask2: maps the box straight back onto the proto-resolution logits with one
+     * bilinear warp and thresholds there, so only box-sized buffers are allocated (instead of input- and image-sized
+     * float masks). Edges may differ from _get_mask2 by a pixel.
+     */
+    static void _get_mask_box_local(const cv::Mat& masks_features, const cv::Mat& proto, const ImageInfo& image_info,
+        const cv::Rect& bound, cv::Mat& mask_out, float mask_thresh, int iw, int ih, int mw, int mh);
 
 protected:
+    // infer_batch() on a raw blob: images [begin, end) were letterboxed from frames of raw_size(i)
+    void infer_blob(float* blob, size_t blob_size, int64_t batch_size, const cv::Size& new_shape, size_t begin, size_t end,
+        const std::function<cv::Size(size_t)>& raw_size, const std::vector<PredictParams>& params,
+        std::vector<std::vector<YoloResults>>& results, const ResultSink& sink);
+
     std::vector<int> imgsz_;
     int stride_ = OnnxInitializers::UNINITIALIZED_STRIDE;
     int nc_ = OnnxInitializers::UNINITIALIZED_NC; //
@@ -86,5 +262,12 @@ protected:
     std::vector<int64_t> inputTensorShape_;
     cv::Size cvSize_;
     std::string task_;
+    ThreadPool* pool_ = nullptr;
+    int kpt_values_ = 0;  // values per pose instance (kpt_shape product), 0 - unknown
+    bool end2end_ = false;
+    std::atomic<size_t> peakInputBytes_{ 0 };
+    std::atomic<size_t> peakOutputBytes_{ 0 };
+    std::atomic<size_t> peakMaskBytes_{ 0 };
+    std::atomic<size_t> peakMaskScratchBytes_{ 0 };
     //cv::MatSize cvMatSize_;
 };
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <onnxruntime/onnxruntime_cxx_api.h>
+
+/**
+ * @brief Point in time after which a result is no longer wanted. A default-constructed value means no deadline.
+ */
+using Deadline = std::chrono::steady_clock::time_point;
+
+inline bool has_deadline(const Deadline& deadline) {
+    return deadline != Deadline();
+}
+
+/**
+ * @brief Thrown when a call's deadline has passed; stage() names where it was noticed
+ * ("queue", "preprocess", "forward", "decode", "masks", ...).
+ */
+class DeadlineExceededError : public std::runtime_error {
+public:
+    explicit DeadlineExceededError(const std::string& stage);
+    const std::string& stage() const;
+
+private:
+    std::string stage_;
+};
+
+/**
+ * @brief Throws DeadlineExceededError if `deadline` is set and has passed.
+ */
+void check_deadline(const Deadline& deadline, const char* stage);
+
+/**
+ * @brief Background thread that stops `Session::Run()` calls whose deadline has passed.
+ *
+ * ORT checks the terminate flag of the RunOptions between kernels, so an expired call gives up within about one
+ * node's execution time instead of finishing the whole graph. The thread is started on first use.
+ */
+class RunWatchdog {
+public:
+    /**
+     * @brief Sets `options`' terminate flag once `deadline` passes, until the Watch is destroyed.
+     */
+    class Watch {
+    public:
+        Watch(const Deadline& deadline, Ort::RunOptions& options);
+        ~Watch();
+
+        Watch(const Watch&) = delete;
+        Watch& operator=(const Watch&) = delete;
+
+    private:
+        uint64_t id_;
+    };
+
+    static RunWatchdog& global();
+
+private:
+    struct Entry {
+        Deadline deadline;
+        Ort::RunOptions* options;
+    };
+
+    RunWatchdog();
+    uint64_t add(const Deadline& deadline, Ort::RunOptions& options);
+    void remove(uint64_t id);
+    void loop();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<uint64_t, Entry> entries_;
+    uint64_t next_id_ = 0;
+};
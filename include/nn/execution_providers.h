@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <onnxruntime/onnxruntime_cxx_api.h>
+
+/**
+ * @brief What a provider needs to know about the session it is appended to.
+ */
+struct ExecutionProviderContext {
+    /**
+     * @brief Threads the session may use for compute: its intra-op pool size (OnnxSessionConfig, `--threads`, tuned
+     * settings), or else the CPUs the process is allowed to run on.
+     */
+    int intra_op_threads = 1;
+};
+
+/**
+ * @brief How to attach one execution provider to a session, see register_execution_provider().
+ */
+struct ExecutionProviderPlugin {
+    std::string name;                  ///< name used in `--provider`, e.g. "dnnl"
+    std::string ort_name;              ///< as listed by Ort::GetAvailableProviders(), e.g. "DnnlExecutionProvider"
+    bool cpu = true;                   ///< runs on the host CPU, i.e. a candidate for `--provider=auto`
+    /**
+     * @brief Appends the provider to the options. Throws (Ort::Exception or any std::exception) if it can't be used after all.
+     */
+    std::function<void(Ort::SessionOptions&, const ExecutionProviderContext&)> append;
+};
+
+/**
+ * @brief Adds or replaces (by name) a provider. Built in: cpu, cuda, dnnl (oneDNN), openvino (CPU device), xnnpack.
+ */
+void register_execution_provider(const ExecutionProviderPlugin& plugin);
+
+/**
+ * @brief Plugin registered under `name` (or whose ort_name is `name`), nullptr if there is none.
+ */
+const ExecutionProviderPlugin* find_execution_provider(const std::string& name);
+
+/**
+ * @brief Whether the linked ONNX Runtime build contains the provider.
+ */
+bool is_execution_provider_available(const ExecutionProviderPlugin& plugin);
+
+/**
+ * @brief Splits an ordered fallback list such as "openvino,dnnl,cpu". Throws std::runtime_error for unknown names.
+ */
+std::vector<std::string> parse_execution_providers(const std::string& providers);
+
+/**
+ * @brief CPU providers of this ORT build in registration order, for `--provider=auto`; "cpu" is always last.
+ */
+std::vector<std::string> auto_execution_providers();
@@ -1,9 +1,54 @@
 #pragma once
 #include <onnxruntime/onnxruntime_cxx_api.h>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "deadline.h"
+
+/**
+ * @brief Optional session settings, mostly for running several sessions in one process.
+ */
+struct OnnxSessionConfig {
+    /**
+     * @brief Prepacked (re-laid-out) GEMM/conv weights are stored here instead of in each session, so sessions of
+     * the same model share one copy. Use OnnxModelBase::sharedPrepackedWeights() for the process-wide container.
+     */
+    std::shared_ptr<Ort::PrepackedWeightsContainer> prepacked_weights;
+    /**
+     * @brief Allocate from an arena registered once on the environment instead of one arena per session.
+     */
+    bool use_env_allocators = false;
+    /**
+     * @brief Pins the session's intra-op pool to these CPUs: one thread per CPU, the thread calling Run() is expected
+     * to run on the first one. Empty - ORT decides. Ignored under OnnxModelBase::useGlobalThreadPools().
+     */
+    std::vector<int> intra_op_cpus;
+    int intra_op_threads = 0;          ///< size of the session's intra-op pool, 0 - ORT default; ignored like intra_op_cpus
+    bool parallel_execution = false;   ///< ORT_PARALLEL: independent graph branches run concurrently on an inter-op pool
+    /**
+     * @brief Trades speed for footprint: no memory-pattern planning, and no CPU arena unless the env arena is used
+     * (use_env_allocators or arena_max_bytes), which is then shrunk back after every Run(). AutoBackendOnnx also decodes masks
+     * box-local instead of through full-image float buffers.
+     */
+    bool low_memory = false;
+    /**
+     * @brief Caps the env arena (implies use_env_allocators), 0 - unlimited. The env arena is registered once per
+     * process, so the first session that registers it decides the cap.
+     */
+    size_t arena_max_bytes = 0;
+};
+
+/**
+ * @brief Process-wide ONNX Runtime thread pools, see OnnxModelBase::useGlobalThreadPools().
+ */
+struct OnnxThreadingConfig {
+    int intra_op_threads = 0;       ///< 0 - ORT default (one per physical core)
+    int inter_op_threads = 0;       ///< only used by ORT_PARALLEL execution, 0 - ORT default
+    bool allow_spinning = false;    ///< idle workers spin for a while before sleeping; burns cores other pools need
+};
+
 /*
  * This interface must provide only required arguments to load any onnx model regarding specific info -
  *  - i.e. modelPath will always be required, provider like "cpu" or "cuda" the same, since these are parameters you need
@@ -11,29 +56,89 @@
  */
 class OnnxModelBase {
 public:
+    /**
+     * @param provider Execution provider, or an ordered fallback list such as "openvino,dnnl,cpu" (cpu is always
+     * appended as the last resort), or "auto" to benchmark the available CPU providers and keep the fastest.
+     * See execution_providers.h for the names and for registering more.
+     */
     OnnxModelBase(const char* modelPath, const char* logid, const char* provider);
+    OnnxModelBase(const char* modelPath, const char* logid, const char* provider, const OnnxSessionConfig& config);
     //OnnxModelBase();  // no default constructor should be there
-    //virtual ~OnnxModelBase();
+    virtual ~OnnxModelBase();
     virtual const std::vector<std::string>& getInputNames(); // = 0
     virtual const std::vector<std::string>& getOutputNames();
     virtual const std::vector<const char*> getOutputNamesCStr();
     virtual const std::vector<const char*> getInputNamesCStr();
+    /**
+     * @brief Shapes of the graph inputs as reported by the session (dynamic dims are <= 0).
+     */
+    virtual const std::vector<std::vector<int64_t>>& getInputShapes();
+    /**
+     * @brief Shapes of the graph outputs as reported by the session (dynamic dims are <= 0).
+     */
+    virtual const std::vector<std::vector<int64_t>>& getOutputShapes();
     virtual const Ort::ModelMetadata& getModelMetadata();
     virtual const std::unordered_map<std::string, std::string>& getMetadata();
     virtual const char* getModelPath();
     virtual const Ort::Session& getSession();
+    /**
+     * @brief Execution provider the session ended up on, after fallbacks and `auto` selection (e.g. "dnnl").
+     */
+    const std::string& getProvider() const;
+    /**
+     * @brief Median latency measured by `--provider=auto` on zero inputs, -1 if the provider was not benchmarked.
+     */
+    double getProviderLatencyMs() const;
+    /**
+     * @brief Whether the session was created with OnnxSessionConfig::low_memory.
+     */
+    bool isLowMemory() const;
     //virtual std::vector<Ort::Value> forward(std::vector<Ort::Value> inputTensors);
     virtual std::vector<Ort::Value> forward(std::vector<Ort::Value>& inputTensors);
+    /**
+     * @brief Same as above, but fetches only the given outputs (a subset of getOutputNamesCStr(), in any order).
+     */
+    virtual std::vector<Ort::Value> forward(std::vector<Ort::Value>& inputTensors, const std::vector<const char*>& outputNames);
+    /**
+     * @brief Same as above, but `Run()` is terminated once `deadline` passes and DeadlineExceededError is thrown.
+     * Without a deadline this is the plain overload.
+     */
+    virtual std::vector<Ort::Value> forward(std::vector<Ort::Value>& inputTensors, const std::vector<const char*>& outputNames,
+                                            const Deadline& deadline);
+
+    /**
+     * @brief Process-wide prepacked weights container (created on first use), see OnnxSessionConfig.
+     */
+    static std::shared_ptr<Ort::PrepackedWeightsContainer> sharedPrepackedWeights();
+    /**
+     * @brief Makes all models created afterwards run on one set of ORT thread pools instead of per-session pools.
+     *
+     * Must be called before the first model is created (ORT has a single environment per process);
+     * returns false and changes nothing otherwise.
+     */
+    static bool useGlobalThreadPools(const OnnxThreadingConfig& config);
+
     Ort::Session session{ nullptr };
 
 protected:
     const char* modelPath_;
+    std::string provider_;
+    double providerLatencyMs_ = -1.0;
+    bool lowMemory_ = false;
+    bool shrinkArena_ = false;  // Run() returns the arena's free chunks to the system afterwards
     Ort::Env env{ nullptr };
+    std::shared_ptr<Ort::Env> globalEnv;  // set when the process uses global thread pools
+    std::shared_ptr<Ort::PrepackedWeightsContainer> prepackedWeights;  // must outlive the session
 
     std::vector<std::string> inputNodeNames;
+    std::vector<std::vector<int64_t>> inputNodeShapes;
     std::vector<std::string> outputNodeNames;
+    std::vector<std::vector<int64_t>> outputNodeShapes;
     Ort::ModelMetadata model_metadata{ nullptr };
     std::unordered_map<std::string, std::string> metadata;
     std::vector<const char*> outputNamesCStr;
     std::vector<const char*> inputNamesCStr;
+
+private:
+    void configureRun(Ort::RunOptions& runOptions) const;
 };
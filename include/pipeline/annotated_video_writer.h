@@ -0,0 +1,77 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "nn/autobackend.h"
+#include "utils/plotting.h"
+
+struct AnnotatedVideoWriterConfig {
+    std::string fourcc = "mp4v";
+    double fps = 30.0;
+    size_t max_queue = 8;             ///< frames waiting to be rendered
+    bool drop_when_full = false;      ///< drop new frames instead of blocking the caller when the queue is full
+};
+
+struct AnnotatedVideoWriterStats {
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    double render_ms = 0.0;           ///< total time spent drawing
+    double encode_ms = 0.0;           ///< total time spent in cv::VideoWriter::write
+};
+
+/**
+ * @brief Draws results onto frames and encodes them to a video file on a dedicated thread.
+ *
+ * The inference loop hands over a frame together with its results and moves on; rendering and encoding
+ * (usually as expensive as inference itself) happen in the background. The frame is kept by reference,
+ * so the caller must not write into it afterwards (pass it with std::move or a fresh cv::Mat per frame).
+ */
+class AnnotatedVideoWriter {
+public:
+    AnnotatedVideoWriter(const std::string& path, const cv::Size& frame_size, const ResultPlotter& plotter,
+                         const AnnotatedVideoWriterConfig& config = AnnotatedVideoWriterConfig());
+    ~AnnotatedVideoWriter();
+
+    AnnotatedVideoWriter(const AnnotatedVideoWriter&) = delete;
+    AnnotatedVideoWriter& operator=(const AnnotatedVideoWriter&) = delete;
+
+    /**
+     * @brief Queues a frame for rendering. Returns false if the frame was dropped.
+     */
+    bool write(cv::Mat frame, std::vector<YoloResults> results);
+    /**
+     * @brief Renders and encodes all queued frames and finalizes the file.
+     */
+    void close();
+
+    AnnotatedVideoWriterStats getStats();
+
+private:
+    struct Item {
+        cv::Mat frame;
+        std::vector<YoloResults> results;
+    };
+
+    void worker();
+
+    AnnotatedVideoWriterConfig config_;
+    ResultPlotter plotter_;
+    cv::VideoWriter writer_;
+    cv::Size frame_size_;
+
+    std::deque<Item> queue_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    bool closing_ = false;
+    AnnotatedVideoWriterStats stats_;
+    std::thread thread_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+struct CropCascadeConfig {
+    std::vector<int> classes;          ///< first-stage classes whose boxes are refined, empty - all
+    float padding = 0.1f;              ///< each side of a box grows by this share of its size before cropping
+    int min_size = 8;                  ///< boxes smaller than this (in pixels, either side) are not refined
+    size_t max_crops = 64;             ///< per image, highest confidence first
+    PredictParams params;              ///< second-stage thresholds and color conversion, applied to crops of the original images
+};
+
+struct CropCascadeStats {
+    uint64_t images = 0;
+    uint64_t crops = 0;                ///< boxes sent to the second stage
+    uint64_t refined = 0;              ///< boxes that got a second-stage class or keypoints
+    double detect_ms = 0.0;
+    double refine_ms = 0.0;
+};
+
+/**
+ * @brief Detect-then-refine: boxes of a first-stage model are cropped and run through a second model in as few
+ * batched `forward()` calls as it allows.
+ *
+ * Second-stage classifiers set `YoloResults::sub_class_idx`/`sub_conf` of the box, pose models fill its
+ * `keypoints` (the best pose in the crop, in image coordinates). Crops are ROI views into the image, so the only
+ * copy of their pixels is the resize into the second model's input blob. Not thread-safe, use one cascade per thread.
+ */
+class CropCascade {
+public:
+    /**
+     * @param detector First stage, any detect/segment/pose model.
+     * @param refiner Second stage, a classify or pose model. Both must outlive the cascade.
+     */
+    CropCascade(AutoBackendOnnx& detector, AutoBackendOnnx& refiner, const CropCascadeConfig& config = CropCascadeConfig());
+
+    /**
+     * @brief Runs both stages on one image.
+     */
+    std::vector<YoloResults> predict(const cv::Mat& image, const PredictParams& params);
+    /**
+     * @brief Runs both stages on several images; the crops of all images share the second-stage batches.
+     */
+    std::vector<std::vector<YoloResults>> predict_batch(const std::vector<cv::Mat>& images, const std::vector<PredictParams>& params);
+    /**
+     * @brief Second stage only, for detections that came from elsewhere (one result list per image).
+     */
+    void refine(const std::vector<cv::Mat>& images, std::vector<std::vector<YoloResults>>& detections);
+
+    CropCascadeStats getStats() const;
+
+private:
+    AutoBackendOnnx& detector_;
+    AutoBackendOnnx& refiner_;
+    CropCascadeConfig config_;
+    CropCascadeStats stats_;
+};
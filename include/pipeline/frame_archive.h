@@ -0,0 +1,135 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "pipeline/frame_source.h"
+
+/*
+ * Frame archive (.hfa), host byte order, for replaying captured traces without decoding:
+ *
+ *  header, 64 bytes: char[8] "HLMSHFA1", uint32 kind, uint32 entry size, uint64 count, uint64 index offset, zero padding
+ *  payloads, each on a 64-byte boundary: frames as unpadded rows of pixels, blobs as planar CHW floats
+ *  index at `index offset`: count x FrameArchiveEntry
+ */
+
+enum class FrameArchiveKind : uint32_t {
+    FRAMES = 0,   ///< decoded frames (BGR as read from the source)
+    BLOBS = 1,    ///< preprocessed network inputs, see AutoBackendOnnx::fill_batch()
+};
+
+struct FrameArchiveEntry {
+    uint64_t offset = 0;        ///< payload position in the file
+    uint64_t bytes = 0;
+    int32_t rows = 0;           ///< frame size, or the network input size of a blob
+    int32_t cols = 0;
+    int32_t type = 0;           ///< cv type; blobs are CV_32FC(channels), stored planar
+    int32_t raw_rows = 0;       ///< size of the captured frame (a blob was letterboxed from it)
+    int32_t raw_cols = 0;
+    int32_t reserved = 0;
+    double timestamp_ms = 0.0;  ///< since the first frame
+};
+
+/**
+ * @brief Appends frames or blobs to a new .hfa file; the index is written by close() (or the destructor).
+ */
+class FrameArchiveWriter {
+public:
+    FrameArchiveWriter(const std::string& path, FrameArchiveKind kind);
+    ~FrameArchiveWriter();
+
+    FrameArchiveWriter(const FrameArchiveWriter&) = delete;
+    FrameArchiveWriter& operator=(const FrameArchiveWriter&) = delete;
+
+    void append(const cv::Mat& frame, double timestamp_ms);
+    /**
+     * @brief Appends one preprocessed image: `channels` planes of `input_size` floats, letterboxed from `raw_size`.
+     */
+    void appendBlob(const float* blob, const cv::Size& input_size, int channels, const cv::Size& raw_size, double timestamp_ms);
+    void close();
+
+    size_t size() const;
+    uint64_t bytes() const;
+
+private:
+    void writePayload(const void* data, size_t bytes, FrameArchiveEntry& entry);
+
+    std::string path_;
+    std::ofstream file_;
+    FrameArchiveKind kind_;
+    std::vector<FrameArchiveEntry> index_;
+    uint64_t offset_ = 0;
+    bool closed_ = false;
+};
+
+/**
+ * @brief Read-only view of a .hfa file, memory-mapped.
+ *
+ * The mapping is private copy-on-write, so frames can be handed to code that converts its input in place
+ * (predict_once) without touching the file; such writes cost a page copy.
+ */
+class FrameArchive {
+public:
+    /**
+     * @param preload Fault every page in up front (MAP_POPULATE), so a benchmark doesn't measure disk reads.
+     */
+    explicit FrameArchive(const std::string& path, bool preload = false);
+    ~FrameArchive();
+
+    FrameArchive(const FrameArchive&) = delete;
+    FrameArchive& operator=(const FrameArchive&) = delete;
+
+    FrameArchiveKind getKind() const;
+    size_t size() const;
+    const FrameArchiveEntry& entry(size_t i) const;
+    /**
+     * @brief Frame `i` as a cv::Mat header over the mapping, no copy. Valid as long as the archive.
+     */
+    cv::Mat frame(size_t i) const;
+    /**
+     * @brief Blob `i`, `channels * rows * cols` planar floats, for AutoBackendOnnx::predict_blob().
+     */
+    float* blob(size_t i) const;
+    /**
+     * @brief Mean frame rate of the capture, 0 if unknown.
+     */
+    double getFps() const;
+    const std::string& getPath() const;
+
+private:
+    std::string path_;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    FrameArchiveKind kind_ = FrameArchiveKind::FRAMES;
+    const FrameArchiveEntry* index_ = nullptr;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief FrameSource replaying a frame archive straight from the mapping: no decode, no copy.
+ */
+class ArchiveFrameSource : public FrameSource {
+public:
+    /**
+     * @param pace Deliver frames at their captured timestamps instead of as fast as they are read.
+     * @param loop Start over at the end instead of ending the stream.
+     */
+    explicit ArchiveFrameSource(const std::string& path, bool pace = false, bool loop = false);
+
+    bool read(cv::Mat& frame) override;
+    double getFps() const override;
+    cv::Size getFrameSize() const override;
+    bool isLive() const override;
+    const std::string& getName() const override;
+
+private:
+    FrameArchive archive_;
+    bool pace_;
+    bool loop_;
+    size_t next_ = 0;
+    std::chrono::steady_clock::time_point started_at_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+
+/**
+ * @brief A sequence of BGR frames: camera, video file, stream, ...
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief Reads the next frame into `frame`. Returns false at the end of the stream.
+     */
+    virtual bool read(cv::Mat& frame) = 0;
+    /**
+     * @brief Nominal frame rate, 0 if unknown.
+     */
+    virtual double getFps() const = 0;
+    virtual cv::Size getFrameSize() const = 0;
+    /**
+     * @brief Whether frames arrive in real time (cameras, streams, paced files) rather than as fast as they are read.
+     */
+    virtual bool isLive() const = 0;
+    virtual const std::string& getName() const = 0;
+};
+
+/**
+ * @brief FrameSource over cv::VideoCapture: a camera index ("0"), a video file or a stream URL.
+ */
+class VideoCaptureSource : public FrameSource {
+public:
+    /**
+     * @param pace_files Deliver file frames at the file's frame rate, like a camera would.
+     */
+    explicit VideoCaptureSource(const std::string& uri, bool pace_files = false);
+
+    bool read(cv::Mat& frame) override;
+    double getFps() const override;
+    cv::Size getFrameSize() const override;
+    bool isLive() const override;
+    const std::string& getName() const override;
+
+private:
+    std::string name_;
+    cv::VideoCapture capture_;
+    bool is_file_ = false;
+    bool pace_ = false;
+    double fps_ = 0.0;
+    cv::Size frame_size_;
+    std::chrono::steady_clock::time_point next_frame_;
+};
+
+/**
+ * @brief Opens `uri` as the matching FrameSource: a frame archive (`.hfa`, see ArchiveFrameSource) or cv::VideoCapture.
+ */
+std::unique_ptr<FrameSource> open_frame_source(const std::string& uri, bool pace_files = false);
@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One step of the quality ladder: the work done per frame.
+ */
+struct QualityLevel {
+    bool with_masks = true;   ///< decode instance masks (segmentation models)
+    double scale = 1.0;       ///< network input size relative to the model's default (dynamic-shape models only)
+
+    std::string describe() const;
+};
+
+struct LatencyGovernorConfig {
+    std::chrono::milliseconds budget{ 100 };   ///< end-to-end budget from capture to results
+    double smoothing = 0.2;                    ///< EWMA weight of the newest latency sample
+    double recover_ratio = 0.6;                ///< step back up once the EWMA stays below this share of the budget...
+    int recover_frames = 30;                   ///< ...for this many consecutive frames
+};
+
+struct LatencyGovernorStats {
+    uint64_t processed = 0;
+    uint64_t dropped_stale = 0;        ///< frames older than the budget before inference even started
+    uint64_t over_budget = 0;          ///< processed frames that still finished late
+    double mean_latency_ms = 0.0;
+    double max_latency_ms = 0.0;
+    std::vector<uint64_t> frames_per_level;
+};
+
+/**
+ * @brief Keeps end-to-end latency of a live pipeline within a budget.
+ *
+ * Frames that are already older than the budget are dropped outright. For the others the governor tracks
+ * a smoothed latency and walks down a quality ladder (fewer masks, smaller input) while it is over budget,
+ * and back up after a sustained period well below it.
+ */
+class LatencyGovernor {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param levels Quality ladder, best first. Must not be empty.
+     */
+    LatencyGovernor(const std::vector<QualityLevel>& levels, const LatencyGovernorConfig& config = LatencyGovernorConfig());
+
+    /**
+     * @brief Builds the ladder available for a model: masks are only worth dropping for segmentation models,
+     * and the input size can only shrink if the graph has dynamic height/width.
+     */
+    static std::vector<QualityLevel> makeLadder(bool has_masks, bool dynamic_input);
+
+    /**
+     * @brief Whether a frame captured at `captured_at` should still be processed. Counts the frame as dropped if not.
+     */
+    bool admit(clock::time_point captured_at);
+    /**
+     * @brief Records the end-to-end latency of a processed frame and adapts the quality level.
+     */
+    void record(clock::time_point captured_at, clock::time_point done_at);
+
+    const QualityLevel& level() const;
+    size_t levelIndex() const;
+    LatencyGovernorStats getStats() const;
+
+private:
+    std::vector<QualityLevel> levels_;
+    LatencyGovernorConfig config_;
+    size_t level_ = 0;
+    double ewma_ms_ = -1.0;
+    int calm_frames_ = 0;
+    double total_latency_ms_ = 0.0;
+    LatencyGovernorStats stats_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "pipeline/frame_source.h"
+
+/**
+ * @brief A frame handed out by LatestFrameGrabber.
+ */
+struct GrabbedFrame {
+    cv::Mat image;
+    uint64_t index = 0;                                   ///< position in the source, counting skipped frames
+    std::chrono::steady_clock::time_point captured_at;    ///< when the frame was grabbed from the source
+};
+
+struct LatestFrameGrabberStats {
+    uint64_t grabbed = 0;     ///< frames pulled from the source
+    uint64_t retrieved = 0;   ///< frames decoded and handed out
+    uint64_t skipped = 0;     ///< frames grabbed but never retrieved because a newer one arrived
+};
+
+/**
+ * @brief Keeps pulling frames from a cv::VideoCapture on its own thread and hands out only the newest one.
+ *
+ * The background thread calls `grab()` for every frame, but `retrieve()` (color conversion and copy) only for
+ * the first frame grabbed after the consumer asked for one: frames arriving while inference is busy are skipped
+ * at the cheapest point, and the consumer always gets a frame that is at most one grab old.
+ * Files are paced at their nominal FPS to behave like a live feed, cameras and streams are read as fast as they
+ * deliver. Frame archives (`.hfa`) are read through open_frame_source() and paced at their captured timestamps;
+ * their frames are views of the mapping, so there is nothing to skip decoding.
+ */
+class LatestFrameGrabber {
+public:
+    /**
+     * @param source Camera index ("0"), file path, stream URL or frame archive.
+     * @param pace_files Pace file sources at CAP_PROP_FPS (otherwise the whole file is read as fast as possible).
+     */
+    explicit LatestFrameGrabber(const std::string& source, bool pace_files = true);
+    ~LatestFrameGrabber();
+
+    LatestFrameGrabber(const LatestFrameGrabber&) = delete;
+    LatestFrameGrabber& operator=(const LatestFrameGrabber&) = delete;
+
+    /**
+     * @brief Waits for a frame newer than the previous call's and retrieves it.
+     *
+     * @return false once the source is exhausted (or stop() was called) and no unread frame is left.
+     */
+    bool next(GrabbedFrame& frame);
+    void stop();
+
+    double getFps() const;
+    cv::Size getFrameSize() const;
+    LatestFrameGrabberStats getStats();
+
+private:
+    void run();
+
+    cv::VideoCapture capture_;
+    std::unique_ptr<FrameSource> archive_;   // set instead of capture_ for frame archives
+    bool is_file_ = false;
+    bool pace_ = false;
+    double fps_ = 0.0;
+    cv::Size frame_size_;
+
+    // capture_/archive_ are only used by the grabber thread after construction
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool waiting_ = false;              // the consumer wants the next grabbed frame
+    bool ready_ = false;                // pending_ holds a frame for the consumer
+    GrabbedFrame pending_;
+    bool finished_ = false;
+    bool stopping_ = false;
+    LatestFrameGrabberStats stats_;
+    std::thread thread_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+struct ModelCascadeConfig {
+    /**
+     * @brief Small-model detections within `band` of the threshold the call applies to their class (`conf` or the
+     * class's own) are ambiguous: with conf 0.3, those in [0.2, 0.4). The small model runs with its thresholds lowered
+     * by `band` so that near misses are seen too. A wide band escalates almost every frame, since most frames have
+     * some box near the threshold.
+     */
+    float band = 0.1f;
+    size_t min_ambiguous = 1;          ///< ambiguous detections needed to escalate a frame
+    int count_jump = 3;                ///< escalate when the detection count moves this much from the previous frame, 0 - off
+    bool regions = false;              ///< escalate only padded regions around the ambiguous detections, not whole frames
+    float region_padding = 0.5f;       ///< each side of an ambiguous box grows by this share of its size (context for the large model)
+    float max_region_area = 0.5f;      ///< regions covering more than this share of a frame escalate the whole frame instead
+};
+
+struct ModelCascadeStats {
+    uint64_t frames = 0;
+    uint64_t escalated = 0;            ///< frames the large model looked at (whole or in part)
+    uint64_t escalated_regions = 0;    ///< of those, frames where only regions went to the large model
+    uint64_t regions = 0;              ///< regions sent to the large model
+    uint64_t count_jumps = 0;          ///< escalations caused by a count change rather than ambiguity
+    double small_ms = 0.0;
+    double large_ms = 0.0;
+    double escalation_rate() const { return frames ? static_cast<double>(escalated) / frames : 0.0; }
+};
+
+/**
+ * @brief Small model first, large model only when the small one is unsure.
+ *
+ * Every frame goes through the small model. A frame is escalated when at least `min_ambiguous` of its detections
+ * fall in the ambiguity band, or when its detection count jumps compared to the previous frame (a sudden change in
+ * a video is more often a miss than reality). Escalated frames, or with `regions` just padded crops around the
+ * ambiguous boxes, run through the large model. Its results replace the ambiguous ones; confident small-model
+ * detections are kept unless a large-model box of the same class overlaps them by `iou` or more.
+ * Both models must have the same classes. Frames passed to predict_batch count as consecutive video frames.
+ * Not thread-safe, use one cascade per stream.
+ */
+class ModelCascade {
+public:
+    /**
+     * @param small First stage, e.g. an n-size export.
+     * @param large Escalation stage, e.g. the m-size export of the same dataset. Both must outlive the cascade.
+     */
+    ModelCascade(AutoBackendOnnx& small, AutoBackendOnnx& large, const ModelCascadeConfig& config = ModelCascadeConfig());
+
+    std::vector<YoloResults> predict(const cv::Mat& image, const PredictParams& params);
+    /**
+     * @brief Small model on all images in one call, then one large-model call for everything escalated.
+     * @param params One per image, or a single entry for all of them.
+     */
+    std::vector<std::vector<YoloResults>> predict_batch(const std::vector<cv::Mat>& images, const std::vector<PredictParams>& params);
+    /**
+     * @brief Forgets the previous frame's detection count, call when switching to another stream.
+     */
+    void reset();
+
+    ModelCascadeStats getStats() const;
+
+private:
+    AutoBackendOnnx& small_;
+    AutoBackendOnnx& large_;
+    ModelCascadeConfig config_;
+    ModelCascadeStats stats_;
+    int64_t previous_count_ = -1;
+};
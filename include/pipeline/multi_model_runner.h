@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+#include "utils/thread_pool.h"
+
+struct MultiModelRunnerConfig {
+    /**
+     * @brief Run the models' forward() and postprocessing in parallel, on the calling thread plus one dispatch thread
+     * per further model. Each model still postprocesses on its own pool (AutoBackendOnnx::setThreadPool(), or
+     * ThreadPool::global()); dispatching from a global() worker would make that parallel_for run inline, i.e. serially.
+     */
+    bool concurrent = true;
+};
+
+struct MultiModelRunnerStats {
+    uint64_t images = 0;
+    double preprocess_ms = 0.0;        ///< letterbox + blob, paid once per image for all models
+    std::vector<double> model_ms;      ///< forward + postprocess, per model
+};
+
+/**
+ * @brief Runs several models on the same frames, preprocessing every frame once.
+ *
+ * The models must agree on everything that shapes the input blob (channels, input size, stride, fixed or
+ * dynamic size, batch dimension and the resize mode). The constructor checks this against their metadata and
+ * session shapes. Each frame is letterboxed into one blob, and every model's session reads that same tensor.
+ * Not thread-safe, use one runner per thread.
+ */
+class MultiModelRunner {
+public:
+    /**
+     * @param models Models to run, in the order of the returned results. They must outlive the runner.
+     */
+    explicit MultiModelRunner(const std::vector<AutoBackendOnnx*>& models, const MultiModelRunnerConfig& config = MultiModelRunnerConfig());
+
+    /**
+     * @brief Results of every model for one image: `[model][detection]`.
+     * @param params One PredictParams per model. Color conversion and `imgsz` are taken from the first one.
+     */
+    std::vector<std::vector<YoloResults>> predict(const cv::Mat& image, const std::vector<PredictParams>& params);
+    /**
+     * @brief Results of every model for every image: `[model][image][detection]`.
+     */
+    std::vector<std::vector<std::vector<YoloResults>>> predict_batch(const std::vector<cv::Mat>& images,
+                                                                     const std::vector<PredictParams>& params);
+
+    const std::vector<AutoBackendOnnx*>& getModels() const;
+    MultiModelRunnerStats getStats() const;
+
+private:
+    std::vector<AutoBackendOnnx*> models_;
+    MultiModelRunnerConfig config_;
+    MultiModelRunnerStats stats_;
+    std::vector<float> blob_;
+    std::unique_ptr<ThreadPool> dispatch_;  // concurrent mode with several models
+
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+#include "pipeline/frame_source.h"
+
+class ResultCache;
+
+/**
+ * @brief Per-stream settings of MultiStreamEngine.
+ */
+struct StreamConfig {
+    std::string name;             ///< label in stats and results, defaults to the source name
+    int priority = 1;             ///< scheduling weight: under contention a priority-2 stream gets twice the frames of a priority-1 one
+    double max_fps = 0.0;         ///< frames above this rate are skipped right after reading, 0 - uncapped
+    bool lossless = false;        ///< wait for inference instead of replacing the pending frame (offline files)
+    int node = -1;                ///< NUMA node whose sessions serve this stream, see MultiStreamEngineConfig::session_nodes; -1 - any
+    PredictParams params;
+};
+
+struct StreamStats {
+    std::string name;
+    uint64_t read = 0;            ///< frames read from the source
+    uint64_t capped = 0;          ///< frames skipped by the max_fps cap
+    uint64_t replaced = 0;        ///< frames dropped because a newer one arrived before inference got to them
+    uint64_t processed = 0;
+    uint64_t failed = 0;
+    double mean_latency_ms = 0.0; ///< read to results
+    double max_latency_ms = 0.0;
+    double fps = 0.0;             ///< processed frames per second since start()
+    bool finished = false;
+};
+
+struct MultiStreamEngineConfig {
+    int max_batch = 8;                              ///< frames (from different streams) per forward() call
+    std::chrono::microseconds max_delay{ 5000 };    ///< how long the oldest ready frame waits for the batch to fill
+    /**
+     * @brief NUMA node of every session (parallel to the sessions vector), empty - no routing.
+     * A stream with `StreamConfig::node >= 0` is only batched by sessions on that node.
+     */
+    std::vector<int> session_nodes;
+    /**
+     * @brief CPUs each session's worker thread is pinned to (parallel to the sessions vector), empty - unpinned.
+     * Reader threads of a stream with a node are pinned like the first session on that node.
+     */
+    std::vector<std::vector<int>> session_cpus;
+    /**
+     * @brief Frozen or repeated frames are answered from this cache instead of the model, nullptr - no cache.
+     * Must outlive the engine.
+     */
+    ResultCache* result_cache = nullptr;
+};
+
+struct MultiStreamEngineStats {
+    uint64_t batches = 0;
+    uint64_t frames = 0;
+    double mean_batch_size() const { return batches ? static_cast<double>(frames) / batches : 0.0; }
+};
+
+struct StreamFrame {
+    size_t stream = 0;            ///< index returned by addStream()
+    uint64_t index = 0;           ///< position in the source, counting skipped frames
+    cv::Mat image;
+    std::chrono::steady_clock::time_point read_at;
+};
+
+/**
+ * @brief Runs many video streams through a few shared sessions, batching frames across streams.
+ *
+ * Every stream has a reader thread that keeps at most one frame pending (live streams replace it, lossless ones
+ * wait). One worker per session repeatedly builds a batch with at most one frame per stream, picking the ready
+ * streams with the least weighted service so far (stride scheduling): a stream that produces frames faster than
+ * its share cannot starve the others, and a stream that went idle does not bank credit.
+ * Frames of one stream are never in flight twice, so results arrive in stream order.
+ */
+class MultiStreamEngine {
+public:
+    using ResultCallback = std::function<void(const StreamFrame& frame, std::vector<YoloResults>& results)>;
+
+    /**
+     * @param sessions Models to run on, one worker thread each. The same model may be listed several times
+     *                 to run concurrent `Run()` calls on one session.
+     * @param callback Invoked on a worker thread for every processed frame (may be empty).
+     */
+    MultiStreamEngine(const std::vector<AutoBackendOnnx*>& sessions, const MultiStreamEngineConfig& config = MultiStreamEngineConfig(),
+                      ResultCallback callback = ResultCallback());
+    ~MultiStreamEngine();
+
+    MultiStreamEngine(const MultiStreamEngine&) = delete;
+    MultiStreamEngine& operator=(const MultiStreamEngine&) = delete;
+
+    /**
+     * @brief Registers a stream, only allowed before start(). Returns the stream index.
+     */
+    size_t addStream(std::unique_ptr<FrameSource> source, StreamConfig config);
+
+    void start();
+    /**
+     * @brief Blocks until every source is exhausted and all of their frames are processed.
+     */
+    void wait();
+    /**
+     * @brief Like wait(), but gives up after `timeout`. Returns true if everything is done.
+     */
+    bool waitFor(std::chrono::milliseconds timeout);
+    /**
+     * @brief Stops reading and processing; frames not yet in a batch are discarded.
+     */
+    void stop();
+
+    std::vector<StreamStats> getStreamStats();
+    MultiStreamEngineStats getStats();
+
+private:
+    struct Stream {
+        std::unique_ptr<FrameSource> source;
+        StreamConfig config;
+        std::thread reader;
+
+        // guarded by mutex_
+        bool has_frame = false;
+        bool in_flight = false;
+        bool finished = false;
+        StreamFrame pending;
+        double pass = 0.0;            // weighted service received, in units of 1 / priority
+        StreamStats stats;
+        double total_latency_ms = 0.0;
+    };
+
+    void readLoop(size_t index);
+    void workLoop(size_t session_index);
+    bool isReady(const Stream& stream, int node) const;
+    bool allDone() const;
+
+    std::vector<AutoBackendOnnx*> sessions_;
+    MultiStreamEngineConfig config_;
+    ResultCallback callback_;
+    std::vector<std::unique_ptr<Stream>> streams_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;     // workers: a stream became ready, or stopping
+    std::condition_variable slot_cv_;     // lossless readers: a pending slot was freed
+    std::condition_variable done_cv_;     // wait(): progress towards completion
+    double virtual_time_ = 0.0;
+    bool started_ = false;
+    bool stopping_ = false;
+    std::chrono::steady_clock::time_point started_at_;
+    MultiStreamEngineStats stats_;
+};
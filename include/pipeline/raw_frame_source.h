@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <opencv2/core/mat.hpp>
+
+#include "pipeline/frame_source.h"
+
+enum class RawPixelFormat {
+    BGR24,  ///< packed B, G, R bytes, w * h * 3 per frame
+    NV12,   ///< a w x h Y plane followed by an interleaved w/2 x h/2 UV plane, w * h * 3 / 2 per frame
+};
+
+/**
+ * @brief Parses "bgr24" or "nv12"; throws std::invalid_argument otherwise.
+ */
+RawPixelFormat parse_raw_pixel_format(const std::string& name);
+
+/**
+ * @brief Headerless fixed-size frames from stdin, a named pipe or a file, e.g. `ffmpeg ... -f rawvideo -pix_fmt bgr24 -`.
+ *
+ * BGR24 frames are read straight into the caller's Mat, which is only (re)allocated when its size or type differ,
+ * so a loop that reads into the same Mat does no per-frame allocation or copy. NV12 frames go through one reused
+ * staging buffer and are converted into the caller's Mat.
+ */
+class RawFrameSource : public FrameSource {
+public:
+    /**
+     * @param path "-" for stdin, otherwise a FIFO or file opened for reading (blocks until a FIFO has a writer).
+     * @param fps Nominal frame rate reported by getFps(), 0 if unknown; frames are delivered as they arrive.
+     */
+    RawFrameSource(const std::string& path, cv::Size size, RawPixelFormat format, double fps = 0.0);
+    ~RawFrameSource() override;
+
+    RawFrameSource(const RawFrameSource&) = delete;
+    RawFrameSource& operator=(const RawFrameSource&) = delete;
+
+    /**
+     * @brief Returns false at the end of the input; a truncated last frame is dropped with a warning.
+     */
+    bool read(cv::Mat& frame) override;
+    double getFps() const override;
+    cv::Size getFrameSize() const override;
+    bool isLive() const override;
+    const std::string& getName() const override;
+
+    size_t getFrameBytes() const { return frame_bytes_; }
+
+private:
+    /**
+     * @brief Fills `size` bytes, retrying short reads. Returns the number of bytes read (less only at the end).
+     */
+    size_t readFully(uint8_t* data, size_t size);
+
+    std::string name_;
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    cv::Size size_;
+    RawPixelFormat format_;
+    double fps_;
+    size_t frame_bytes_ = 0;
+    cv::Mat nv12_;  ///< staging buffer for NV12 input, (h * 3 / 2) x w
+};
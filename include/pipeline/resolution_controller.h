@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/types.hpp>
+
+#include "nn/autobackend.h"
+
+struct ResolutionControllerConfig {
+    std::vector<int> sizes{ 320, 416, 512, 640, 800 };  ///< candidate long sides of the network input, in pixels
+    float min_object_px = 24.0f;       ///< smallest object side (in network input pixels) the model still detects reliably
+    float small_quantile = 0.1f;       ///< this share of the previous frame's boxes may end up smaller than min_object_px
+    double target_ms = 0.0;            ///< skip sizes whose smoothed inference time exceeds this, 0 - no latency target
+    int down_frames = 5;               ///< frames in a row asking for a smaller size before switching down; up is immediate
+    int probe_interval = 60;           ///< every n-th frame runs at the largest allowed size to find new small objects, 0 - never
+    bool match_aspect = true;          ///< shrink the short side to the frame's aspect ratio instead of padding to a square
+    double smoothing = 0.2;            ///< EWMA weight of the newest inference time
+};
+
+struct ResolutionControllerStats {
+    uint64_t frames = 0;
+    uint64_t probes = 0;
+    std::vector<int> sizes;                 ///< candidate long sides, rounded to the stride and sorted
+    std::vector<uint64_t> frames_per_size;  ///< parallel to sizes
+    std::vector<double> smoothed_ms_per_size; ///< EWMA of the inference time, -1 - never used
+};
+
+/**
+ * @brief Picks the input size of each video frame for models exported with dynamic height/width.
+ *
+ * The smallest candidate size at which the small end of the previous frame's box sizes stays above
+ * `min_object_px` is used, capped by the latency target. Sizes grow at once when objects get smaller
+ * and shrink only after `down_frames` frames, so a single missed detection can't start a collapse. Frames
+ * without detections keep the current size; periodic probes at the largest allowed size catch small objects
+ * entering a frame that is inferred at a low resolution.
+ * The chosen size goes into PredictParams::imgsz; boxes, masks and keypoints are mapped back using the size
+ * each call actually ran at.
+ */
+class ResolutionController {
+public:
+    /**
+     * @param model Used for its stride; must have a dynamic input size.
+     */
+    ResolutionController(AutoBackendOnnx& model, const ResolutionControllerConfig& config = ResolutionControllerConfig());
+
+    /**
+     * @brief Input size for the next frame (a multiple of the stride).
+     */
+    cv::Size next(const cv::Size& frame_size);
+    /**
+     * @brief Feeds back the results and inference time of the frame that ran at the last next() size.
+     */
+    void record(const std::vector<YoloResults>& results, const cv::Size& frame_size, double inference_ms);
+
+    ResolutionControllerStats getStats() const;
+
+private:
+    size_t latencyCap() const;
+
+    ResolutionControllerConfig config_;
+    int stride_ = 32;
+    size_t current_ = 0;               // index into config_.sizes
+    size_t last_ = 0;                  // index used by the last next()
+    int down_count_ = 0;
+    std::vector<double> ewma_ms_;
+    ResolutionControllerStats stats_;
+};
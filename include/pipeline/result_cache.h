@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+struct ResultCacheConfig {
+    size_t max_bytes = 64u << 20;   ///< encoded results plus bookkeeping; least recently used entries are evicted beyond this
+};
+
+struct ResultCacheStats {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t inserts = 0;
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    double hash_ms = 0.0;           ///< total time spent hashing pixels
+    double hit_rate() const { return lookups ? static_cast<double>(hits) / lookups : 0.0; }
+};
+
+/**
+ * @brief Content-addressed LRU cache of prediction results, for duplicate uploads and frozen or repeated video frames.
+ *
+ * Entries are keyed by a 64-bit hash of the pixels (plus size and type) and a hash of the model path and every
+ * PredictParams field that changes the output (the deadline doesn't). Results are kept in the compact
+ * encode_results() form, so masks cost one bit per pixel. sub_class_idx/sub_conf are not kept: cache the
+ * detector's output and run a CropCascade on top. Thread-safe; one cache can serve several sessions of a model.
+ * Two different images colliding on the 64-bit hash would share results; at 1e9 distinct images that is ~3e-2 % likely.
+ */
+class ResultCache {
+public:
+    struct Key {
+        uint64_t pixels = 0;
+        uint64_t scope = 0;         ///< model and parameters, see scopeHash()
+        int rows = 0;
+        int cols = 0;
+        int type = 0;
+        bool operator==(const Key& other) const {
+            return pixels == other.pixels && scope == other.scope && rows == other.rows && cols == other.cols && type == other.type;
+        }
+    };
+
+    explicit ResultCache(const ResultCacheConfig& config = ResultCacheConfig());
+
+    /**
+     * @brief Fast non-cryptographic hash of the image's pixels (4 independent multiply-xorshift lanes over 8-byte words).
+     */
+    static uint64_t hashPixels(const cv::Mat& image);
+    static uint64_t scopeHash(AutoBackendOnnx& model, const PredictParams& params);
+    Key makeKey(const cv::Mat& image, uint64_t scope);
+
+    /**
+     * @brief Copies the cached results into `results` and marks the entry as recently used.
+     */
+    bool lookup(const Key& key, std::vector<YoloResults>& results);
+    void store(const Key& key, const std::vector<YoloResults>& results);
+
+    /**
+     * @brief AutoBackendOnnx::predict_batch through the cache: only images without an entry (and only the first of
+     * identical images in the call) go to the model.
+     */
+    std::vector<std::vector<YoloResults>> predict_batch(AutoBackendOnnx& model, const std::vector<cv::Mat>& images,
+                                                        const std::vector<PredictParams>& params);
+    std::vector<YoloResults> predict(AutoBackendOnnx& model, const cv::Mat& image, const PredictParams& params);
+
+    ResultCacheStats getStats() const;
+    void clear();
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.pixels ^ (key.scope * 0x9E3779B97F4A7C15ull)); }
+    };
+    struct Entry {
+        Key key;
+        std::vector<uint8_t> encoded;
+    };
+
+    void evict();
+
+    ResultCacheConfig config_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;          // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    ResultCacheStats stats_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+#include "server/shm_ring.h"
+
+/**
+ * @brief Client of InferenceServer: runs predictions on a model loaded once by the `Helmsman --serve` daemon.
+ *
+ * Frames are handed over through the server's shared-memory ring, only a small header goes over the socket.
+ * To avoid even the copy into the ring, decode or render straight into a frame obtained from acquireFrame().
+ * A client sends one request at a time; use one client per thread for concurrency.
+ */
+class HelmsmanClient {
+public:
+    explicit HelmsmanClient(const std::string& socket_path);
+    ~HelmsmanClient();
+
+    HelmsmanClient(const HelmsmanClient&) = delete;
+    HelmsmanClient& operator=(const HelmsmanClient&) = delete;
+
+    /**
+     * @brief Claims a shared-memory slot and returns a writable frame living in it.
+     *
+     * The frame is released by the next predict() call that receives it. Throws if no slot is free or
+     * the frame does not fit into a slot.
+     */
+    cv::Mat acquireFrame(int rows, int cols, int type);
+
+    /**
+     * @brief Runs prediction on the server.
+     *
+     * Frames from acquireFrame() are sent in place, any other image (including an ROI of such a frame) is copied
+     * into a slot first.
+     */
+    std::vector<YoloResults> predict(const cv::Mat& image, const PredictParams& params);
+
+private:
+    void request(const void* header, size_t header_size, std::vector<uint8_t>& payload);
+    int slotOf(const cv::Mat& image);
+
+    int fd_ = -1;
+    uint32_t client_id_ = 0;
+    std::unique_ptr<SharedFrameRing> ring_;
+    std::mutex mutex_;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nn/async_predictor.h"
+#include "nn/autobackend.h"
+#include "server/shm_ring.h"
+
+struct InferenceServerConfig {
+    std::string socket_path = "/tmp/helmsman.sock";
+    std::string shm_name;                       ///< defaults to "/helmsman-<pid>"
+    uint32_t slot_count = 8;                    ///< frames that can be in flight at once (across all clients)
+    uint64_t slot_bytes = 1920ull * 1080 * 3;   ///< max frame size in bytes
+    AsyncPredictorConfig batching;              ///< requests of all clients are micro-batched together
+    std::chrono::milliseconds request_timeout{ 0 };  ///< deadline of requests that don't set one, 0 - none
+    bool with_masks = true;                     ///< false - masks are dropped even if a request asks for them
+    bool with_keypoints = true;                 ///< false - keypoints are dropped even if a request asks for them
+    std::vector<int> classes;                   ///< class allowlist applied to every request, empty - all classes
+    std::vector<float> class_conf;              ///< per-class thresholds parallel to `classes`
+};
+
+/**
+ * @brief Local inference daemon: one loaded model serving many processes over a Unix domain socket.
+ *
+ * Clients (see HelmsmanClient) put frames into the shared-memory ring and send only a small request header;
+ * the frame is wrapped in place, predicted through an AsyncPredictor and the results are sent back in the
+ * compact binary format of utils/serialization.h.
+ */
+class InferenceServer {
+public:
+    InferenceServer(AutoBackendOnnx& model, InferenceServerConfig config);
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * @brief Accepts and serves clients until stop() is called.
+     */
+    void run();
+    /**
+     * @brief Asks run() to return; safe to call from a signal handler.
+     */
+    void stop();
+
+private:
+    struct Connection {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    void serve(int fd, uint32_t client_id);
+
+    AutoBackendOnnx& model_;
+    InferenceServerConfig config_;
+    std::unique_ptr<SharedFrameRing> ring_;
+    std::unique_ptr<AsyncPredictor> predictor_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{ false };
+    std::atomic<uint32_t> next_client_id_{ 1 };
+    std::vector<Connection> connections_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+/*
+ * Wire protocol of the local inference server (see InferenceServer / HelmsmanClient).
+ *
+ * Every message is a fixed-size header optionally followed by `payload_bytes` of payload.
+ * Pixels never travel over the socket: the client writes the frame into a slot of the shared-memory
+ * ring announced in the HELLO response and sends only the slot index and the frame geometry.
+ * All fields are in host byte order since both peers live on the same machine.
+ */
+namespace ServerProtocol {
+    inline constexpr uint32_t MAGIC = 0x534D4C48;  // "HLMS"
+    inline constexpr uint16_t VERSION = 2;
+    inline constexpr int SHM_NAME_MAX = 64;
+
+    enum Op : uint16_t {
+        HELLO = 1,      ///< no payload; response payload is HelloPayload
+        PREDICT = 2,    ///< no payload; response payload is encode_results() output
+    };
+
+    enum Status : uint16_t {
+        OK = 0,
+        BAD_REQUEST = 1,    ///< response payload is an error message
+        FAILED = 2,         ///< response payload is an error message
+        TIMEOUT = 3,        ///< the request's deadline passed, response payload is an error message
+    };
+
+#pragma pack(push, 1)
+    struct RequestHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t op;
+        uint32_t slot;              ///< shared-memory slot holding the frame
+        int32_t rows;
+        int32_t cols;
+        int32_t type;               ///< OpenCV type of the frame, e.g. CV_8UC3
+        uint64_t step;              ///< bytes per row inside the slot
+        float conf;
+        float iou;
+        float mask_threshold;
+        int32_t conversion_code;
+        uint8_t with_masks;         ///< 0 - boxes only for segmentation models
+        uint8_t with_keypoints;     ///< 0 - boxes only for pose models
+        uint32_t timeout_ms;        ///< give up after this long, 0 - the server's default (`--timeout-ms`)
+    };
+
+    struct ResponseHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t status;
+        uint32_t payload_bytes;
+    };
+
+    struct HelloPayload {
+        char shm_name[SHM_NAME_MAX];
+        uint32_t client_id;         ///< owner token to claim ring slots with
+        uint32_t slot_count;
+        uint64_t slot_bytes;
+    };
+#pragma pack(pop)
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Fixed-size slots in a POSIX shared-memory segment used to hand frames to the server without copying.
+ *
+ * Each slot has an owner word: 0 means free, otherwise it holds the client id that claimed it.
+ * Clients claim a slot with a CAS, write the frame in place and release it once the response arrived;
+ * the server reclaims the slots of clients that disconnect.
+ */
+class SharedFrameRing {
+public:
+    static constexpr uint32_t FREE = 0;
+
+    /**
+     * @brief Creates (server side) a new segment, replacing a stale one with the same name.
+     */
+    SharedFrameRing(const std::string& name, uint32_t slot_count, uint64_t slot_bytes);
+    /**
+     * @brief Maps (client side) an existing segment.
+     */
+    explicit SharedFrameRing(const std::string& name);
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    const std::string& getName() const;
+    uint32_t getSlotCount() const;
+    uint64_t getSlotBytes() const;
+    uint8_t* getSlotData(uint32_t slot);
+
+    /**
+     * @brief Claims a free slot for `owner`, returns -1 if all slots are busy.
+     */
+    int acquire(uint32_t owner);
+    void release(uint32_t slot, uint32_t owner);
+    /**
+     * @brief Frees every slot still held by `owner`.
+     */
+    void releaseAll(uint32_t owner);
+    bool isOwnedBy(uint32_t slot, uint32_t owner);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t slot_count;
+        uint64_t slot_bytes;
+        uint64_t slot_stride;
+        uint64_t data_offset;
+    };
+
+    void map(int fd, size_t size);
+    std::atomic<uint32_t>* owners();
+
+    std::string name_;
+    bool owner_ = false;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    Header* header_ = nullptr;
+};
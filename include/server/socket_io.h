@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Reads exactly `size` bytes, retrying on EINTR. Returns false on EOF or error.
+ */
+bool read_exact(int fd, void* buffer, size_t size);
+
+/**
+ * @brief Writes exactly `size` bytes, retrying on EINTR. Returns false on error (never raises SIGPIPE).
+ */
+bool write_exact(int fd, const void* buffer, size_t size);
+
+/**
+ * @brief Sends a ServerProtocol::ResponseHeader followed by the payload.
+ */
+bool send_response(int fd, uint16_t status, const void* payload, uint32_t payload_bytes);
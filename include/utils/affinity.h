@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * @brief A NUMA node and the logical CPUs that belong to it.
+ */
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+/**
+ * @brief Parses a Linux cpulist such as "0-3,8,10-11" into CPU ids. Throws std::invalid_argument on bad input.
+ */
+std::vector<int> parse_cpu_list(const std::string& list);
+
+/**
+ * @brief NUMA nodes with at least one online CPU (from /sys/devices/system/node).
+ *
+ * Platforms without NUMA information get a single node 0 holding every hardware thread.
+ */
+std::vector<NumaNode> numa_topology();
+
+/**
+ * @brief Restricts the calling thread to `cpus`. Threads it creates afterwards inherit the mask.
+ *
+ * Returns false (and leaves the thread unpinned) if the platform doesn't support it or the set is invalid.
+ */
+bool pin_current_thread(const std::vector<int>& cpus);
+
+/**
+ * @brief CPUs the calling thread may run on (its affinity mask, e.g. narrowed by `--cpus`), sorted.
+ *
+ * Platforms without affinity support get every hardware thread.
+ */
+std::vector<int> current_thread_cpus();
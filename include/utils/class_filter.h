@@ -0,0 +1,54 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Class allowlist with per-class confidence thresholds, applied while scanning the class scores of a row.
+ *
+ * Only the listed score columns are read; rows without a listed class above its threshold are skipped.
+ */
+struct ClassFilter {
+    std::vector<int> ids;            ///< empty - every class at the call's conf threshold
+    std::vector<float> thresholds;   ///< parallel to ids
+
+    bool empty() const { return ids.empty(); }
+
+    /**
+     * @brief Best listed class of a row whose scores start at `scores`; false if none clears its threshold.
+     */
+    bool best(const float* scores, int& class_id, float& conf) const {
+        bool found = false;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const float score = scores[ids[i]];
+            if (score > thresholds[i] && (!found || score > conf)) {
+                class_id = ids[i];
+                conf = score;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief Whether `class_id` is listed and `conf` clears its threshold (for already decoded rows).
+     */
+    bool accepts(int class_id, float conf) const {
+        if (ids.empty()) {
+            return true;
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] == class_id) {
+                return conf > thresholds[i];
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Lowest threshold in use, i.e. the score threshold left for NMS.
+     */
+    float min_threshold(float fallback) const {
+        return ids.empty() ? fallback : *std::min_element(thresholds.begin(), thresholds.end());
+    }
+};
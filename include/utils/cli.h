@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Minimal command line parser.
+ *
+ * Options are either `--name=value` or bare `--name` switches, everything else is positional:
+ *      Helmsman --serve=/tmp/helmsman.sock --model=yolov8n.onnx
+ */
+class CliArgs {
+public:
+    CliArgs(int argc, char** argv);
+
+    bool has(const std::string& name) const;
+    std::string get(const std::string& name, const std::string& fallback = "") const;
+    int getInt(const std::string& name, int fallback) const;
+    float getFloat(const std::string& name, float fallback) const;
+    const std::vector<std::string>& positional() const;
+
+private:
+    std::unordered_map<std::string, std::string> options_;
+    std::vector<std::string> positional_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+/**
+ * @brief An image decoded for inference, possibly at reduced resolution.
+ */
+struct DecodedImage {
+    std::string path;
+    cv::Mat image;          ///< BGR pixels, empty if decoding failed
+    cv::Size raw_size;      ///< full-resolution size of the image, after EXIF orientation (like a plain imread)
+    std::string error;
+};
+
+/**
+ * @brief Reads image width/height from a JPEG or PNG header without decoding. Returns false for other formats.
+ */
+bool probe_image_size(const std::vector<uchar>& buffer, cv::Size& size);
+
+/**
+ * @brief Decodes an image as 3-channel BGR, letting the codec downscale by 2, 4 or 8 (`IMREAD_REDUCED_COLOR_*`)
+ * when the source is that much larger than `target_size`, so the letterboxed model input stays the same.
+ */
+DecodedImage decode_image_for_model(const std::filesystem::path& path, const cv::Size& target_size);
+
+/**
+ * @brief Maps results predicted on an image of size `from` back to an image of size `to`
+ * (boxes, keypoints and masks).
+ */
+void rescale_results(std::vector<YoloResults>& results, const cv::Size& from, const cv::Size& to);
+
+/**
+ * @brief Expands `input` into image paths: the images of a directory (sorted, recursively) or the lines of a list file.
+ */
+std::vector<std::string> collect_image_paths(const std::filesystem::path& input);
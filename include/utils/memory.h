@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Resident set size of the current process in bytes, 0 if the platform doesn't expose it.
+ */
+size_t current_rss_bytes();
+
+/**
+ * @brief Peak resident set size of the current process in bytes, 0 if the platform doesn't expose it.
+ */
+size_t peak_rss_bytes();
+
+/**
+ * @brief Human-readable size, e.g. "12.3 MiB".
+ */
+std::string format_bytes(double bytes);
+
+/**
+ * @brief Where the process memory sits. Fields the platform doesn't expose stay 0.
+ */
+struct MemoryBreakdown {
+    size_t rss = 0;
+    size_t peak_rss = 0;
+    size_t rss_anon = 0;       ///< resident anonymous memory: heap, ORT arenas, tensors, decoded frames
+    size_t rss_file = 0;       ///< resident file-backed pages: binaries, shared libraries, mapped files
+    size_t heap_in_use = 0;    ///< malloc: bytes handed out and not yet freed (glibc)
+    size_t heap_free = 0;      ///< malloc: freed bytes the allocator still holds, see release_free_memory() (glibc)
+    size_t heap_mmapped = 0;   ///< malloc: large blocks served directly by mmap (glibc)
+};
+
+MemoryBreakdown memory_breakdown();
+
+/**
+ * @brief One line, e.g. "RSS 212.4 MiB (peak 260.1 MiB): anon 180.2 MiB, file 32.2 MiB; heap 120.0 MiB in use, ...".
+ */
+std::string format_memory_breakdown(const MemoryBreakdown& breakdown);
+
+/**
+ * @brief Returns free heap memory to the system (malloc_trim on glibc, no-op elsewhere).
+ * Returns the RSS drop in bytes, 0 if unknown or none.
+ */
+size_t release_free_memory();
+
+/**
+ * @brief release_free_memory() for calling whenever a work queue drains. Skipped if the process trimmed less than a
+ * second ago, so steady traffic doesn't pay for it on every frame.
+ */
+size_t release_free_memory_after_burst();
@@ -7,6 +7,8 @@
 #include <vector>
 #include <tuple>
 
+#include "class_filter.h"
+
 // Clip boxes: integer version.
 inline void clip_boxes(cv::Rect &box, const cv::Size &shape) {
     box.x = std::max(0, std::min(box.x, shape.width));
@@ -72,7 +74,8 @@ inline std::vector<float> scale_coords(const cv::Size &img1_shape, std::vector<f
 
 // Non-Maximum Suppression (NMS)
 inline std::tuple<std::vector<cv::Rect>, std::vector<float>, std::vector<int>, std::vector<std::vector<float>>>
-non_max_suppression(const cv::Mat &output0, int class_names_num, int data_width, double conf_threshold, float iou_threshold) {
+non_max_suppression(const cv::Mat &output0, int class_names_num, int data_width, double conf_threshold, float iou_threshold,
+                    const ClassFilter &class_filter = ClassFilter()) {
     std::vector<int> class_ids;
     std::vector<float> confidences;
     std::vector<cv::Rect> boxes;
@@ -84,14 +87,24 @@ non_max_suppression(const cv::Mat &output0, int class_names_num, int data_width,
     float* pdata = reinterpret_cast<float*>(output0.data);
 
     for (int r = 0; r < rows; ++r) {
-        cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
-        cv::Point class_id;
-        double max_conf;
-        cv::minMaxLoc(scores, nullptr, &max_conf, nullptr, &class_id);
-        if (max_conf > conf_threshold) {
-            std::vector<float> mask_data(pdata + 4 + class_names_num, pdata + data_width);
-            class_ids.push_back(class_id.x);
-            confidences.push_back(static_cast<float>(max_conf));
+        int best_class = 0;
+        float best_conf = 0.0f;
+        bool keep;
+        if (class_filter.empty()) {
+            cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
+            cv::Point class_id;
+            double max_conf;
+            cv::minMaxLoc(scores, nullptr, &max_conf, nullptr, &class_id);
+            best_class = class_id.x;
+            best_conf = static_cast<float>(max_conf);
+            keep = max_conf > conf_threshold;
+        }
+        else {
+            keep = class_filter.best(pdata + 4, best_class, best_conf);
+        }
+        if (keep) {
+            class_ids.push_back(best_class);
+            confidences.push_back(best_conf);
             float out_w = pdata[2], out_h = pdata[3];
             float out_left = std::max((pdata[0] - 0.5f * out_w + 0.5f), 0.0f);
             float out_top  = std::max((pdata[1] - 0.5f * out_h + 0.5f), 0.0f);
@@ -106,7 +119,7 @@ non_max_suppression(const cv::Mat &output0, int class_names_num, int data_width,
     }
 
     std::vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, conf_threshold, iou_threshold, nms_result);
+    cv::dnn::NMSBoxes(boxes, confidences, class_filter.min_threshold(static_cast<float>(conf_threshold)), iou_threshold, nms_result);
     std::vector<int> nms_class_ids;
     std::vector<float> nms_confidences;
     std::vector<cv::Rect> nms_boxes;
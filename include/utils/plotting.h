@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+cv::Scalar generateRandomColor(int numChannels);
+std::vector<cv::Scalar> generateRandomColors(int class_names_num, int numChannels);
+
+/**
+ * @brief Draws boxes, labels and instance masks onto frames.
+ *
+ * Masks are alpha-blended (0.6 frame / 0.4 class color) only inside each instance's box, so frames without
+ * masks cost nothing beyond the boxes and labels. Label prefixes and their text extents are computed once
+ * per class. Not thread-safe: give each rendering thread its own plotter.
+ */
+class ResultPlotter {
+public:
+    ResultPlotter(const std::unordered_map<int, std::string>& names, const std::vector<cv::Scalar>& colors);
+
+    void draw(cv::Mat& img, const std::vector<YoloResults>& results);
+
+private:
+    struct Label {
+        std::string prefix;   ///< "<class name> "
+        cv::Size text_size;   ///< extent of the prefix followed by a confidence like "0.00"
+    };
+
+    const Label& label(int class_idx);
+    const cv::Scalar& color(int class_idx) const;
+    void blend_mask(cv::Mat& img, const YoloResults& result, const cv::Scalar& color) const;
+
+    std::unordered_map<int, std::string> names_;
+    std::vector<cv::Scalar> colors_;
+    std::unordered_map<int, Label> labels_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+/**
+ * @brief Sink for per-image results of the headless modes.
+ */
+class ResultWriter {
+public:
+    virtual ~ResultWriter() = default;
+
+    /**
+     * @brief Writes the results of one image. `error` is non-empty if the image could not be processed.
+     */
+    virtual void write(const std::string& path, const cv::Size& image_size,
+                       const std::vector<YoloResults>& results, const std::string& error) = 0;
+    virtual void flush() = 0;
+
+    /**
+     * @brief Creates a writer for `format` ("jsonl" or "bin") writing to `path` ("-" - stdout, jsonl only).
+     */
+    static std::unique_ptr<ResultWriter> create(const std::string& format, const std::string& path,
+                                                const std::unordered_map<int, std::string>& names);
+};
+
+/**
+ * @brief One JSON object per line:
+ * `{"path": ..., "width": ..., "height": ..., "detections": [{"class": 0, "name": "person", "conf": 0.9,
+ * "bbox": [x, y, w, h], "sub_class": 3, "sub_conf": 0.8, "keypoints": [...], "mask": {"size": [h, w], "counts": [...]}}]}`.
+ * `sub_class`/`sub_conf` are only present for boxes refined by a second-stage classifier.
+ *
+ * Masks are bbox-local and run-length encoded in row-major order, starting with a run of zeros.
+ */
+class JsonlResultWriter : public ResultWriter {
+public:
+    JsonlResultWriter(const std::string& path, const std::unordered_map<int, std::string>& names);
+    /**
+     * @brief Writes to `out`, which must outlive the writer (e.g. the real stdout after std::cout was redirected).
+     */
+    JsonlResultWriter(std::ostream& out, const std::unordered_map<int, std::string>& names);
+
+    void write(const std::string& path, const cv::Size& image_size,
+               const std::vector<YoloResults>& results, const std::string& error) override;
+    void flush() override;
+
+private:
+    std::ofstream file_;
+    std::ostream* out_;
+    std::unordered_map<int, std::string> names_;
+    std::string line_;
+};
+
+/**
+ * @brief Binary records, after a "HLMR" magic and a uint32 version:
+ * `uint32 path length, path bytes, int32 width, int32 height, uint32 payload length, payload`,
+ * where the payload is `encode_results` output (width, height and payload are 0/empty for images that failed).
+ * Second-stage `sub_class_idx`/`sub_conf` are not part of it; use JsonlResultWriter for refined results.
+ */
+class BinaryResultWriter : public ResultWriter {
+public:
+    static constexpr uint32_t MAGIC = 0x524D4C48;  // "HLMR"
+    static constexpr uint32_t VERSION = 1;
+
+    explicit BinaryResultWriter(const std::string& path);
+
+    void write(const std::string& path, const cv::Size& image_size,
+               const std::vector<YoloResults>& results, const std::string& error) override;
+    void flush() override;
+
+private:
+    std::ofstream file_;
+    std::vector<uint8_t> record_;
+};
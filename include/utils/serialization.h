@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+#include "nn/autobackend.h"
+
+/*
+ * Compact binary encoding of YoloResults (host byte order, meant for local IPC and result dumps):
+ *
+ *  uint32 count
+ *  count x {
+ *      int32  class_idx
+ *      float  conf
+ *      float  bbox x, y, width, height
+ *      uint16 keypoints count, followed by that many floats
+ *      uint16 mask rows, uint16 mask cols, followed by ceil(rows * cols / 8) bytes of row-major packed bits
+ *  }
+ */
+
+/**
+ * @brief Appends the encoded results to `out`.
+ */
+void encode_results(const std::vector<YoloResults>& results, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decodes results produced by encode_results.
+ *
+ * @return Number of bytes consumed. Throws std::runtime_error on truncated or malformed input.
+ */
+size_t decode_results(const uint8_t* data, size_t size, std::vector<YoloResults>& results);
+
+/**
+ * @brief Appends a binary CV_8U mask as packed bits (non-zero pixel - 1), row-major, MSB first.
+ */
+void pack_mask_bits(const cv::Mat& mask, std::vector<uint8_t>& out);
+
+/**
+ * @brief Inverse of pack_mask_bits: returns a CV_8U mask with 0/255 values.
+ */
+cv::Mat unpack_mask_bits(const uint8_t* bits, int rows, int cols);
@@ -0,0 +1,24 @@
+#pragma once
+#include <iostream>
+#include <ostream>
+
+/**
+ * @brief Points std::cout at stderr for its lifetime, so that model loading and other logs can't interleave with
+ * results streamed to the real stdout (`stdout_stream()`).
+ */
+class StdoutGuard {
+public:
+    StdoutGuard() : stdout_(std::cout.rdbuf()) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    ~StdoutGuard() {
+        std::cout.rdbuf(stdout_.rdbuf());
+    }
+    StdoutGuard(const StdoutGuard&) = delete;
+    StdoutGuard& operator=(const StdoutGuard&) = delete;
+
+    std::ostream& stdout_stream() { return stdout_; }
+
+private:
+    std::ostream stdout_;
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Fixed-size pool of worker threads executing tasks in FIFO order.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads Number of workers, 0 - one per hardware thread.
+     */
+    explicit ThreadPool(size_t threads = 0);
+    /**
+     * @param cpus Every worker is restricted to this CPU set (e.g. one NUMA node), see pin_current_thread().
+     */
+    ThreadPool(size_t threads, const std::vector<int>& cpus);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues `task` and returns a future for its result (or exception).
+     */
+    template <typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                throw std::runtime_error("ThreadPool: submit() on a stopped pool");
+            }
+            tasks_.emplace_back([packaged] { (*packaged)(); });
+        }
+        cv_.notify_one();
+        return future;
+    }
+
+    size_t size() const;
+
+    /**
+     * @brief Runs `body(begin, end)` over [0, count) in contiguous chunks of `min_chunk` items (the last may be
+     * shorter), on the pool and the calling thread, and waits for all of them. Chunks are handed out on demand,
+     * so uneven items balance out. The first exception is rethrown and stops further chunks from starting.
+     *
+     * Called from one of this pool's own workers it runs inline, so nested parallel loops can't deadlock.
+     */
+    void parallel_for(size_t count, const std::function<void(size_t begin, size_t end)>& body, size_t min_chunk = 1);
+
+    /**
+     * @brief Process-wide pool for Helmsman's own parallel work (pre/postprocessing, tiles, ...).
+     *
+     * Created on first use with the size set by configureGlobal(), one thread per hardware thread by default.
+     */
+    static ThreadPool& global();
+    /**
+     * @brief Sets the size of the global() pool. Only effective before its first use; returns false afterwards.
+     */
+    static bool configureGlobal(size_t threads);
+
+private:
+    void worker(const std::vector<int>& cpus);
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief Runtime settings found by `Helmsman --autotune` for one model on one kind of host.
+ */
+struct TunedConfig {
+    int intra_op_threads = 0;          ///< OnnxSessionConfig::intra_op_threads
+    bool parallel_execution = false;   ///< OnnxSessionConfig::parallel_execution
+    int batch_size = 1;                ///< images per predict_batch() call
+    int pipeline_depth = 1;            ///< predict_batch() calls in flight on one session
+    double images_per_second = 0.0;    ///< throughput measured with these settings
+};
+
+/**
+ * @brief 64-bit FNV-1a of the model file's bytes, as 16 hex digits. Throws std::runtime_error if it can't be read.
+ */
+std::string model_fingerprint(const std::string& model_path);
+
+/**
+ * @brief CPU model name and hardware thread count, e.g. "Intel(R) Xeon(R) Gold 6338 CPU @ 2.00GHz x64".
+ */
+std::string cpu_signature();
+
+/**
+ * @brief `$XDG_CACHE_HOME/helmsman/autotune.tsv`, falling back to `~/.cache/...` and then the working directory.
+ */
+std::string default_tuning_cache_path();
+
+/**
+ * @brief Tab-separated file of TunedConfigs keyed by model fingerprint, CPU signature and execution provider
+ * (the `--provider` value, a tuning measured on cpu says little about dnnl or openvino).
+ */
+class TuningCache {
+public:
+    explicit TuningCache(const std::string& path);
+
+    /**
+     * @brief Entry for the model on this host, false if the model or the host was never tuned.
+     */
+    bool lookup(const std::string& fingerprint, const std::string& cpu, const std::string& provider, TunedConfig& config) const;
+    /**
+     * @brief Adds or replaces the entry and rewrites the file (through a temporary file, so readers never see half of it).
+     */
+    void store(const std::string& fingerprint, const std::string& cpu, const std::string& provider, const TunedConfig& config) const;
+    /**
+     * @brief model_fingerprint() of the file, remembered in `<path>.models` by absolute path, size and mtime, so that
+     * a start with `--tuned` only hashes new or changed model files.
+     */
+    std::string fingerprint(const std::string& model_path) const;
+
+    const std::string& getPath() const;
+
+private:
+    std::string path_;
+};
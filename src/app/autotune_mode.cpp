@@ -0,0 +1,190 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "pipeline/frame_source.h"
+#include "utils/image_io.h"
+
+
+namespace {
+    constexpr size_t MAX_TUNING_INPUTS = 32;
+
+    // images of a directory or list file, a single image, the first frames of a video, or noise
+    std::vector<cv::Mat> load_tuning_inputs(const std::string& source) {
+        std::vector<cv::Mat> inputs;
+        if (source.empty()) {
+            for (size_t i = 0; i < 8; ++i) {
+                cv::Mat noise(720, 1280, CV_8UC3);
+                cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(255));
+                inputs.push_back(noise);
+            }
+            return inputs;
+        }
+        const std::filesystem::path path(source);
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (std::filesystem::is_directory(path) || ext == ".txt") {
+            for (const std::string& image_path : collect_image_paths(path)) {
+                cv::Mat image = cv::imread(image_path, cv::IMREAD_COLOR);
+                if (!image.empty()) {
+                    inputs.push_back(image);
+                }
+                if (inputs.size() >= MAX_TUNING_INPUTS) {
+                    break;
+                }
+            }
+        }
+        else if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
+            inputs.push_back(cv::imread(source, cv::IMREAD_COLOR));
+        }
+        else {
+            std::unique_ptr<FrameSource> video = open_frame_source(source);
+            cv::Mat frame;
+            while (inputs.size() < MAX_TUNING_INPUTS && video->read(frame)) {
+                inputs.push_back(frame.clone());
+            }
+        }
+        inputs.erase(std::remove_if(inputs.begin(), inputs.end(), [](const cv::Mat& m) { return m.empty(); }), inputs.end());
+        if (inputs.empty()) {
+            throw std::runtime_error("--autotune: no images or frames in " + source);
+        }
+        return inputs;
+    }
+
+    // images per second with `depth` threads each calling predict_batch() with `batch` images
+    double measure(AutoBackendOnnx& model, const std::vector<cv::Mat>& inputs, const PredictParams& params,
+                   int batch, int depth, double seconds) {
+        auto make_batch = [&](size_t offset) {
+            std::vector<cv::Mat> images;
+            for (int i = 0; i < batch; ++i) {
+                images.push_back(inputs[(offset + i) % inputs.size()]);
+            }
+            return images;
+        };
+        model.predict_batch(make_batch(0), { params });  // warm-up: kernel setup and arena growth aren't steady state
+
+        std::atomic<bool> stop{ false };
+        std::atomic<uint64_t> done{ 0 };
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int w = 0; w < depth; ++w) {
+            workers.emplace_back([&, w]() {
+                const std::vector<cv::Mat> images = make_batch(static_cast<size_t>(w) * batch);
+                while (!stop.load()) {
+                    model.predict_batch(images, { params });
+                    done += images.size();
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop.store(true);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(done.load()) / elapsed;
+    }
+
+    void print_trial(const TunedConfig& config) {
+        std::cout << "  intra=" << config.intra_op_threads << (config.parallel_execution ? " parallel" : " sequential")
+                  << " batch=" << config.batch_size << " depth=" << config.pipeline_depth << ": " << std::fixed
+                  << std::setprecision(1) << config.images_per_second << " img/s" << std::defaultfloat << std::endl;
+    }
+}
+
+
+int run_autotune(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    if (args.has("threads")) {
+        std::cerr << "Warning: --threads puts every session on the global pools, intra-op threads won't be tuned" << std::endl;
+    }
+    const double seconds = std::max(0.2, static_cast<double>(args.getFloat("tune-seconds", 2.0f)));
+    const std::vector<cv::Mat> inputs = load_tuning_inputs(args.get("autotune", ""));
+    const PredictParams params = options.params();
+    const std::string cache_path = args.get("tune-cache", default_tuning_cache_path());
+    const TuningCache cache(cache_path);
+    const std::string fingerprint = cache.fingerprint(options.model_path);
+    const std::string cpu = cpu_signature();
+    std::cout << "Autotuning " << options.model_path << " (" << fingerprint << ") on " << cpu << " with "
+              << inputs.size() << " inputs, " << seconds << " s per trial" << std::endl;
+
+    auto load = [&](const TunedConfig& config) {
+        OnnxSessionConfig session = options.session;
+        session.intra_op_threads = config.intra_op_threads;
+        session.parallel_execution = config.parallel_execution;
+        return std::make_unique<AutoBackendOnnx>(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), session);
+    };
+
+    // one knob at a time, in the order of their usual impact: threads, execution mode, batch, depth
+    const int hw = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> thread_counts;
+    for (int t = 1; t < hw; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(hw);
+
+    TunedConfig best;
+    std::unique_ptr<AutoBackendOnnx> model;
+    int64_t fixed_batch = 0;
+    for (int threads : thread_counts) {
+        TunedConfig trial = best;
+        trial.intra_op_threads = threads;
+        std::unique_ptr<AutoBackendOnnx> candidate = load(trial);
+        fixed_batch = candidate->getMaxBatch();
+        trial.batch_size = fixed_batch > 0 ? static_cast<int>(fixed_batch) : 1;
+        trial.images_per_second = measure(*candidate, inputs, params, trial.batch_size, 1, seconds);
+        print_trial(trial);
+        if (trial.images_per_second > best.images_per_second) {
+            best = trial;
+            model = std::move(candidate);
+        }
+    }
+    {
+        TunedConfig trial = best;
+        trial.parallel_execution = true;
+        std::unique_ptr<AutoBackendOnnx> candidate = load(trial);
+        trial.images_per_second = measure(*candidate, inputs, params, trial.batch_size, 1, seconds);
+        print_trial(trial);
+        if (trial.images_per_second > best.images_per_second) {
+            best = trial;
+            model = std::move(candidate);
+        }
+    }
+    if (fixed_batch <= 0) {
+        for (int batch : { 2, 4, 8, 16 }) {
+            TunedConfig trial = best;
+            trial.batch_size = batch;
+            trial.images_per_second = measure(*model, inputs, params, batch, 1, seconds);
+            print_trial(trial);
+            if (trial.images_per_second > best.images_per_second * 1.03) {  // not worth the latency for noise
+                best = trial;
+            }
+        }
+    }
+    for (int depth = 2; depth <= 4; ++depth) {
+        TunedConfig trial = best;
+        trial.pipeline_depth = depth;
+        trial.images_per_second = measure(*model, inputs, params, best.batch_size, depth, seconds);
+        print_trial(trial);
+        if (trial.images_per_second <= best.images_per_second * 1.03) {
+            break;
+        }
+        best = trial;
+    }
+
+    cache.store(fingerprint, cpu, options.provider, best);
+    std::cout << "Best:" << std::endl;
+    print_trial(best);
+    std::cout << "Saved to " << cache_path << ", use it with --tuned" << (args.has("tune-cache") ? "=" + cache_path : "") << std::endl;
+    return 0;
+}
@@ -0,0 +1,311 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "pipeline/crop_cascade.h"
+#include "pipeline/multi_model_runner.h"
+#include "pipeline/result_cache.h"
+#include "utils/image_io.h"
+#include "utils/memory.h"
+#include "utils/result_writer.h"
+#include "utils/stdout_guard.h"
+#include "utils/thread_pool.h"
+
+
+int run_batch(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    const std::string input = args.get("batch", "");
+    if (input.empty()) {
+        std::cerr << "Error: --batch needs a directory or an image list file\n";
+        return 1;
+    }
+    if (!args.get("refine", "").empty() && args.get("format", "jsonl") == "bin") {
+        // encode_results has no room for sub_class/sub_conf
+        std::cerr << "Error: --refine needs --format=jsonl, the binary format doesn't carry second-stage classes\n";
+        return 1;
+    }
+    std::vector<std::string> paths = collect_image_paths(input);
+    std::cerr << "Found " << paths.size() << " images in " << input << std::endl;
+
+    // results go to stdout by default: keep the model's loading logs off it
+    std::unique_ptr<StdoutGuard> stdout_guard;
+    if (args.get("out", "-") == "-") {
+        stdout_guard = std::make_unique<StdoutGuard>();
+    }
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+    std::unique_ptr<ResultWriter> writer;
+    if (stdout_guard && args.get("format", "jsonl") == "jsonl") {
+        writer = std::make_unique<JsonlResultWriter>(stdout_guard->stdout_stream(), model.getNames());
+    }
+    else {
+        writer = ResultWriter::create(args.get("format", "jsonl"), args.get("out", "-"), model.getNames());
+    }
+
+    // --refine=second.onnx: every detection crop also goes through a classify (or pose) model
+    std::unique_ptr<AutoBackendOnnx> refiner;
+    std::unique_ptr<CropCascade> cascade;
+    if (!args.get("refine", "").empty()) {
+        const std::string refine_path = args.get("refine", "");
+        refiner = std::make_unique<AutoBackendOnnx>(refine_path.c_str(), options.logid.c_str(), options.provider.c_str(),
+                                                    options.session);
+        CropCascadeConfig cascade_config;
+        cascade_config.classes = options.classes;
+        cascade_config.params = options.params();
+        cascade_config.params.classes.clear();
+        cascade_config.params.class_conf.clear();
+        cascade_config.params.conf = args.getFloat("refine-conf", 0.0f);
+        cascade = std::make_unique<CropCascade>(model, *refiner, cascade_config);
+    }
+
+    // --models=b.onnx,c.onnx: more models on the same images, sharing --model's preprocessed blob (MultiModelRunner).
+    // Each writes to its own file next to --out, e.g. results.b.jsonl, since class names differ between models
+    std::vector<std::unique_ptr<AutoBackendOnnx>> extra_models;
+    std::vector<std::unique_ptr<ResultWriter>> extra_writers;
+    std::unique_ptr<MultiModelRunner> runner;
+    if (!args.get("models", "").empty()) {
+        const std::filesystem::path out_path = args.get("out", "-");
+        if (out_path == "-" || cascade || args.getInt("cache-mb", 0) > 0) {
+            std::cerr << "Error: --models needs --out=file and can't be combined with --refine or --cache-mb\n";
+            return 1;
+        }
+        std::vector<AutoBackendOnnx*> models{ &model };
+        std::stringstream list(args.get("models", ""));
+        std::string extra_path;
+        while (std::getline(list, extra_path, ',')) {
+            if (extra_path.empty()) {
+                continue;
+            }
+            extra_models.push_back(std::make_unique<AutoBackendOnnx>(extra_path.c_str(), options.logid.c_str(),
+                                                                     options.provider.c_str(), options.session));
+            models.push_back(extra_models.back().get());
+            std::filesystem::path extra_out = out_path;
+            extra_out.replace_extension("." + std::filesystem::path(extra_path).stem().string() + out_path.extension().string());
+            extra_writers.push_back(ResultWriter::create(args.get("format", "jsonl"), extra_out.string(),
+                                                         extra_models.back()->getNames()));
+            std::cerr << "Results of " << extra_path << " go to " << extra_out.string() << std::endl;
+        }
+        runner = std::make_unique<MultiModelRunner>(models);
+    }
+
+    const int64_t model_batch = model.getMaxBatch();
+    const int default_batch = model_batch > 0 ? static_cast<int>(model_batch) : (options.has_tuned ? options.tuned.batch_size : 8);
+    const size_t batch_size = static_cast<size_t>(std::max(1, args.getInt("batch-size", default_batch)));
+    // decode on a dedicated pool: queued on ThreadPool::global() the lookahead decodes would sit in front of
+    // predict_batch's letterboxing and postprocessing. Half the cores by default, a quarter of a --threads budget;
+    // only a budget too small to spare a thread decodes on the global pool
+    size_t decode_threads = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+    if (args.has("threads")) {
+        decode_threads = static_cast<size_t>(std::max(0, args.getInt("threads", 0) / 4));
+    }
+    if (args.has("decode-threads")) {
+        decode_threads = static_cast<size_t>(std::max(1, args.getInt("decode-threads", 1)));
+    }
+    std::unique_ptr<ThreadPool> own_decoders;
+    if (decode_threads > 0) {
+        own_decoders = std::make_unique<ThreadPool>(decode_threads);
+    }
+    ThreadPool& decoders = own_decoders ? *own_decoders : ThreadPool::global();
+    // keep enough decodes in flight that the next batches are ready when forward() returns;
+    // with --low-memory only the next batch, every decoded image is a full frame held in RAM
+    const bool low_memory = options.session.low_memory;
+    const size_t lookahead = low_memory ? batch_size : std::max(batch_size * 2, decoders.size() * 2);
+    const cv::Size target_size = model.getCvSize();
+    const std::vector<PredictParams> params{ options.params() };
+
+    // --cache-mb=N: duplicate images (re-uploads) get the results of their first copy instead of a forward() call
+    std::unique_ptr<ResultCache> result_cache;
+    if (args.getInt("cache-mb", 0) > 0) {
+        ResultCacheConfig cache_config;
+        cache_config.max_bytes = static_cast<size_t>(args.getInt("cache-mb", 0)) << 20;
+        result_cache = std::make_unique<ResultCache>(cache_config);
+    }
+
+    // --low-memory streams results straight from the postprocessing workers, which the stages that need a whole batch
+    // of results at once can't do
+    const bool stream_results = low_memory && !cascade && !result_cache && !runner;
+    if (low_memory && !stream_results) {
+        std::cerr << "Warning: --low-memory keeps whole batches of results with --refine, --cache-mb or --models, "
+                     "masks are not streamed to the writer" << std::endl;
+    }
+
+    std::deque<std::future<DecodedImage>> pending;
+    size_t next = 0;
+    auto refill = [&]() {
+        while (next < paths.size() && pending.size() < lookahead) {
+            std::string path = paths[next++];
+            pending.push_back(decoders.submit([path, target_size]() { return decode_image_for_model(path, target_size); }));
+        }
+    };
+
+    size_t processed = 0;
+    size_t failed = 0;
+    size_t detections = 0;
+    std::vector<DecodedImage> decoded;
+    std::vector<cv::Mat> images;
+    decoded.reserve(batch_size);
+    images.reserve(batch_size);
+
+    auto start = std::chrono::steady_clock::now();
+    refill();
+    while (!pending.empty()) {
+        decoded.clear();
+        images.clear();
+        while (!pending.empty() && decoded.size() < batch_size) {
+            DecodedImage image = pending.front().get();
+            pending.pop_front();
+            if (!image.error.empty()) {
+                writer->write(image.path, image.raw_size, {}, image.error);
+                for (std::unique_ptr<ResultWriter>& extra_writer : extra_writers) {
+                    extra_writer->write(image.path, image.raw_size, {}, image.error);
+                }
+                ++failed;
+                continue;
+            }
+            images.push_back(image.image);
+            decoded.push_back(std::move(image));
+        }
+        refill();  // decoding of the following batches overlaps with inference of this one
+        if (decoded.empty()) {
+            continue;
+        }
+
+        if (runner) {
+            std::vector<std::vector<std::vector<YoloResults>>> results;
+            try {
+                results = runner->predict_batch(images, std::vector<PredictParams>(runner->getModels().size(), params[0]));
+            }
+            catch (const std::exception& e) {
+                for (const DecodedImage& image : decoded) {
+                    writer->write(image.path, image.raw_size, {}, e.what());
+                    for (std::unique_ptr<ResultWriter>& extra_writer : extra_writers) {
+                        extra_writer->write(image.path, image.raw_size, {}, e.what());
+                    }
+                }
+                failed += decoded.size();
+                continue;
+            }
+            for (size_t m = 0; m < results.size(); ++m) {
+                ResultWriter& model_writer = m == 0 ? *writer : *extra_writers[m - 1];
+                for (size_t i = 0; i < decoded.size(); ++i) {
+                    rescale_results(results[m][i], decoded[i].image.size(), decoded[i].raw_size);
+                    model_writer.write(decoded[i].path, decoded[i].raw_size, results[m][i], "");
+                    detections += results[m][i].size();
+                }
+            }
+            processed += decoded.size();
+            continue;
+        }
+
+        if (stream_results) {
+            // stream every image's results (and masks) to the writer as soon as they are decoded instead of holding the
+            // batch's. Pool workers finish out of order: a result is only held until the ones before it are written,
+            // so records keep input order
+            std::mutex writer_mutex;
+            std::atomic<size_t> batch_detections{ 0 };
+            std::vector<std::vector<YoloResults>> held(decoded.size());
+            std::vector<bool> done(decoded.size(), false);
+            size_t next_write = 0;
+            try {
+                model.predict_batch(images, params, [&](size_t i, std::vector<YoloResults>& image_results) {
+                    rescale_results(image_results, decoded[i].image.size(), decoded[i].raw_size);
+                    batch_detections += image_results.size();
+                    std::lock_guard<std::mutex> lock(writer_mutex);
+                    held[i] = std::move(image_results);
+                    done[i] = true;
+                    for (; next_write < decoded.size() && done[next_write]; ++next_write) {
+                        writer->write(decoded[next_write].path, decoded[next_write].raw_size, held[next_write], "");
+                        std::vector<YoloResults>().swap(held[next_write]);
+                    }
+                });
+            }
+            catch (const std::exception& e) {
+                for (size_t i = next_write; i < decoded.size(); ++i) {
+                    writer->write(decoded[i].path, decoded[i].raw_size, {}, e.what());
+                }
+                failed += decoded.size() - next_write;
+                processed += next_write;
+                continue;
+            }
+            detections += batch_detections.load();
+            processed += decoded.size();
+            continue;
+        }
+
+        std::vector<std::vector<YoloResults>> results;
+        try {
+            results = result_cache ? result_cache->predict_batch(model, images, params) : model.predict_batch(images, params);
+        }
+        catch (const std::exception& e) {
+            for (const DecodedImage& image : decoded) {
+                writer->write(image.path, image.raw_size, {}, e.what());
+            }
+            failed += decoded.size();
+            continue;
+        }
+
+        if (cascade) {
+            try {
+                cascade->refine(images, results);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Warning: second stage failed for a batch: " << e.what() << std::endl;
+            }
+        }
+
+        for (size_t i = 0; i < decoded.size(); ++i) {
+            rescale_results(results[i], decoded[i].image.size(), decoded[i].raw_size);
+            writer->write(decoded[i].path, decoded[i].raw_size, results[i], "");
+            detections += results[i].size();
+        }
+        processed += decoded.size();
+    }
+    writer->flush();
+    for (std::unique_ptr<ResultWriter>& extra_writer : extra_writers) {
+        extra_writer->flush();
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Processed " << processed << " images (" << failed << " failed, " << detections << " detections) in "
+              << elapsed << " s: " << (elapsed > 0.0 ? processed / elapsed : 0.0) << " img/s"
+              << " [batch " << batch_size << ", " << decoders.size() << " decode threads]" << std::endl;
+    if (runner) {
+        const MultiModelRunnerStats runner_stats = runner->getStats();
+        std::cerr << "Shared preprocessing " << runner_stats.preprocess_ms << " ms";
+        for (size_t m = 0; m < runner_stats.model_ms.size(); ++m) {
+            std::cerr << ", " << runner->getModels()[m]->getModelPath() << " " << runner_stats.model_ms[m] << " ms";
+        }
+        std::cerr << std::endl;
+    }
+    if (cascade) {
+        const CropCascadeStats cascade_stats = cascade->getStats();
+        std::cerr << "Second stage: " << cascade_stats.crops << " crops, " << cascade_stats.refined << " refined, "
+                  << cascade_stats.refine_ms << " ms total" << std::endl;
+    }
+    if (low_memory || args.has("mem-report")) {
+        const ModelMemoryStats model_memory = model.getMemoryStats();
+        std::cerr << "Memory: " << format_memory_breakdown(memory_breakdown()) << std::endl;
+        std::cerr << "Model memory: file " << format_bytes(static_cast<double>(model_memory.model_file_bytes))
+                  << ", peak input " << format_bytes(static_cast<double>(model_memory.peak_input_bytes))
+                  << ", peak outputs " << format_bytes(static_cast<double>(model_memory.peak_output_bytes))
+                  << ", peak masks per image " << format_bytes(static_cast<double>(model_memory.peak_mask_bytes))
+                  << " (+" << format_bytes(static_cast<double>(model_memory.peak_mask_scratch_bytes)) << " scratch per mask)" << std::endl;
+    }
+    if (result_cache) {
+        const ResultCacheStats cache_stats = result_cache->getStats();
+        std::cerr << "Result cache: " << cache_stats.hits << "/" << cache_stats.lookups << " hits ("
+                  << 100.0 * cache_stats.hit_rate() << " %), " << cache_stats.entries << " entries, "
+                  << cache_stats.bytes / 1024 << " KiB, " << cache_stats.evictions << " evicted, "
+                  << cache_stats.hash_ms << " ms hashing" << std::endl;
+    }
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,72 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+
+#include "pipeline/frame_archive.h"
+#include "utils/memory.h"
+
+
+namespace {
+    std::atomic<bool> stop_requested{ false };
+
+    void request_stop(int) {
+        stop_requested.store(true);
+    }
+}
+
+
+int run_capture(const CliArgs& args) {
+    const std::string out = args.get("capture", "");
+    if (out.empty() || args.positional().empty()) {
+        std::cerr << "Error: --capture=trace.hfa needs a video source\n";
+        return 1;
+    }
+    const std::string uri = args.positional()[0];
+    const bool blobs = args.has("blobs");
+    const size_t max_frames = static_cast<size_t>(std::max(0, args.getInt("max-frames", 0)));
+
+    // --blobs: store what predict_batch would feed the network, so a replay skips decoding and letterboxing
+    std::unique_ptr<AutoBackendOnnx> model;
+    ModelOptions options;
+    if (blobs) {
+        options = ModelOptions::fromArgs(args);
+        model = std::make_unique<AutoBackendOnnx>(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+    }
+    const std::vector<PredictParams> params{ options.params() };
+
+    std::unique_ptr<FrameSource> source = open_frame_source(uri);
+    FrameArchiveWriter writer(out, blobs ? FrameArchiveKind::BLOBS : FrameArchiveKind::FRAMES);
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    // live sources keep their arrival times, files their nominal ones (decode speed says nothing about the trace)
+    const bool live = source->isLive();
+    const double fps = source->getFps();
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<cv::Mat> images(1);
+    std::vector<float> blob;
+    size_t frames = 0;
+    while (!stop_requested.load() && (max_frames == 0 || frames < max_frames) && source->read(images[0])) {
+        const double timestamp_ms = live || fps <= 0.0
+            ? std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+            : frames * 1000.0 / fps;
+        if (blobs) {
+            int64_t batch_size = 0;
+            const cv::Size input_size = model->fill_batch(images, 0, 1, params, blob, batch_size);
+            writer.appendBlob(blob.data(), input_size, model->getCh(), images[0].size(), timestamp_ms);
+        }
+        else {
+            writer.append(images[0], timestamp_ms);
+        }
+        ++frames;
+    }
+    writer.close();
+    std::cout << "Captured " << frames << (blobs ? " blobs" : " frames") << " from " << source->getName() << " to " << out
+              << " (" << format_bytes(static_cast<double>(writer.bytes())) << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <opencv2/core.hpp>
+
+#include "utils/affinity.h"
+#include "utils/thread_pool.h"
+
+
+ModelOptions ModelOptions::fromArgs(const CliArgs& args) {
+    ModelOptions options;
+    options.model_path = args.get("model", options.model_path);
+    options.provider = args.get("provider", options.provider);
+    options.conf = args.getFloat("conf", options.conf);
+    options.iou = args.getFloat("iou", options.iou);
+    options.mask_threshold = args.getFloat("mask-threshold", options.mask_threshold);
+    // boxes are always returned; kpts/masks keep only that extra output
+    const std::string outputs = args.get("outputs", "all");
+    if (outputs != "all") {
+        if (outputs != "boxes" && outputs != "kpts" && outputs != "masks") {
+            throw std::invalid_argument("--outputs must be one of boxes, kpts, masks, all; got " + outputs);
+        }
+        options.with_masks = outputs == "masks";
+        options.with_keypoints = outputs == "kpts";
+    }
+    // `id` or `id:conf`, comma separated
+    std::stringstream classes(args.get("classes", ""));
+    std::string item;
+    while (std::getline(classes, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        try {
+            const size_t colon = item.find(':');
+            const std::string id = item.substr(0, colon);
+            const std::string conf = colon == std::string::npos ? "" : item.substr(colon + 1);
+            size_t parsed = 0;
+            const int class_id = std::stoi(id, &parsed);
+            if (class_id < 0 || parsed != id.size()) {
+                throw std::invalid_argument(item);
+            }
+            float class_conf = 0.0f;
+            if (colon != std::string::npos) {
+                class_conf = std::stof(conf, &parsed);
+                if (parsed != conf.size()) {
+                    throw std::invalid_argument(item);
+                }
+            }
+            options.classes.push_back(class_id);
+            options.class_conf.push_back(class_conf);
+        }
+        catch (const std::exception&) {
+            throw std::invalid_argument("--classes expects id or id:conf entries, comma separated; got '" + item + "'");
+        }
+    }
+    if (args.has("bgr")) {
+        options.conversion_code = -1;  // the model was exported for BGR input
+    }
+    if (args.has("tuned")) {
+        const std::string cache_path = args.get("tuned", "").empty() ? default_tuning_cache_path() : args.get("tuned", "");
+        const TuningCache cache(cache_path);
+        options.has_tuned = cache.lookup(cache.fingerprint(options.model_path), cpu_signature(), options.provider, options.tuned);
+        if (options.has_tuned) {
+            std::cerr << "Tuned settings from " << cache_path << ": " << options.tuned.intra_op_threads << " intra-op threads, "
+                      << (options.tuned.parallel_execution ? "parallel" : "sequential") << " execution, batch "
+                      << options.tuned.batch_size << ", depth " << options.tuned.pipeline_depth << std::endl;
+            options.session.intra_op_threads = options.tuned.intra_op_threads;
+            options.session.parallel_execution = options.tuned.parallel_execution;
+        }
+        else {
+            std::cerr << "Warning: " << cache_path << " has no entry for this model and provider on this host, run Helmsman --autotune" << std::endl;
+        }
+    }
+    options.session.intra_op_threads = args.getInt("intra-threads", options.session.intra_op_threads);
+    if (args.has("parallel-exec")) {
+        options.session.parallel_execution = true;
+    }
+    options.session.low_memory = args.has("low-memory");
+    options.session.arena_max_bytes = static_cast<size_t>(std::max(0, args.getInt("arena-mb", 0))) << 20;
+    return options;
+}
+
+PredictParams ModelOptions::params() const {
+    PredictParams params;
+    params.conf = conf;
+    params.iou = iou;
+    params.mask_threshold = mask_threshold;
+    params.conversionCode = conversion_code;
+    params.with_masks = with_masks;
+    params.with_keypoints = with_keypoints;
+    params.classes = classes;
+    params.class_conf = class_conf;
+    return params;
+}
+
+void apply_thread_budget(const CliArgs& args) {
+    // pin before any pool exists: every thread created afterwards (ORT, ours, OpenCV) inherits the mask
+    if (!args.get("cpus", "").empty()) {
+        pin_current_thread(parse_cpu_list(args.get("cpus", "")));
+    }
+    const int threads = args.getInt("threads", 0);
+    if (threads <= 0) {
+        return;
+    }
+    OnnxThreadingConfig config;
+    config.intra_op_threads = threads;
+    config.inter_op_threads = 1;
+    config.allow_spinning = args.has("spin");
+    OnnxModelBase::useGlobalThreadPools(config);
+    ThreadPool::configureGlobal(static_cast<size_t>(threads));
+    cv::setNumThreads(0);
+}
@@ -0,0 +1,287 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "pipeline/multi_stream_engine.h"
+#include "pipeline/result_cache.h"
+#include "utils/affinity.h"
+#include "utils/memory.h"
+#include "utils/result_writer.h"
+#include "utils/thread_pool.h"
+
+
+namespace {
+    std::atomic<bool> stop_requested{ false };
+
+    void request_stop(int) {
+        stop_requested.store(true);
+    }
+
+    struct StreamSpec {
+        std::string uri;
+        StreamConfig config;
+    };
+
+    /**
+     * `<uri> [name=cam1] [priority=2] [fps=10] [lossless] [node=1]`, one stream per line, '#' starts a comment.
+     */
+    std::vector<StreamSpec> read_stream_list(const std::string& path, const StreamConfig& defaults) {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("Cannot open stream list: " + path);
+        }
+        std::vector<StreamSpec> specs;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream tokens(line);
+            StreamSpec spec{ "", defaults };
+            if (!(tokens >> spec.uri) || spec.uri[0] == '#') {
+                continue;
+            }
+            std::string option;
+            while (tokens >> option) {
+                const size_t eq = option.find('=');
+                const std::string key = option.substr(0, eq);
+                const std::string value = eq == std::string::npos ? "" : option.substr(eq + 1);
+                if (key == "name") {
+                    spec.config.name = value;
+                }
+                else if (key == "priority") {
+                    spec.config.priority = std::stoi(value);
+                }
+                else if (key == "fps") {
+                    spec.config.max_fps = std::stod(value);
+                }
+                else if (key == "lossless") {
+                    spec.config.lossless = true;
+                }
+                else if (key == "node") {
+                    spec.config.node = std::stoi(value);
+                }
+                else {
+                    std::cerr << "Warning: unknown stream option '" << option << "' in " << path << std::endl;
+                }
+            }
+            specs.push_back(spec);
+        }
+        return specs;
+    }
+
+    void print_stream_stats(const std::vector<StreamStats>& stats, const MultiStreamEngineStats& engine_stats) {
+        std::cout << std::fixed << std::setprecision(1);
+        for (const StreamStats& s : stats) {
+            std::cout << "  " << s.name << ": " << s.processed << " processed (" << s.fps << " fps), "
+                      << s.replaced << " replaced, " << s.capped << " capped, " << s.failed << " failed, latency "
+                      << s.mean_latency_ms << " ms mean / " << s.max_latency_ms << " ms max"
+                      << (s.finished ? " [finished]" : "") << "\n";
+        }
+        std::cout << "  " << engine_stats.batches << " batches, " << std::setprecision(2)
+                  << engine_stats.mean_batch_size() << " frames per batch" << std::endl;
+        std::cout << std::defaultfloat;
+    }
+}
+
+
+int run_multi_stream(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+
+    StreamConfig defaults;
+    defaults.params = options.params();
+    defaults.max_fps = args.getFloat("max-fps", 0.0f);
+    defaults.lossless = args.has("lossless");
+    std::vector<StreamSpec> specs;
+    if (!args.get("streams", "").empty()) {
+        specs = read_stream_list(args.get("streams", ""), defaults);
+    }
+    for (const std::string& uri : args.positional()) {
+        specs.push_back(StreamSpec{ uri, defaults });
+    }
+    if (specs.empty()) {
+        std::cerr << "Error: --multi needs video sources (positional or --streams=list.txt)\n";
+        return 1;
+    }
+
+    // a few sessions shared by all streams instead of one model per stream; their prepacked weights
+    // and allocator arena are shared too unless --no-share-weights is given.
+    // --numa: the same set of sessions per NUMA node, each replica with its own weights, pinned to its node
+    const bool share_weights = !args.has("no-share-weights");
+    const bool numa = args.has("numa");
+    // NUMA nodes restricted to the CPUs the process may use (--cpus), nodes left without any are skipped
+    std::vector<NumaNode> nodes;
+    if (numa) {
+        const std::vector<int> allowed = current_thread_cpus();
+        for (NumaNode node : numa_topology()) {
+            node.cpus.erase(std::remove_if(node.cpus.begin(), node.cpus.end(), [&allowed](int cpu) {
+                return !std::binary_search(allowed.begin(), allowed.end(), cpu);
+            }), node.cpus.end());
+            if (!node.cpus.empty()) {
+                nodes.push_back(node);
+            }
+        }
+        if (nodes.empty()) {
+            std::cerr << "Error: --numa found no node with a CPU allowed by --cpus\n";
+            return 1;
+        }
+    }
+    else {
+        nodes.push_back(NumaNode());
+    }
+    // a tuned pipeline depth means that many concurrent Run() calls paid off: load that many real sessions
+    const int sessions_per_node = std::max(1, args.getInt("sessions", options.has_tuned ? options.tuned.pipeline_depth : 1));
+    const int session_count = sessions_per_node * static_cast<int>(nodes.size());
+    std::vector<std::unique_ptr<AutoBackendOnnx>> models;
+    std::vector<std::unique_ptr<ThreadPool>> node_pools;
+    std::vector<AutoBackendOnnx*> sessions;
+    MultiStreamEngineConfig config;
+    const size_t rss_before = current_rss_bytes();
+    size_t rss_first = rss_before;
+    for (const NumaNode& node : nodes) {
+        OnnxSessionConfig session_config = options.session;
+        if (share_weights) {
+            session_config.prepacked_weights = numa ? std::make_shared<Ort::PrepackedWeightsContainer>()
+                                                    : OnnxModelBase::sharedPrepackedWeights();
+            session_config.use_env_allocators = !numa;  // the env arena would live on a single node
+        }
+        // the node's CPUs are the budget of all its sessions: each gets its own slice for its ORT pool, and the
+        // node's pre/postprocessing pool is sized like one slice instead of the whole node
+        const size_t slice = std::max<size_t>(1, node.cpus.size() / static_cast<size_t>(sessions_per_node));
+        if (numa) {
+            node_pools.push_back(std::make_unique<ThreadPool>(slice, node.cpus));
+        }
+        for (int i = 0; i < sessions_per_node; ++i) {
+            std::vector<int> session_cpus;
+            for (size_t k = 0; numa && k < slice; ++k) {
+                session_cpus.push_back(node.cpus[(static_cast<size_t>(i) * slice + k) % node.cpus.size()]);
+            }
+            if (numa && !args.has("threads")) {
+                session_config.intra_op_cpus = session_cpus;
+            }
+            // load on a thread pinned to the node so the weights and arena are first touched there
+            std::exception_ptr error;
+            std::thread loader([&]() {
+                try {
+                    if (numa) {
+                        pin_current_thread(node.cpus);
+                    }
+                    models.push_back(std::make_unique<AutoBackendOnnx>(options.model_path.c_str(), options.logid.c_str(),
+                                                                       options.provider.c_str(), session_config));
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            });
+            loader.join();
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if (numa) {
+                models.back()->setThreadPool(node_pools.back().get());
+                config.session_nodes.push_back(node.id);
+                config.session_cpus.push_back(session_cpus);
+            }
+            sessions.push_back(models.back().get());
+            if (sessions.size() == 1) {
+                rss_first = current_rss_bytes();
+            }
+        }
+    }
+    if (numa) {
+        std::cout << "NUMA: " << nodes.size() << " node(s), " << sessions_per_node << " session(s) per node" << std::endl;
+    }
+    const size_t rss_all = current_rss_bytes();
+    if (rss_before > 0) {
+        std::cout << "Session memory (" << (share_weights ? "shared" : "separate")
+                  << " prepacked weights): first session +" << format_bytes(static_cast<double>(rss_first) - rss_before);
+        if (session_count > 1) {
+            std::cout << ", each additional +"
+                      << format_bytes((static_cast<double>(rss_all) - rss_first) / (session_count - 1));
+        }
+        std::cout << ", total RSS " << format_bytes(static_cast<double>(rss_all)) << std::endl;
+    }
+
+    std::unique_ptr<ResultWriter> writer;
+    std::mutex writer_mutex;
+    if (!args.get("out", "").empty()) {
+        writer = ResultWriter::create(args.get("format", "jsonl"), args.get("out", ""), models[0]->getNames());
+    }
+    std::vector<std::string> stream_names;
+
+    std::unique_ptr<ResultCache> result_cache;
+    if (args.getInt("cache-mb", 0) > 0) {
+        ResultCacheConfig cache_config;
+        cache_config.max_bytes = static_cast<size_t>(args.getInt("cache-mb", 0)) << 20;
+        result_cache = std::make_unique<ResultCache>(cache_config);
+        config.result_cache = result_cache.get();
+    }
+    config.max_batch = args.getInt("max-batch", options.has_tuned ? options.tuned.batch_size : config.max_batch);
+    config.max_delay = std::chrono::microseconds(args.getInt("max-delay-us", static_cast<int>(config.max_delay.count())));
+    MultiStreamEngine engine(sessions, config, [&](const StreamFrame& frame, std::vector<YoloResults>& results) {
+        if (!writer) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        writer->write(stream_names[frame.stream] + "#" + std::to_string(frame.index), frame.image.size(), results, "");
+    });
+
+    const bool pace = args.has("pace");
+    for (size_t i = 0; i < specs.size(); ++i) {
+        StreamSpec& spec = specs[i];
+        if (numa && spec.config.node < 0) {
+            spec.config.node = nodes[i % nodes.size()].id;  // spread streams over the nodes
+        }
+        else if (!numa) {
+            spec.config.node = -1;
+        }
+        std::unique_ptr<FrameSource> source = open_frame_source(spec.uri, pace);
+        stream_names.push_back(spec.config.name.empty() ? source->getName() : spec.config.name);
+        engine.addStream(std::move(source), spec.config);
+    }
+    std::cout << "Running " << specs.size() << " streams on " << session_count << " session(s), batches of up to "
+              << config.max_batch << std::endl;
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    const auto interval = std::chrono::milliseconds(static_cast<int>(args.getFloat("stats-interval", 5.0f) * 1000.0f));
+    engine.start();
+    auto next_report = std::chrono::steady_clock::now() + interval;
+    while (!engine.waitFor(std::chrono::milliseconds(100))) {
+        if (stop_requested.load()) {
+            break;
+        }
+        if (interval.count() > 0 && std::chrono::steady_clock::now() >= next_report) {
+            next_report += interval;
+            print_stream_stats(engine.getStreamStats(), engine.getStats());
+        }
+    }
+    engine.stop();
+    if (writer) {
+        writer->flush();
+    }
+
+    std::cout << "Final stream stats:" << std::endl;
+    print_stream_stats(engine.getStreamStats(), engine.getStats());
+    if (result_cache) {
+        const ResultCacheStats cache_stats = result_cache->getStats();
+        std::cout << "Result cache: " << cache_stats.hits << "/" << cache_stats.lookups << " hits ("
+                  << 100.0 * cache_stats.hit_rate() << " %), " << cache_stats.entries << " entries, "
+                  << format_bytes(static_cast<double>(cache_stats.bytes)) << std::endl;
+    }
+    if (options.session.low_memory || args.has("mem-report")) {
+        std::cout << "Memory: " << format_memory_breakdown(memory_breakdown()) << std::endl;
+    }
+    else {
+        std::cout << "Peak RSS: " << format_bytes(static_cast<double>(peak_rss_bytes())) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "pipeline/raw_frame_source.h"
+#include "utils/memory.h"
+#include "utils/result_writer.h"
+#include "utils/stdout_guard.h"
+#include "utils/thread_pool.h"
+
+
+namespace {
+    cv::Size parse_frame_size(const std::string& text) {
+        const size_t x = text.find('x');
+        if (x == std::string::npos) {
+            throw std::invalid_argument("Frame size must be WxH, got '" + text + "'");
+        }
+        return cv::Size(std::stoi(text.substr(0, x)), std::stoi(text.substr(x + 1)));
+    }
+}
+
+
+int run_raw(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    const cv::Size frame_size = parse_frame_size(args.get("raw", ""));
+    const RawPixelFormat pix_fmt = parse_raw_pixel_format(args.get("pix-fmt", "bgr24"));
+    const std::string input = args.get("input", "-");
+    const std::string out = args.get("out", "-");
+    const std::string format = args.get("format", "jsonl");
+    // frames per predict_batch call: 1 keeps per-frame latency lowest, more trades it for throughput
+    const size_t batch_size = static_cast<size_t>(std::max(1, args.getInt("batch-size", 1)));
+
+    std::unique_ptr<StdoutGuard> stdout_guard;
+    if (out == "-") {
+        stdout_guard = std::make_unique<StdoutGuard>();
+    }
+    RawFrameSource source(input, frame_size, pix_fmt, args.getFloat("fps", 0.0f));
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+    std::unique_ptr<ResultWriter> writer;
+    if (stdout_guard && format == "jsonl") {
+        writer = std::make_unique<JsonlResultWriter>(stdout_guard->stdout_stream(), model.getNames());
+    }
+    else {
+        writer = ResultWriter::create(format, out, model.getNames());
+    }
+    const std::vector<PredictParams> params{ options.params() };
+    std::cerr << "Reading " << frame_size.width << "x" << frame_size.height << " "
+              << args.get("pix-fmt", "bgr24") << " frames (" << format_bytes(static_cast<double>(source.getFrameBytes()))
+              << " each) from " << source.getName() << std::endl;
+
+    // two sets of frame buffers: the reader fills one while the model runs on the other. Both are allocated by
+    // the first reads and reused from then on
+    std::vector<cv::Mat> buffers[2] = { std::vector<cv::Mat>(batch_size), std::vector<cv::Mat>(batch_size) };
+    ThreadPool reader(1);
+    auto fill = [&](std::vector<cv::Mat>& images) {
+        size_t count = 0;
+        while (count < images.size() && source.read(images[count])) {
+            ++count;
+        }
+        return count;
+    };
+
+    using clock = std::chrono::steady_clock;
+    const auto started = clock::now();
+    uint64_t frames = 0;
+    double infer_ms = 0.0;
+    std::vector<cv::Mat> batch;
+    batch.reserve(batch_size);
+    int current = 0;
+    std::future<size_t> pending = reader.submit([&]() { return fill(buffers[0]); });
+    size_t count = pending.get();
+    while (count > 0) {
+        std::vector<cv::Mat>& images = buffers[current];
+        current ^= 1;
+        const bool ended = count < batch_size;  // the input ended mid-batch
+        if (!ended) {
+            pending = reader.submit([&, next = current]() { return fill(buffers[next]); });
+        }
+
+        batch.assign(images.begin(), images.begin() + static_cast<std::ptrdiff_t>(count));  // headers only
+        const auto t0 = clock::now();
+        const std::vector<std::vector<YoloResults>> results = model.predict_batch(batch, params);
+        infer_ms += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            writer->write("frame#" + std::to_string(frames + i), frame_size, results[i], "");
+        }
+        frames += count;
+        writer->flush();  // downstream sees every batch as soon as it is done
+        count = ended ? 0 : pending.get();
+    }
+    writer->flush();
+
+    const double seconds = std::chrono::duration<double>(clock::now() - started).count();
+    std::cerr << std::fixed << std::setprecision(1) << "Processed " << frames << " frames in " << seconds << " s ("
+              << (seconds > 0.0 ? frames / seconds : 0.0) << " fps), " << std::setprecision(2)
+              << (frames ? infer_ms / frames : 0.0) << " ms per frame in the model" << std::defaultfloat << std::endl;
+    if (options.session.low_memory || args.has("mem-report")) {
+        std::cerr << "Memory: " << format_memory_breakdown(memory_breakdown()) << std::endl;
+    }
+    return 0;
+}
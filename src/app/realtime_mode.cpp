@@ -0,0 +1,194 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <memory>
+
+#include <opencv2/highgui.hpp>
+
+#include "pipeline/annotated_video_writer.h"
+#include "pipeline/latency_governor.h"
+#include "pipeline/latest_frame_grabber.h"
+#include "pipeline/model_cascade.h"
+#include "pipeline/resolution_controller.h"
+#include "utils/plotting.h"
+
+
+namespace {
+    std::atomic<bool> stop_requested{ false };
+
+    void request_stop(int) {
+        stop_requested.store(true);
+    }
+}
+
+
+int run_realtime(const CliArgs& args) {
+    if (args.positional().empty()) {
+        std::cerr << "Error: --realtime needs a camera index, video file or stream URL\n";
+        return 1;
+    }
+    ModelOptions options = ModelOptions::fromArgs(args);
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+
+    // --escalate=larger.onnx: the model above runs first, frames it is unsure about go to the larger one
+    std::unique_ptr<AutoBackendOnnx> large;
+    std::unique_ptr<ModelCascade> cascade;
+    if (!args.get("escalate", "").empty()) {
+        const std::string large_path = args.get("escalate", "");
+        large = std::make_unique<AutoBackendOnnx>(large_path.c_str(), options.logid.c_str(), options.provider.c_str(),
+                                                  options.session);
+        ModelCascadeConfig cascade_config;
+        cascade_config.band = args.getFloat("band", cascade_config.band);
+        cascade_config.min_ambiguous = static_cast<size_t>(std::max(1, args.getInt("min-ambiguous",
+            static_cast<int>(cascade_config.min_ambiguous))));
+        cascade_config.count_jump = args.getInt("count-jump", cascade_config.count_jump);
+        cascade_config.regions = args.has("escalate-regions");
+        cascade = std::make_unique<ModelCascade>(model, *large, cascade_config);
+    }
+
+    LatencyGovernorConfig governor_config;
+    governor_config.budget = std::chrono::milliseconds(args.getInt("budget-ms", static_cast<int>(governor_config.budget.count())));
+    // --adaptive-res: the input size follows the objects in view, the governor only drops masks
+    std::unique_ptr<ResolutionController> resolution;
+    if (args.has("adaptive-res")) {
+        ResolutionControllerConfig resolution_config;
+        resolution_config.min_object_px = args.getFloat("min-object-px", resolution_config.min_object_px);
+        resolution_config.target_ms = args.getFloat("res-target-ms", static_cast<float>(governor_config.budget.count()) / 2.0f);
+        resolution = std::make_unique<ResolutionController>(model, resolution_config);
+    }
+    const std::vector<QualityLevel> ladder = LatencyGovernor::makeLadder(model.getTask() == YoloTasks::SEGMENT,
+                                                                         model.hasDynamicInputSize() && !resolution);
+    LatencyGovernor governor(ladder, governor_config);
+
+    LatestFrameGrabber grabber(args.positional()[0], !args.has("no-pace"));
+    std::cout << "Real-time inference on " << args.positional()[0] << " (" << grabber.getFrameSize().width << "x"
+              << grabber.getFrameSize().height << " @ " << grabber.getFps() << " fps), budget "
+              << governor_config.budget.count() << " ms" << std::endl;
+
+    const bool show = !args.has("no-show");
+    ResultPlotter plotter(model.getNames(), generateRandomColors(model.getNc(), model.getCh()));
+    std::unique_ptr<AnnotatedVideoWriter> writer;
+    if (args.has("save") && !args.get("save", "").empty()) {
+        AnnotatedVideoWriterConfig writer_config;
+        writer_config.fps = grabber.getFps();
+        writer_config.fourcc = args.get("fourcc", writer_config.fourcc);
+        writer_config.drop_when_full = true;  // never let the encoder hold back inference
+        writer = std::make_unique<AnnotatedVideoWriter>(args.get("save", ""), grabber.getFrameSize(), plotter, writer_config);
+    }
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    const PredictParams base_params = options.params();
+    const cv::Size base_size = model.getCvSize();
+    size_t last_level = governor.levelIndex();
+    // --abort-late: give up on a frame once it is older than the budget instead of finishing it late. Off by default:
+    // on a host where even the lowest quality level misses the budget, every frame would be aborted
+    const bool abort_late = args.has("abort-late");
+    uint64_t aborted = 0;
+    GrabbedFrame frame;
+    while (!stop_requested.load() && grabber.next(frame)) {
+        if (!governor.admit(frame.captured_at)) {
+            continue;
+        }
+        const QualityLevel& level = governor.level();
+        PredictParams params = base_params;
+        params.with_masks = base_params.with_masks && level.with_masks;
+        if (resolution) {
+            params.imgsz = resolution->next(frame.image.size());
+        }
+        else if (level.scale != 1.0) {
+            params.imgsz = cv::Size(static_cast<int>(std::lround(base_size.width * level.scale)),
+                                    static_cast<int>(std::lround(base_size.height * level.scale)));
+        }
+
+        if (abort_late) {
+            params.deadline = frame.captured_at + governor_config.budget;
+        }
+        const LatencyGovernor::clock::time_point infer_start = LatencyGovernor::clock::now();
+        std::vector<YoloResults> results;
+        try {
+            results = cascade ? cascade->predict(frame.image, params)
+                              : std::move(model.predict_batch({ frame.image }, { params })[0]);
+        }
+        catch (const DeadlineExceededError&) {
+            ++aborted;
+            governor.record(frame.captured_at, LatencyGovernor::clock::now());
+            continue;
+        }
+        if (cascade && cascade->getStats().frames == 200 && cascade->getStats().escalation_rate() > 0.5) {
+            std::cerr << "Warning: the cascade escalated " << cascade->getStats().escalation_rate() * 100.0
+                      << "% of the first 200 frames, the large model does most of the work (narrow --band or raise --min-ambiguous)"
+                      << std::endl;
+        }
+        if (resolution) {
+            resolution->record(results, frame.image.size(),
+                std::chrono::duration<double, std::milli>(LatencyGovernor::clock::now() - infer_start).count());
+        }
+        governor.record(frame.captured_at, LatencyGovernor::clock::now());
+        if (governor.levelIndex() != last_level) {
+            last_level = governor.levelIndex();
+            std::cout << "Quality level " << last_level << ": " << governor.level().describe() << std::endl;
+        }
+
+        if (writer) {
+            writer->write(show ? frame.image.clone() : std::move(frame.image), show ? results : std::move(results));
+        }
+        if (show) {
+            plotter.draw(frame.image, results);
+            cv::imshow("Real-time Inference", frame.image);
+            if (cv::waitKey(1) == 27) { // ESC
+                break;
+            }
+        }
+    }
+    grabber.stop();
+    if (writer) {
+        writer->close();
+    }
+    if (show) {
+        cv::destroyAllWindows();
+    }
+
+    LatestFrameGrabberStats grab_stats = grabber.getStats();
+    LatencyGovernorStats stats = governor.getStats();
+    std::cout << "Grabbed " << grab_stats.grabbed << " frames, skipped " << grab_stats.skipped
+              << " while busy, dropped " << stats.dropped_stale << " stale, processed " << stats.processed
+              << " (" << stats.over_budget << " over budget";
+    if (abort_late) {
+        std::cout << ", " << aborted << " of them aborted at the deadline";
+    }
+    std::cout << ")" << std::endl;
+    std::cout << "Latency: mean " << stats.mean_latency_ms << " ms, max " << stats.max_latency_ms << " ms" << std::endl;
+    for (size_t i = 0; i < ladder.size(); ++i) {
+        std::cout << "  level " << i << " (" << ladder[i].describe() << "): " << stats.frames_per_level[i] << " frames" << std::endl;
+    }
+    if (resolution) {
+        const ResolutionControllerStats resolution_stats = resolution->getStats();
+        std::cout << "Adaptive resolution (" << resolution_stats.probes << " probes):" << std::endl;
+        for (size_t i = 0; i < resolution_stats.frames_per_size.size(); ++i) {
+            std::cout << "  " << resolution_stats.sizes[i] << " px: " << resolution_stats.frames_per_size[i] << " frames";
+            if (resolution_stats.smoothed_ms_per_size[i] >= 0.0) {
+                std::cout << ", ~" << resolution_stats.smoothed_ms_per_size[i] << " ms";
+            }
+            std::cout << std::endl;
+        }
+    }
+    if (cascade) {
+        const ModelCascadeStats cascade_stats = cascade->getStats();
+        std::cout << "Escalated " << cascade_stats.escalated << " of " << cascade_stats.frames << " frames ("
+                  << cascade_stats.escalation_rate() * 100.0 << "%, " << cascade_stats.escalated_regions << " as "
+                  << cascade_stats.regions << " regions, " << cascade_stats.count_jumps << " on count jumps); small model "
+                  << cascade_stats.small_ms << " ms, large model " << cascade_stats.large_ms << " ms total" << std::endl;
+    }
+    if (writer) {
+        AnnotatedVideoWriterStats writer_stats = writer->getStats();
+        std::cout << "Saved " << writer_stats.written << " frames (" << writer_stats.dropped << " dropped by the writer)" << std::endl;
+    }
+    return 0;
+}
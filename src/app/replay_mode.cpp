@@ -0,0 +1,115 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "pipeline/frame_archive.h"
+
+
+namespace {
+    double percentile(std::vector<double> values, double q) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        const size_t k = std::min(values.size() - 1, static_cast<size_t>(q * values.size()));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    }
+
+    void print_stage(const char* name, const std::vector<double>& ms) {
+        if (ms.empty()) {
+            return;
+        }
+        std::cout << "  " << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(2)
+                  << percentile(ms, 0.5) << " ms p50, " << percentile(ms, 0.99) << " ms p99" << std::defaultfloat << std::endl;
+    }
+}
+
+
+int run_replay(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    const std::string path = args.get("replay", "");
+    if (path.empty()) {
+        std::cerr << "Error: --replay needs a frame archive (see --capture)\n";
+        return 1;
+    }
+    const int loops = std::max(1, args.getInt("loops", 1));
+    FrameArchive archive(path, !args.has("no-preload"));
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+    const std::vector<PredictParams> params{ options.params() };
+    const bool blobs = archive.getKind() == FrameArchiveKind::BLOBS;
+    // --once: time predict_once (which converts its input in place, hence the copy) instead of predict_batch
+    const bool once = args.has("once") && !blobs;
+    std::cout << "Replaying " << archive.size() << (blobs ? " blobs" : " frames") << " from " << path << ", "
+              << loops << " loop(s)" << std::endl;
+
+    using clock = std::chrono::steady_clock;
+    auto ms_since = [](clock::time_point t) { return std::chrono::duration<double, std::milli>(clock::now() - t).count(); };
+    std::vector<double> preprocess_ms, infer_ms;
+    std::vector<cv::Mat> images(1);
+    std::vector<float> blob;
+    std::vector<std::vector<YoloResults>> results(1);
+    std::vector<cv::Size> raw_sizes(1);
+    cv::Mat once_input;
+    float conf = options.conf;
+    float iou = options.iou;
+    float mask_threshold = options.mask_threshold;
+    // a fixed-batch graph needs a full batch: the archived image goes into a zero-padded copy
+    const int64_t max_batch = model.getMaxBatch();
+    size_t detections = 0;
+    // a blob holds the channels of the model that captured it; predict_blob reads getCh() planes
+    for (size_t i = 0; blobs && i < archive.size(); ++i) {
+        if (CV_MAT_CN(archive.entry(i).type) != model.getCh()) {
+            std::cerr << "Error: " << path << " holds " << CV_MAT_CN(archive.entry(i).type) << "-channel blobs, the model takes "
+                      << model.getCh() << " channels\n";
+            return 1;
+        }
+    }
+
+    const clock::time_point start = clock::now();
+    for (int loop = 0; loop < loops; ++loop) {
+        for (size_t i = 0; i < archive.size(); ++i) {
+            if (blobs) {
+                const FrameArchiveEntry& entry = archive.entry(i);
+                const cv::Size input_size(entry.cols, entry.rows);
+                raw_sizes[0] = cv::Size(entry.raw_cols, entry.raw_rows);
+                float* data = archive.blob(i);
+                if (max_batch > 1) {
+                    blob.assign(static_cast<size_t>(max_batch) * entry.bytes / sizeof(float), 0.0f);
+                    std::copy(data, data + entry.bytes / sizeof(float), blob.begin());
+                    data = blob.data();
+                }
+                const clock::time_point t = clock::now();
+                results = model.predict_blob(data, max_batch > 0 ? max_batch : 1, input_size, CV_MAT_CN(entry.type),
+                                             raw_sizes, params);
+                infer_ms.push_back(ms_since(t));
+            }
+            else if (once) {
+                archive.frame(i).copyTo(once_input);
+                const clock::time_point t = clock::now();
+                results[0] = model.predict_once(once_input, conf, iou, mask_threshold, options.conversion_code, false);
+                infer_ms.push_back(ms_since(t));
+            }
+            else {
+                images[0] = archive.frame(i);
+                clock::time_point t = clock::now();
+                int64_t batch_size = 0;
+                const cv::Size input_size = model.fill_batch(images, 0, 1, params, blob, batch_size);
+                preprocess_ms.push_back(ms_since(t));
+                t = clock::now();
+                model.infer_batch(blob, batch_size, input_size, images, 0, 1, params, results);
+                infer_ms.push_back(ms_since(t));
+            }
+            detections += results[0].size();
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    const size_t frames = archive.size() * static_cast<size_t>(loops);
+    std::cout << "Replayed " << frames << " in " << elapsed << " s (" << (elapsed > 0.0 ? frames / elapsed : 0.0)
+              << " fps), " << detections << " detections" << std::endl;
+    print_stage("preprocess", preprocess_ms);
+    print_stage(blobs ? "infer+post" : once ? "predict_once" : "infer+post", infer_ms);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "app/modes.h"
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+
+#include "server/inference_server.h"
+
+
+namespace {
+    std::atomic<InferenceServer*> active_server{ nullptr };
+
+    void stop_active_server(int) {
+        InferenceServer* server = active_server.load();
+        if (server != nullptr) {
+            server->stop();
+        }
+    }
+}
+
+
+int run_serve(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+
+    InferenceServerConfig config;
+    config.socket_path = args.get("serve", config.socket_path);
+    if (config.socket_path.empty()) {
+        config.socket_path = InferenceServerConfig().socket_path;
+    }
+    config.shm_name = args.get("shm-name", config.shm_name);
+    config.slot_count = static_cast<uint32_t>(args.getInt("slots", static_cast<int>(config.slot_count)));
+    config.slot_bytes = static_cast<uint64_t>(args.getInt("slot-mb", static_cast<int>(config.slot_bytes >> 20) + 1)) << 20;
+    config.batching.max_batch = args.getInt("max-batch", options.has_tuned ? options.tuned.batch_size : config.batching.max_batch);
+    config.batching.max_delay = std::chrono::microseconds(args.getInt("max-delay-us", static_cast<int>(config.batching.max_delay.count())));
+    config.request_timeout = std::chrono::milliseconds(args.getInt("timeout-ms", 0));
+    config.with_masks = options.with_masks;
+    config.with_keypoints = options.with_keypoints;
+    config.classes = options.classes;
+    config.class_conf = options.class_conf;
+
+    InferenceServer server(model, config);
+    active_server.store(&server);
+    std::signal(SIGINT, stop_active_server);
+    std::signal(SIGTERM, stop_active_server);
+    server.run();
+    active_server.store(nullptr);
+    std::cout << "Server stopped" << std::endl;
+    return 0;
+}
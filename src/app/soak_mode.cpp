@@ -0,0 +1,289 @@
+#include "app/modes.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+
+#include "pipeline/frame_source.h"
+#include "utils/memory.h"
+#include "utils/plotting.h"
+
+
+namespace {
+    enum Stage { DECODE, PREDICT_ONCE, PREDICT_BATCH, RENDER, STAGE_COUNT };
+    const char* const STAGE_NAMES[STAGE_COUNT] = { "decode", "predict_once", "predict_batch", "render" };
+
+    struct Sample {
+        double t_s = 0.0;
+        size_t rss = 0;
+        size_t heap = 0;
+        size_t fds = 0;
+        size_t threads = 0;
+        uint64_t frames = 0;
+        std::array<double, STAGE_COUNT> p50{};
+        std::array<double, STAGE_COUNT> p99{};
+    };
+
+    size_t open_fd_count() {
+#if defined(__linux__)
+        std::error_code error;
+        size_t count = 0;
+        for (std::filesystem::directory_iterator it("/proc/self/fd", error), end; !error && it != end; it.increment(error)) {
+            ++count;
+        }
+        return count > 0 ? count - 1 : 0;  // the iterator's own descriptor
+#else
+        return 0;
+#endif
+    }
+
+    size_t thread_count() {
+        std::ifstream status("/proc/self/status");
+        std::string key;
+        size_t value = 0;
+        while (status >> key) {
+            if (key == "Threads:" && status >> value) {
+                return value;
+            }
+            status.ignore(1 << 16, '\n');
+        }
+        return 0;
+    }
+
+    double percentile(std::vector<double> values, double q) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        const size_t k = std::min(values.size() - 1, static_cast<size_t>(q * values.size()));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    }
+
+    double median(std::vector<double> values) {
+        return percentile(std::move(values), 0.5);
+    }
+
+    // least-squares slope of y over x
+    double slope(const std::vector<double>& x, const std::vector<double>& y) {
+        const double n = static_cast<double>(x.size());
+        if (x.size() < 2) {
+            return 0.0;
+        }
+        double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+        for (size_t i = 0; i < x.size(); ++i) {
+            sx += x[i];
+            sy += y[i];
+            sxx += x[i] * x[i];
+            sxy += x[i] * y[i];
+        }
+        const double denominator = n * sxx - sx * sx;
+        return denominator != 0.0 ? (n * sxy - sx * sy) / denominator : 0.0;
+    }
+
+    template <typename F>
+    std::vector<double> column(const std::vector<Sample>& samples, F field) {
+        std::vector<double> values;
+        for (const Sample& sample : samples) {
+            values.push_back(static_cast<double>(field(sample)));
+        }
+        return values;
+    }
+
+    constexpr double MIB = 1024.0 * 1024.0;
+}
+
+
+int run_soak(const CliArgs& args) {
+    ModelOptions options = ModelOptions::fromArgs(args);
+    const std::string video = args.get("soak", "").empty() ? "../video/test.mp4" : args.get("soak", "");
+    const double duration_s = args.getFloat("soak-minutes", 60.0f) * 60.0;
+    const double sample_s = std::max(1.0f, args.getFloat("sample-seconds", 10.0f));
+    // allocator arenas, caches and kernels settle during the first minutes; growth before that is not a leak
+    const double warmup_s = std::min(static_cast<double>(args.getFloat("warmup-seconds", 60.0f)), duration_s / 4.0);
+    const double max_rss_growth_mb = args.getFloat("max-rss-growth-mb", 16.0f);
+    const int max_fd_growth = args.getInt("max-fd-growth", 0);
+    const int max_thread_growth = args.getInt("max-thread-growth", 0);
+    const double max_latency_drift = args.getFloat("max-latency-drift", 0.25f);
+    const std::string report_path = args.get("report", "soak_report.tsv");
+
+    AutoBackendOnnx model(options.model_path.c_str(), options.logid.c_str(), options.provider.c_str(), options.session);
+    ResultPlotter plotter(model.getNames(), generateRandomColors(model.getNc(), model.getCh()));
+    const std::vector<PredictParams> params{ options.params() };
+    float conf = options.conf;
+    float iou = options.iou;
+    float mask_threshold = options.mask_threshold;
+
+    std::cout << "Soak test: " << video << " for " << duration_s / 60.0 << " min, sampling every " << sample_s
+              << " s after a " << warmup_s << " s warm-up" << std::endl;
+
+    using clock = std::chrono::steady_clock;
+    std::unique_ptr<FrameSource> source = open_frame_source(video);
+    std::array<std::vector<double>, STAGE_COUNT> window;
+    std::vector<Sample> samples;
+    cv::Mat frame, once_input, canvas;
+    uint64_t frames = 0;
+    uint64_t passes = 1;
+    const clock::time_point start = clock::now();
+    clock::time_point next_sample = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(sample_s));
+    auto ms_since = [](clock::time_point t) { return std::chrono::duration<double, std::milli>(clock::now() - t).count(); };
+
+    while (std::chrono::duration<double>(clock::now() - start).count() < duration_s) {
+        clock::time_point t = clock::now();
+        if (!source->read(frame)) {
+            source = open_frame_source(video);  // reopened every pass: leaks in open/close show up too
+            ++passes;
+            if (!source->read(frame)) {
+                throw std::runtime_error("--soak: no frames in " + video);
+            }
+        }
+        window[DECODE].push_back(ms_since(t));
+
+        // the single-image path as in the plain video mode; predict_once converts its input in place
+        t = clock::now();
+        frame.copyTo(once_input);
+        std::vector<YoloResults> once = model.predict_once(once_input, conf, iou, mask_threshold, options.conversion_code, false);
+        window[PREDICT_ONCE].push_back(ms_since(t));
+
+        t = clock::now();
+        std::vector<std::vector<YoloResults>> batch = model.predict_batch({ frame }, params);
+        window[PREDICT_BATCH].push_back(ms_since(t));
+
+        t = clock::now();
+        frame.copyTo(canvas);
+        plotter.draw(canvas, batch[0]);
+        window[RENDER].push_back(ms_since(t));
+        ++frames;
+
+        if (clock::now() < next_sample) {
+            continue;
+        }
+        next_sample = std::max(next_sample, clock::now() - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(sample_s)))
+            + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(sample_s));  // don't burst after a stall
+        Sample sample;
+        sample.t_s = std::chrono::duration<double>(clock::now() - start).count();
+        const MemoryBreakdown memory = memory_breakdown();
+        sample.rss = memory.rss;
+        sample.heap = memory.heap_in_use;
+        sample.fds = open_fd_count();
+        sample.threads = thread_count();
+        sample.frames = frames;
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            sample.p50[s] = percentile(window[s], 0.5);
+            sample.p99[s] = percentile(window[s], 0.99);
+            window[s].clear();
+        }
+        samples.push_back(sample);
+        std::cout << std::fixed << std::setprecision(1) << "  " << sample.t_s << " s: RSS " << sample.rss / MIB
+                  << " MiB, " << sample.fds << " fds, " << sample.threads << " threads, predict_once p50 "
+                  << sample.p50[PREDICT_ONCE] << " ms, predict_batch p50 " << sample.p50[PREDICT_BATCH] << " ms"
+                  << std::defaultfloat << std::endl;
+    }
+
+    // baseline: first quarter of the samples after the warm-up, final: last quarter
+    std::vector<Sample> steady;
+    for (const Sample& sample : samples) {
+        if (sample.t_s >= warmup_s) {
+            steady.push_back(sample);
+        }
+    }
+    const size_t quarter = std::max<size_t>(1, steady.size() / 4);
+    const std::vector<Sample> baseline(steady.begin(), steady.begin() + std::min(quarter, steady.size()));
+    const std::vector<Sample> final_window(steady.end() - std::min(quarter, steady.size()), steady.end());
+    auto growth = [&](auto field) {
+        return median(column(final_window, field)) - median(column(baseline, field));
+    };
+
+    std::vector<std::string> failures;
+    const bool conclusive = steady.size() >= 4;
+    const double rss_growth_mb = conclusive ? growth([](const Sample& s) { return s.rss; }) / MIB : 0.0;
+    const double heap_growth_mb = conclusive ? growth([](const Sample& s) { return s.heap; }) / MIB : 0.0;
+    const double fd_growth = conclusive ? growth([](const Sample& s) { return s.fds; }) : 0.0;
+    const double thread_growth = conclusive ? growth([](const Sample& s) { return s.threads; }) : 0.0;
+    const double rss_slope = conclusive
+        ? slope(column(steady, [](const Sample& s) { return s.t_s; }), column(steady, [](const Sample& s) { return s.rss; })) * 3600.0 / MIB
+        : 0.0;
+    std::array<double, STAGE_COUNT> baseline_p50{}, final_p50{}, drift{};
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        if (!conclusive) {
+            break;
+        }
+        baseline_p50[s] = median(column(baseline, [s](const Sample& x) { return x.p50[s]; }));
+        final_p50[s] = median(column(final_window, [s](const Sample& x) { return x.p50[s]; }));
+        drift[s] = baseline_p50[s] > 0.0 ? final_p50[s] / baseline_p50[s] - 1.0 : 0.0;
+        if (s != DECODE && drift[s] > max_latency_drift) {  // decode cost follows the content, not our code
+            failures.push_back(std::string(STAGE_NAMES[s]) + " latency +" + std::to_string(static_cast<int>(drift[s] * 100.0)) + "%");
+        }
+    }
+    if (rss_growth_mb > max_rss_growth_mb) {
+        failures.push_back("RSS +" + std::to_string(static_cast<int>(rss_growth_mb)) + " MiB");
+    }
+    if (fd_growth > max_fd_growth) {
+        failures.push_back("fds +" + std::to_string(static_cast<int>(fd_growth)));
+    }
+    if (thread_growth > max_thread_growth) {
+        failures.push_back("threads +" + std::to_string(static_cast<int>(thread_growth)));
+    }
+    const std::string verdict = !conclusive ? "INCONCLUSIVE" : failures.empty() ? "PASS" : "FAIL";
+
+    // key/value summary then the sample table: diff two reports to compare releases
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << "# helmsman soak report v1\n";
+    report << "model\t" << options.model_path << "\n";
+    report << "model_fingerprint\t" << model_fingerprint(options.model_path) << "\n";
+    report << "cpu\t" << cpu_signature() << "\n";
+    report << "provider\t" << model.getProvider() << "\n";
+    report << "low_memory\t" << (options.session.low_memory ? 1 : 0) << "\n";
+    report << "video\t" << video << "\n";
+    report << "duration_s\t" << std::chrono::duration<double>(clock::now() - start).count() << "\n";
+    report << "frames\t" << frames << "\n";
+    report << "passes\t" << passes << "\n";
+    report << "rss_growth_mb\t" << rss_growth_mb << "\n";
+    report << "rss_slope_mb_per_h\t" << rss_slope << "\n";
+    report << "heap_growth_mb\t" << heap_growth_mb << "\n";
+    report << "fd_growth\t" << fd_growth << "\n";
+    report << "thread_growth\t" << thread_growth << "\n";
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        report << "p50_ms." << STAGE_NAMES[s] << "\t" << baseline_p50[s] << "\t" << final_p50[s] << "\t" << drift[s] * 100.0 << "%\n";
+    }
+    report << "verdict\t" << verdict << "\n";
+    std::string reasons;
+    for (const std::string& failure : failures) {
+        reasons += (reasons.empty() ? "" : "; ") + failure;
+    }
+    report << "failures\t" << reasons << "\n";
+    report << "\n# t_s\trss_mb\theap_mb\tfds\tthreads\tframes";
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        report << "\t" << STAGE_NAMES[s] << "_p50\t" << STAGE_NAMES[s] << "_p99";
+    }
+    report << "\n";
+    for (const Sample& sample : samples) {
+        report << sample.t_s << "\t" << sample.rss / MIB << "\t" << sample.heap / MIB << "\t" << sample.fds << "\t"
+               << sample.threads << "\t" << sample.frames;
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            report << "\t" << sample.p50[s] << "\t" << sample.p99[s];
+        }
+        report << "\n";
+    }
+    std::ofstream(report_path) << report.str();
+
+    std::cout << std::fixed << std::setprecision(2) << "Soak " << verdict << ": " << frames << " frames in " << passes
+              << " passes, RSS " << (rss_growth_mb >= 0.0 ? "+" : "") << rss_growth_mb << " MiB (" << rss_slope
+              << " MiB/h), fds +" << fd_growth << ", threads +" << thread_growth << std::defaultfloat << std::endl;
+    if (!failures.empty()) {
+        std::cout << "  " << reasons << std::endl;
+    }
+    if (!conclusive) {
+        std::cerr << "Warning: fewer than 4 samples after the warm-up, run longer or sample more often" << std::endl;
+    }
+    std::cout << "Report written to " << report_path << std::endl;
+    return verdict == "FAIL" ? 3 : 0;
+}
@@ -3,12 +3,19 @@
 #include "../include/nn/onnx_model_base.h"
 #include "../include/nn/autobackend.h"
 #include "../include/utils/augment.h"
+#include "../include/utils/cli.h"
+#include "../include/app/modes.h"
+#include "../include/utils/plotting.h"
+#include "../include/pipeline/annotated_video_writer.h"
+#include "../include/pipeline/frame_source.h"
+#include <chrono>
 #include <opencv2/opencv.hpp>
 #include <filesystem>
 #include <iostream>
 #include <algorithm>
-#include <random>
+#include <memory>
 #include <vector>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
@@ -42,133 +49,107 @@ std::vector<int> kptColorIndices = {
     0, 0, 0, 9, 9, 9, 9, 9, 9
 };
 
-cv::Scalar generateRandomColor(int numChannels) {
-    if (numChannels < 1 || numChannels > 3)
-        throw std::invalid_argument("Invalid number of channels. Must be between 1 and 3.");
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis(0, 255);
-
-    cv::Scalar color;
-    for (int i = 0; i < numChannels; i++) {
-        color[i] = dis(gen);
+static int run(int argc, char** argv) {
+    CliArgs args(argc, argv);
+    apply_thread_budget(args);
+    if (args.has("capture")) {
+        return run_capture(args);
     }
-    return color;
-}
-
-std::vector<cv::Scalar> generateRandomColors(int class_names_num, int numChannels) {
-    std::vector<cv::Scalar> colors;
-    for (int i = 0; i < class_names_num; i++) {
-        colors.push_back(generateRandomColor(numChannels));
+    if (args.has("replay")) {
+        return run_replay(args);
     }
-    return colors;
-}
-
-/**
- * @brief Overlays detection/mask/labels on the input image.
- *        Removed the blocking waitKey() call so that the video loop won’t freeze.
- */
-void plot_results(cv::Mat img,
-                  std::vector<YoloResults>& results,
-                  std::vector<cv::Scalar> color,
-                  const std::unordered_map<int, std::string>& names,
-                  const cv::Size& shape)
-{
-    cv::Mat mask = img.clone();
-    for (int i = 0; i < (int)results.size(); i++) {
-        float left = results[i].bbox.x;
-        float top  = results[i].bbox.y;
-
-        // Draw bounding box
-        rectangle(img, results[i].bbox, color[results[i].class_idx], 2);
-
-        // Get class name
-        std::string class_name;
-        auto it = names.find(results[i].class_idx);
-        if (it != names.end()) {
-            class_name = it->second;
-        } else {
-            std::cerr << "Warning: class_idx not found in names for class_idx = "
-                      << results[i].class_idx << std::endl;
-            class_name = std::to_string(results[i].class_idx);
-        }
-
-        // If mask is present, apply it
-        if (results[i].mask.rows && results[i].mask.cols > 0) {
-            mask(results[i].bbox).setTo(color[results[i].class_idx], results[i].mask);
-        }
-
-        // Build label
-        std::stringstream labelStream;
-        labelStream << class_name << " " << std::fixed << std::setprecision(2)
-                    << results[i].conf;
-        std::string label = labelStream.str();
-
-        // Draw label background
-        cv::Size text_size = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.6, 2, nullptr);
-        cv::Rect rect_to_fill(static_cast<int>(left - 1),
-                              static_cast<int>(top - text_size.height - 5),
-                              text_size.width + 2,
-                              text_size.height + 5);
-        rectangle(img, rect_to_fill, color[results[i].class_idx], -1);
-
-        // Put text
-        putText(img, label,
-                cv::Point(static_cast<int>(left - 1.5), static_cast<int>(top - 2.5)),
-                cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(255,255,255), 2);
+    if (args.has("raw")) {
+        return run_raw(args);
     }
-
-    // Combine mask & image
-    addWeighted(img, 0.6, mask, 0.4, 0, img);
-
-    // Removed blocking waitKey(),
-    // so this function no longer blocks the video loop.
-    // If you want to see it here for debugging, you could do:
-    // cv::imshow("Debug Plot", img);
-    // cv::waitKey(1); // or a small delay
-}
-
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: Helmsman <image_or_video_path>\n";
+    if (args.has("soak")) {
+        return run_soak(args);
+    }
+    if (args.has("autotune")) {
+        return run_autotune(args);
+    }
+    if (args.has("serve")) {
+        return run_serve(args);
+    }
+    if (args.has("batch")) {
+        return run_batch(args);
+    }
+    if (args.has("realtime")) {
+        return run_realtime(args);
+    }
+    if (args.has("multi")) {
+        return run_multi_stream(args);
+    }
+    if (args.positional().empty()) {
+        std::cerr << "Usage: Helmsman [--model=path.onnx] [--conf=0.3] [--iou=0.45] [--threads=N] [--cpus=list] [--low-memory] [--arena-mb=N] [--save[=out.mp4]] [--no-show] <image_or_video_path>\n"
+                     "       Helmsman --serve[=/tmp/helmsman.sock] [--slots=8] [--slot-mb=6] [--max-batch=8] [--max-delay-us=2000] [--timeout-ms=0]\n"
+                     "       Helmsman --batch=<dir|list.txt> [--out=results.jsonl] [--format=jsonl|bin] [--batch-size=8] [--decode-threads=N] [--refine=cls.onnx] [--models=b.onnx,c.onnx] [--cache-mb=0] [--mem-report]\n"
+                     "       Helmsman --realtime [--budget-ms=100] [--abort-late] [--no-pace] [--save=out.mp4] [--no-show] [--escalate=larger.onnx] [--adaptive-res] <camera_index|video|url>\n"
+                     "       Helmsman --autotune[=images/|video.mp4] [--tune-seconds=2] [--tune-cache=path]  (then --tuned in any mode)\n"
+                     "       Helmsman --soak[=video/test.mp4] [--soak-minutes=60] [--sample-seconds=10] [--max-rss-growth-mb=16] [--max-latency-drift=0.25] [--report=soak_report.tsv]\n"
+                     "       Helmsman --capture=trace.hfa [--blobs] [--max-frames=N] <camera_index|video|url>\n"
+                     "       Helmsman --replay=trace.hfa [--loops=1] [--once] [--no-preload]\n"
+                     "       Helmsman --raw=WxH [--pix-fmt=bgr24|nv12] [--input=-|fifo] [--out=-] [--format=jsonl|bin] [--batch-size=1] [--fps=0]\n"
+                     "       Helmsman --multi [--streams=list.txt] [--sessions=1] [--numa] [--no-share-weights] [--max-batch=8] [--max-fps=0] [--lossless] [--cache-mb=0] [--mem-report] [--out=results.jsonl] <source>...\n";
         return 1;
     }
 
-    std::string inputPath = argv[1];
+    std::string inputPath = args.positional()[0];
     fs::path filePath(inputPath);
     std::string ext = filePath.extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
-    // Model settings (adjust paths as needed)
-    const std::string modelPath   = "../checkpoints/best.onnx";
+    // Model settings (adjust paths as needed or pass --model=..., --conf=..., etc.)
+    ModelOptions options = ModelOptions::fromArgs(args);
+    const std::string& modelPath = options.model_path;
     // Use CPUExecutionProvider (this must match what your onnx_model_base expects)
-    const std::string onnx_provider = OnnxProviders::CPUExecutionProvider;
-    const std::string onnx_logid  = "yolov8_inference";
-    float mask_threshold = 0.5f;
-    float conf_threshold = 0.3f;
-    float iou_threshold  = 0.45f;
-    int conversion_code  = cv::COLOR_BGR2RGB;
+    const std::string& onnx_provider = options.provider;
+    const std::string& onnx_logid = options.logid;
+    float mask_threshold = options.mask_threshold;
+    float conf_threshold = options.conf;
+    float iou_threshold  = options.iou;
+    int conversion_code  = options.conversion_code;
 
     // Initialize model
-    AutoBackendOnnx model(modelPath.c_str(), onnx_logid.c_str(), onnx_provider.c_str());
+    AutoBackendOnnx model(modelPath.c_str(), onnx_logid.c_str(), onnx_provider.c_str(), options.session);
 
     // Generate random colors for bounding boxes/masks
-    std::vector<cv::Scalar> colors = generateRandomColors(model.getNc(), model.getCh());
+    ResultPlotter plotter(model.getNames(), generateRandomColors(model.getNc(), model.getCh()));
+    // --save[=path] writes the annotated output, --no-show skips the preview window
+    const bool show = !args.has("no-show");
+    std::string savePath = args.get("save", "");
+    if (args.has("save") && savePath.empty()) {
+        const std::string saveExt = ext == ".hfa" ? ".mp4" : filePath.extension().string();  // archives are input only
+        savePath = (filePath.parent_path() / (filePath.stem().string() + "_annotated" + saveExt)).string();
+    }
 
-    if (ext == ".avi" || ext == ".mp4" || ext == ".mov" || ext == ".mkv") {
-        // --- Video ---
-        cv::VideoCapture cap(inputPath);
-        if (!cap.isOpened()) {
-            std::cerr << "Error: Unable to open video: " << inputPath << "\n";
+    if (ext == ".avi" || ext == ".mp4" || ext == ".mov" || ext == ".mkv" || ext == ".hfa") {
+        // --- Video (or a frame archive) ---
+        std::unique_ptr<FrameSource> cap;
+        try {
+            cap = open_frame_source(inputPath);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: Unable to open video: " << inputPath << " (" << e.what() << ")\n";
             return 1;
         }
         std::cout << "Processing video: " << inputPath << std::endl;
 
+        // Rendering and encoding run on the writer's thread, the loop below only does inference
+        std::unique_ptr<AnnotatedVideoWriter> writer;
+        if (!savePath.empty()) {
+            AnnotatedVideoWriterConfig writerConfig;
+            writerConfig.fps = cap->getFps();
+            writerConfig.fourcc = args.get("fourcc", writerConfig.fourcc);
+            cv::Size frameSize = cap->getFrameSize();
+            writer = std::make_unique<AnnotatedVideoWriter>(savePath, frameSize, plotter, writerConfig);
+            std::cout << "Saving annotated video to: " << savePath << std::endl;
+        }
+
         cv::Mat frame;
+        size_t frames = 0;
+        auto start = std::chrono::steady_clock::now();
         while (true) {
-            cap >> frame;
-            if (frame.empty()) {
+            if (!cap->read(frame)) {
                 std::cout << "End of video\n";
                 break;
             }
@@ -179,9 +160,19 @@ int main(int argc, char** argv) {
             // Inference
             std::vector<YoloResults> results = model.predict_once(
                 frame_rgb, conf_threshold, iou_threshold, mask_threshold, conversion_code);
+            ++frames;
+
+            if (writer) {
+                // the writer keeps the frame, so hand over a copy if we still draw on it here;
+                // moving it out also makes `cap->read(frame)` allocate a fresh buffer next time
+                writer->write(show ? frame.clone() : std::move(frame), show ? results : std::move(results));
+            }
+            if (!show) {
+                continue;
+            }
 
             // Draw results
-            plot_results(frame, results, colors, model.getNames(), frame.size());
+            plotter.draw(frame, results);
 
             // Now display the processed frame (BGR)
             cv::imshow("Video Inference", frame);
@@ -191,8 +182,20 @@ int main(int argc, char** argv) {
                 break;
             }
         }
-        cap.release();
-        cv::destroyAllWindows();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Processed " << frames << " frames in " << elapsed << " s ("
+                  << (elapsed > 0.0 ? frames / elapsed : 0.0) << " fps)" << std::endl;
+        cap.reset();
+        if (writer) {
+            writer->close();
+            AnnotatedVideoWriterStats stats = writer->getStats();
+            std::cout << "Wrote " << stats.written << " frames, render "
+                      << (stats.written ? stats.render_ms / stats.written : 0.0) << " ms/frame, encode "
+                      << (stats.written ? stats.encode_ms / stats.written : 0.0) << " ms/frame" << std::endl;
+        }
+        if (show) {
+            cv::destroyAllWindows();
+        }
 
     } else {
         // --- Single Image ---
@@ -208,12 +211,28 @@ int main(int argc, char** argv) {
             img, conf_threshold, iou_threshold, mask_threshold, conversion_code);
 
         // Draw results
-        plot_results(img, results, colors, model.getNames(), img.size());
+        plotter.draw(img, results);
 
+        if (!savePath.empty()) {
+            cv::imwrite(savePath, img);
+            std::cout << "Saved annotated image to: " << savePath << std::endl;
+        }
         // Show final result
-        cv::imshow("Image Inference", img);
-        cv::waitKey(0);
+        if (show) {
+            cv::imshow("Image Inference", img);
+            cv::waitKey(0);
+        }
     }
 
     return 0;
 }
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    }
+    catch (const std::invalid_argument& e) {  // malformed command line options
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,208 @@
+#include "nn/async_predictor.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "utils/memory.h"
+
+
+AsyncPredictor::AsyncPredictor(AutoBackendOnnx& model, AsyncPredictorConfig config)
+    : model_(model), config_(config)
+{
+    if (config_.max_batch < 1) {
+        throw std::invalid_argument("AsyncPredictor: max_batch must be >= 1, got " + std::to_string(config_.max_batch));
+    }
+    max_batch_ = static_cast<size_t>(config_.max_batch);
+    const int64_t model_batch = model_.getMaxBatch();
+    if (model_batch == 1 && max_batch_ > 1) {
+        std::cerr << "Warning: model was exported with a fixed batch size of 1, "
+                     "requests will be coalesced but still run one by one" << std::endl;
+    }
+    worker_ = std::thread(&AsyncPredictor::run, this);
+}
+
+AsyncPredictor::~AsyncPredictor()
+{
+    shutdown();
+}
+
+std::future<std::vector<YoloResults>> AsyncPredictor::submit(const cv::Mat& image, const PredictParams& params)
+{
+    Request request;
+    request.image = image;
+    request.params = params;
+    std::future<std::vector<YoloResults>> future = request.promise.get_future();
+    enqueue(std::move(request));
+    return future;
+}
+
+void AsyncPredictor::submit(const cv::Mat& image, const PredictParams& params, Callback callback)
+{
+    Request request;
+    request.image = image;
+    request.params = params;
+    request.callback = std::move(callback);
+    enqueue(std::move(request));
+}
+
+void AsyncPredictor::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    space_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+AsyncPredictorStats AsyncPredictor::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void AsyncPredictor::enqueue(Request&& request)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (config_.max_queue > 0) {
+            space_cv_.wait(lock, [this] { return stopping_ || queue_.size() < config_.max_queue; });
+        }
+        if (stopping_) {
+            throw std::runtime_error("AsyncPredictor: submit() called after shutdown()");
+        }
+        request.enqueued = std::chrono::steady_clock::now();
+        queue_.push_back(std::move(request));
+    }
+    cv_.notify_one();
+}
+
+void AsyncPredictor::run()
+{
+    std::vector<Request> batch;
+    batch.reserve(max_batch_);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;  // stopping and everything is drained
+            }
+            // give the batch a chance to fill up, but never hold the oldest request longer than max_delay
+            const auto flush_at = queue_.front().enqueued + config_.max_delay;
+            cv_.wait_until(lock, flush_at, [this] { return stopping_ || queue_.size() >= max_batch_; });
+
+            const size_t n = std::min(queue_.size(), max_batch_);
+            for (size_t i = 0; i < n; ++i) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+        space_cv_.notify_all();
+        process(batch);
+        batch.clear();
+        if (model_.isLowMemory()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (queue_.empty()) {
+                lock.unlock();
+                release_free_memory_after_burst();  // hand the burst's blobs and masks back to the system
+            }
+        }
+    }
+}
+
+void AsyncPredictor::process(std::vector<Request>& batch)
+{
+    // requests that expired while queued are not worth a slot in the batch
+    const Deadline queued_until = std::chrono::steady_clock::now();
+    std::vector<size_t> live;
+    std::vector<cv::Mat> images;
+    std::vector<PredictParams> params;
+    live.reserve(batch.size());
+    images.reserve(batch.size());
+    params.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const Request& request = batch[i];
+        if (has_deadline(request.params.deadline) && request.params.deadline <= queued_until) {
+            continue;
+        }
+        live.push_back(i);
+        images.push_back(request.image);
+        params.push_back(request.params);
+    }
+
+    // one predict_batch call per forward() chunk (see getMaxBatch()): a chunk that fails, e.g. on its deadline,
+    // fails only its own requests instead of discarding the results of the chunks before it
+    std::vector<std::vector<YoloResults>> results(batch.size());
+    std::vector<std::exception_ptr> errors(live.size());
+    const int64_t max_batch = model_.getMaxBatch();
+    const size_t chunk_size = max_batch > 0 ? static_cast<size_t>(max_batch) : std::max<size_t>(live.size(), 1);
+    size_t chunks = 0;
+    for (size_t begin = 0; begin < live.size(); begin += chunk_size, ++chunks) {
+        const size_t end = std::min(live.size(), begin + chunk_size);
+        const std::vector<cv::Mat> chunk_images(images.begin() + begin, images.begin() + end);
+        const std::vector<PredictParams> chunk_params(params.begin() + begin, params.begin() + end);
+        try {
+            std::vector<std::vector<YoloResults>> chunk_results = model_.predict_batch(chunk_images, chunk_params);
+            for (size_t k = begin; k < end; ++k) {
+                results[live[k]] = std::move(chunk_results[k - begin]);  // back to batch order
+            }
+        }
+        catch (...) {
+            std::fill(errors.begin() + begin, errors.begin() + end, std::current_exception());
+        }
+    }
+
+    const Deadline done_at = std::chrono::steady_clock::now();
+    uint64_t failed = 0;
+    uint64_t timed_out = 0;
+    size_t next_live = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Request& request = batch[i];
+        const bool ran = next_live < live.size() && live[next_live] == i;
+        std::exception_ptr request_error = ran ? errors[next_live] : std::make_exception_ptr(DeadlineExceededError("queue"));
+        next_live += ran ? 1 : 0;
+        if (!request_error && has_deadline(request.params.deadline) && request.params.deadline <= done_at) {
+            request_error = std::make_exception_ptr(DeadlineExceededError("results"));
+        }
+        if (request_error) {
+            ++failed;
+            try {
+                std::rethrow_exception(request_error);
+            }
+            catch (const DeadlineExceededError&) {
+                ++timed_out;
+            }
+            catch (...) {
+            }
+        }
+
+        if (request.callback) {
+            try {
+                request.callback(request_error ? std::vector<YoloResults>{} : std::move(results[i]), request_error);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error: AsyncPredictor callback threw: " << e.what() << std::endl;
+            }
+            catch (...) {
+                std::cerr << "Error: AsyncPredictor callback threw an unknown exception" << std::endl;
+            }
+        }
+        else if (request_error) {
+            request.promise.set_exception(request_error);
+        }
+        else {
+            request.promise.set_value(std::move(results[i]));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.requests += batch.size();
+    stats_.batches += chunks;
+    stats_.failed += failed;
+    stats_.timed_out += timed_out;
+}
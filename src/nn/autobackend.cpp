@@ -1,5 +1,6 @@
 #include "nn/autobackend.h"
 
+#include <cmath>
 #include <iostream>
 #include <ostream>
 #include <filesystem>
@@ -13,6 +14,45 @@
 #include "constants.h"
 #include "utils/common.h"
 #include "utils/ops.h"
+#include "utils/thread_pool.h"
+
+namespace {
+    // below this many instances postprocess_masks decodes serially
+    constexpr size_t PARALLEL_MASKS_MIN = 8;
+
+    void update_peak(std::atomic<size_t>& peak, size_t value) {
+        size_t current = peak.load(std::memory_order_relaxed);
+        while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    ClassFilter make_class_filter(const PredictParams& params, int class_names_num) {
+        ClassFilter filter;
+        for (size_t i = 0; i < params.classes.size(); ++i) {
+            const int id = params.classes[i];
+            if (id < 0 || id >= class_names_num) {
+                throw std::invalid_argument("PredictParams::classes: class id " + std::to_string(id)
+                    + " out of range for a model with " + std::to_string(class_names_num) + " classes");
+            }
+            filter.ids.push_back(id);
+            filter.thresholds.push_back(i < params.class_conf.size() && params.class_conf[i] > 0.0f ? params.class_conf[i] : params.conf);
+        }
+        return filter;
+    }
+
+    // images of one forward() call are abandoned together, so only once the last of them is no longer wanted
+    Deadline chunk_deadline(const std::vector<PredictParams>& params, size_t begin, size_t end) {
+        Deadline latest;
+        for (size_t i = begin; i < end; ++i) {
+            const Deadline& deadline = (params.size() == 1 ? params[0] : params[i]).deadline;
+            if (!has_deadline(deadline)) {
+                return Deadline();
+            }
+            latest = std::max(latest, deadline);
+        }
+        return latest;
+    }
+}
 
 
 namespace fs = std::filesystem;
@@ -27,9 +67,12 @@ AutoBackendOnnx::AutoBackendOnnx(const char* modelPath, const char* logid, const
 }
 
 AutoBackendOnnx::AutoBackendOnnx(const char* modelPath, const char* logid, const char* provider)
-    : OnnxModelBase(modelPath, logid, provider) {
-    // init metadata etc
-    OnnxModelBase(modelPath, logid, provider);
+    : AutoBackendOnnx(modelPath, logid, provider, OnnxSessionConfig()) {
+}
+
+AutoBackendOnnx::AutoBackendOnnx(const char* modelPath, const char* logid, const char* provider, const OnnxSessionConfig& config)
+    : OnnxModelBase(modelPath, logid, provider, config) {
+    // init metadata etc (the base class already loaded the session)
     // then try to get additional info from metadata like imgsz, stride etc;
     //  ideally you should get all of them but you'll raise error if smth is not in metadata (or not under the appropriate keys)
     const std::unordered_map<std::string, std::string>& base_metadata = OnnxModelBase::getMetadata();
@@ -116,6 +159,36 @@ AutoBackendOnnx::AutoBackendOnnx(const char* modelPath, const char* logid, const
         std::cerr << "Warning: Cannot get task value from metadata" << std::endl;
     }
 
+    auto kpt_shape_item = base_metadata.find(MetadataConstants::KPT_SHAPE);
+    if (kpt_shape_item != base_metadata.end()) {
+        std::vector<int> kpt_shape = convertStringVectorToInts(parseVectorString(kpt_shape_item->second));
+        kpt_values_ = kpt_shape.empty() ? 0 : 1;
+        for (int dim : kpt_shape) {
+            kpt_values_ *= dim;
+        }
+    }
+
+    // end-to-end exports: trust the metadata flag, otherwise recognize the [bs, max_det, 6 + extra] output
+    auto end2end_item = base_metadata.find(MetadataConstants::END2END);
+    if (end2end_item != base_metadata.end()) {
+        end2end_ = end2end_item->second == "True" || end2end_item->second == "true" || end2end_item->second == "1";
+    }
+    else if (!getOutputShapes().empty() && getOutputShapes()[0].size() == 3) {
+        const std::vector<int64_t>& shape0 = getOutputShapes()[0];
+        int64_t extra = 0;
+        if (task_ == YoloTasks::SEGMENT) {
+            extra = getOutputShapes().size() > 1 && getOutputShapes()[1].size() == 4 && getOutputShapes()[1][1] > 0
+                ? getOutputShapes()[1][1] : 32;
+        }
+        else if (task_ == YoloTasks::POSE) {
+            extra = kpt_values_;
+        }
+        end2end_ = shape0[2] == 6 + extra && shape0[1] != 4 + nc_ + extra;
+    }
+    if (end2end_) {
+        std::cout << "End-to-end model: decode and NMS run inside the graph" << std::endl;
+    }
+
     // TODO: raise assert if imgsz_ and task_ were not initialized (since you don't know in that case which postprocessing to use)
 
 }
@@ -168,6 +241,34 @@ const std::string& AutoBackendOnnx::getTask()
     return task_;
 }
 
+int64_t AutoBackendOnnx::getMaxBatch()
+{
+    const std::vector<std::vector<int64_t>>& input_shapes = getInputShapes();
+    if (input_shapes.empty() || input_shapes[0].empty() || input_shapes[0][0] <= 0) {
+        return -1;
+    }
+    return input_shapes[0][0];
+}
+
+bool AutoBackendOnnx::hasDynamicInputSize()
+{
+    const std::vector<std::vector<int64_t>>& input_shapes = getInputShapes();
+    if (input_shapes.empty() || input_shapes[0].size() != 4) {
+        return false;
+    }
+    return input_shapes[0][2] <= 0 || input_shapes[0][3] <= 0;
+}
+
+cv::Size AutoBackendOnnx::resolveInputSize(const cv::Size& imgsz)
+{
+    if (imgsz.empty() || !hasDynamicInputSize()) {
+        return getCvSize();
+    }
+    const int stride = getStride() > 0 ? getStride() : 32;
+    auto round_up = [stride](int value) { return std::max(stride, (value + stride - 1) / stride * stride); };
+    return cv::Size(round_up(imgsz.width), round_up(imgsz.height));
+}
+
 std::vector<YoloResults> AutoBackendOnnx::predict_once(const std::string& imagePath, float& conf, float& iou, float& mask_threshold,
     int conversionCode, bool verbose) {
     // Convert the string imagePath to an object of type std::filesystem::path
@@ -216,22 +317,17 @@ std::vector<YoloResults> AutoBackendOnnx::predict_once(cv::Mat& image, float& co
     double postprocess_time = 0.0;
     Timer preprocess_timer = Timer(preprocess_time, verbose);
     // 1. preprocess
-    float* blob = nullptr;
-    //double* blob = nullptr;
     std::vector<Ort::Value> inputTensors;
     if (conversionCode >= 0) {
         cv::cvtColor(image, image, conversionCode);
     }
-    std::vector<int64_t> inputTensorShape;
-    // TODO: for classify task preprocessed image will be different (!):
-    cv::Mat preprocessed_img;
     cv::Size new_shape = cv::Size(getWidth(), getHeight());
-    const bool& scaleFill = false;  // false
-    const bool& auto_ = false; // true
-    letterbox(image, preprocessed_img, new_shape, cv::Scalar(), auto_, scaleFill, true, getStride());
-    fill_blob(preprocessed_img, blob, inputTensorShape);
+    std::vector<int64_t> inputTensorShape = { 1, getCh(), new_shape.height, new_shape.width };
     int64_t inputTensorSize = vector_product(inputTensorShape);
-    std::vector<float> inputTensorValues(blob, blob + inputTensorSize);
+    // the blob is written straight into the tensor storage, so there is nothing to free afterwards
+    std::vector<float> inputTensorValues(inputTensorSize);
+    update_peak(peakInputBytes_, inputTensorValues.size() * sizeof(float));
+    preprocess(image, inputTensorValues.data(), new_shape);
 
     Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(
         OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
@@ -249,70 +345,302 @@ std::vector<YoloResults> AutoBackendOnnx::predict_once(cv::Mat& image, float& co
     // create container for the results
     std::vector<YoloResults> results;
     // 3. postprocess based on task:
-    std::unordered_map<int, std::string> names = this->getNames();
-    // 4. cleanup blob since it was created using the "new" keyword during the `fill_blob` func call
-    delete[] blob;
-
-    int class_names_num = names.size();
-    if (task_ == YoloTasks::SEGMENT) {
-
-        // get outputs info
-        std::vector<int64_t> outputTensor0Shape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
-        std::vector<int64_t> outputTensor1Shape = outputTensors[1].GetTensorTypeAndShapeInfo().GetShape();
-        // get outputs
-        float* all_data0 = outputTensors[0].GetTensorMutableData<float>();
-
-        cv::Mat output0 = cv::Mat(cv::Size((int)outputTensor0Shape[2], (int)outputTensor0Shape[1]), CV_32F, all_data0).t();  // [bs, features, preds_num]=>[bs, preds_num, features]
-        auto mask_shape = outputTensor1Shape;
-        std::vector<int> mask_sz = { 1,(int)mask_shape[1],(int)mask_shape[2],(int)mask_shape[3] };
-        cv::Mat output1 = cv::Mat(mask_sz, CV_32F, outputTensors[1].GetTensorMutableData<float>());
-
-        int iw = this->getWidth();
-        int ih = this->getHeight();
-        int mask_features_num = outputTensor1Shape[1];
-        int mh = outputTensor1Shape[2];
-        int mw = outputTensor1Shape[3];
-        ImageInfo img_info = { image.size() };
-        postprocess_masks(output0, output1, img_info, results, class_names_num, conf, iou,
-            iw, ih, mw, mh, mask_features_num, mask_threshold);
-    }
-    else if (task_ == YoloTasks::DETECT) {
-        ImageInfo img_info = { image.size() };
-        std::vector<int64_t> outputTensor0Shape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
-        float* all_data0 = outputTensors[0].GetTensorMutableData<float>();
-        cv::Mat output0 = cv::Mat(cv::Size((int)outputTensor0Shape[2], (int)outputTensor0Shape[1]), CV_32F, all_data0).t();  // [bs, features, preds_num]=>[bs, preds_num, features]
-        postprocess_detects(output0, img_info, results, class_names_num, conf, iou);
-    }
-    else if (task_ == YoloTasks::POSE) {
-        ImageInfo image_info = { image.size() };
-        std::vector<int64_t> outputTensor0Shape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
-        float* all_data0 = outputTensors[0].GetTensorMutableData<float>();
-        cv::Mat output0 = cv::Mat(cv::Size((int)outputTensor0Shape[2], (int)outputTensor0Shape[1]), CV_32F, all_data0).t();  // [bs, features, preds_num]=>[bs, preds_num, features]
-        postprocess_kpts(output0, image_info, results, class_names_num, conf, iou);
-    }
-    else {
-        throw std::runtime_error("NotImplementedError: task: " + task_);
-    }
+    PredictParams params;
+    params.conf = conf;
+    params.iou = iou;
+    params.mask_threshold = mask_threshold;
+    params.conversionCode = conversionCode;
+    ImageInfo img_info = { image.size(), new_shape, Deadline() };
+    postprocess(outputTensors, 0, img_info, params, results);
 
     postprocess_timer.Stop();
 //    if (verbose) {
 //        std::cout << std::fixed << std::setprecision(1);
-//        std::cout << "image: " << preprocessed_img.rows << "x" << preprocessed_img.cols << " " << results.size() << " objs, ";
+//        std::cout << "image: " << new_shape.height << "x" << new_shape.width << " " << results.size() << " objs, ";
 //        std::cout << (preprocess_time + inference_time + postprocess_time) * 1000.0 << "ms" << std::endl;
 //        std::cout << "Speed: " << (preprocess_time * 1000.0) << "ms preprocess, ";
 //        std::cout << (inference_time * 1000.0) << "ms inference, ";
 //        std::cout << (postprocess_time * 1000.0) << "ms postprocess per image ";
-//        std::cout << "at shape (1, " << image.channels() << ", " << preprocessed_img.rows << ", " << preprocessed_img.cols << ")" << std::endl;
+//        std::cout << "at shape (1, " << image.channels() << ", " << new_shape.height << ", " << new_shape.width << ")" << std::endl;
 //    }
 
     return results;
 }
 
 
+bool AutoBackendOnnx::isEndToEnd()
+{
+    return end2end_;
+}
+
+cv::Size AutoBackendOnnx::fill_batch(const std::vector<cv::Mat>& images, size_t begin, size_t end,
+    const std::vector<PredictParams>& params, std::vector<float>& blob, int64_t& batch_size)
+{
+    const int64_t max_batch = getMaxBatch();
+    // fixed batch graphs must always get a full batch, unused slots stay zeroed
+    batch_size = max_batch > 0 ? max_batch : static_cast<int64_t>(end - begin);
+    const cv::Size new_shape = resolveInputSize((params.size() == 1 ? params[0] : params[begin]).imgsz);
+    const int64_t image_size = static_cast<int64_t>(getCh()) * new_shape.height * new_shape.width;
+    // zero-filled by the calling thread: on a pinned replica the pages are first touched, and placed, on its node
+    blob.assign(static_cast<size_t>(batch_size * image_size), 0.0f);
+    update_peak(peakInputBytes_, blob.size() * sizeof(float));
+    const Deadline deadline = chunk_deadline(params, begin, end);
+
+    // images write disjoint slices of the blob, so they are letterboxed in parallel on the model's pool
+    ThreadPool& pool = pool_ ? *pool_ : ThreadPool::global();
+    pool.parallel_for(end - begin, [&](size_t first, size_t last) {
+        for (size_t i = begin + first; i < begin + last; ++i) {
+            const PredictParams& p = params.size() == 1 ? params[0] : params[i];
+            check_deadline(deadline, "preprocess");
+            if (images[i].channels() != getCh()) {
+                throw std::runtime_error("Error: Number of image channels does not match the required channels.\n"
+                    "Number of channels in the image: " + std::to_string(images[i].channels()));
+            }
+            cv::Mat image;
+            if (p.conversionCode >= 0) {
+                cv::cvtColor(images[i], image, p.conversionCode);
+            }
+            else {
+                image = images[i];
+            }
+            preprocess(image, blob.data() + (i - begin) * image_size, new_shape);
+        }
+    });
+    return new_shape;
+}
+
+void AutoBackendOnnx::infer_batch(std::vector<float>& blob, int64_t batch_size, const cv::Size& new_shape,
+    const std::vector<cv::Mat>& images, size_t begin, size_t end, const std::vector<PredictParams>& params,
+    std::vector<std::vector<YoloResults>>& results, const ResultSink& sink)
+{
+    infer_blob(blob.data(), blob.size(), batch_size, new_shape, begin, end,
+        [&images](size_t i) { return images[i].size(); }, params, results, sink);
+}
+
+std::vector<std::vector<YoloResults>> AutoBackendOnnx::predict_blob(float* blob, int64_t batch_size, const cv::Size& input_size,
+    int channels, const std::vector<cv::Size>& raw_sizes, const std::vector<PredictParams>& params)
+{
+    if (channels != getCh()) {
+        throw std::invalid_argument("predict_blob: the blob has " + std::to_string(channels) + " channels, the model takes "
+            + std::to_string(getCh()));
+    }
+    if (params.size() != raw_sizes.size() && params.size() != 1) {
+        throw std::invalid_argument("predict_blob: expected one PredictParams per image or a single shared one, got "
+            + std::to_string(params.size()) + " for " + std::to_string(raw_sizes.size()) + " images");
+    }
+    if (static_cast<int64_t>(raw_sizes.size()) > batch_size) {
+        throw std::invalid_argument("predict_blob: " + std::to_string(raw_sizes.size()) + " images in a blob of "
+            + std::to_string(batch_size));
+    }
+    if (input_size != resolveInputSize(input_size)) {
+        throw std::invalid_argument("predict_blob: the blob's " + std::to_string(input_size.width) + "x"
+            + std::to_string(input_size.height) + " input doesn't fit this model");
+    }
+    std::vector<std::vector<YoloResults>> results(raw_sizes.size());
+    const size_t blob_size = static_cast<size_t>(batch_size) * getCh() * input_size.area();
+    infer_blob(blob, blob_size, batch_size, input_size, 0, raw_sizes.size(),
+        [&raw_sizes](size_t i) { return raw_sizes[i]; }, params, results, ResultSink());
+    return results;
+}
+
+void AutoBackendOnnx::infer_blob(float* blob, size_t blob_size, int64_t batch_size, const cv::Size& new_shape,
+    size_t begin, size_t end, const std::function<cv::Size(size_t)>& raw_size, const std::vector<PredictParams>& params,
+    std::vector<std::vector<YoloResults>>& results, const ResultSink& sink)
+{
+    Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(
+        OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+    std::vector<int64_t> inputTensorShape = { batch_size, getCh(), new_shape.height, new_shape.width };
+    std::vector<Ort::Value> inputTensors;
+    inputTensors.push_back(Ort::Value::CreateTensor<float>(
+        memoryInfo, blob, blob_size,
+        inputTensorShape.data(), inputTensorShape.size()
+    ));
+    // protos are only fetched if some image of this call wants masks
+    bool need_protos = false;
+    for (size_t i = begin; i < end; ++i) {
+        need_protos = need_protos || (params.size() == 1 ? params[0] : params[i]).with_masks;
+    }
+    const Deadline deadline = chunk_deadline(params, begin, end);
+    std::vector<Ort::Value> outputTensors;
+    if (task_ == YoloTasks::SEGMENT && !need_protos && getOutputNamesCStr().size() > 1) {
+        outputTensors = forward(inputTensors, { getOutputNamesCStr()[0] }, deadline);
+    }
+    else {
+        outputTensors = forward(inputTensors, getOutputNamesCStr(), deadline);
+    }
+    size_t output_bytes = 0;
+    for (const Ort::Value& output : outputTensors) {
+        output_bytes += output.GetTensorTypeAndShapeInfo().GetElementCount() * sizeof(float);
+    }
+    update_peak(peakOutputBytes_, output_bytes);
+
+    ThreadPool& pool = pool_ ? *pool_ : ThreadPool::global();
+    pool.parallel_for(end - begin, [&](size_t first, size_t last) {
+        for (size_t i = begin + first; i < begin + last; ++i) {
+            const PredictParams& p = params.size() == 1 ? params[0] : params[i];
+            ImageInfo img_info = { raw_size(i), new_shape, deadline };
+            postprocess(outputTensors, static_cast<int64_t>(i - begin), img_info, p, results[i]);
+            if (sink) {
+                sink(i, results[i]);
+                std::vector<YoloResults>().swap(results[i]);
+            }
+        }
+    });
+}
+
+ModelMemoryStats AutoBackendOnnx::getMemoryStats()
+{
+    ModelMemoryStats stats;
+    std::error_code error;
+    const uintmax_t file_size = std::filesystem::file_size(modelPath_, error);
+    stats.model_file_bytes = error ? 0 : static_cast<size_t>(file_size);
+    stats.peak_input_bytes = peakInputBytes_.load();
+    stats.peak_output_bytes = peakOutputBytes_.load();
+    stats.peak_mask_bytes = peakMaskBytes_.load();
+    stats.peak_mask_scratch_bytes = peakMaskScratchBytes_.load();
+    return stats;
+}
+
+void AutoBackendOnnx::setThreadPool(ThreadPool* pool)
+{
+    pool_ = pool;
+}
+
+std::vector<std::vector<YoloResults>> AutoBackendOnnx::predict_batch(const std::vector<cv::Mat>& images,
+    const std::vector<PredictParams>& params)
+{
+    if (params.size() != images.size() && params.size() != 1) {
+        throw std::invalid_argument("predict_batch: expected one PredictParams per image or a single shared one, got "
+            + std::to_string(params.size()) + " for " + std::to_string(images.size()) + " images");
+    }
+    std::vector<std::vector<YoloResults>> results(images.size());
+    if (images.empty()) {
+        return results;
+    }
+
+    const int64_t max_batch = getMaxBatch();
+    const size_t chunk_size = max_batch > 0 ? static_cast<size_t>(max_batch) : images.size();
+    std::vector<float> inputTensorValues;
+
+    for (size_t begin = 0; begin < images.size(); begin += chunk_size) {
+        const size_t end = std::min(images.size(), begin + chunk_size);
+        int64_t batch_size = 0;
+        const cv::Size new_shape = fill_batch(images, begin, end, params, inputTensorValues, batch_size);
+        infer_batch(inputTensorValues, batch_size, new_shape, images, begin, end, params, results);
+    }
+    return results;
+}
+
+void AutoBackendOnnx::predict_batch(const std::vector<cv::Mat>& images, const std::vector<PredictParams>& params,
+    const ResultSink& sink)
+{
+    if (params.size() != images.size() && params.size() != 1) {
+        throw std::invalid_argument("predict_batch: expected one PredictParams per image or a single shared one, got "
+            + std::to_string(params.size()) + " for " + std::to_string(images.size()) + " images");
+    }
+    // the slots stay empty: infer_batch hands every image's results to the sink and releases them
+    std::vector<std::vector<YoloResults>> results(images.size());
+    const int64_t max_batch = getMaxBatch();
+    const size_t chunk_size = max_batch > 0 ? static_cast<size_t>(max_batch) : std::max<size_t>(images.size(), 1);
+    std::vector<float> inputTensorValues;
+
+    for (size_t begin = 0; begin < images.size(); begin += chunk_size) {
+        const size_t end = std::min(images.size(), begin + chunk_size);
+        int64_t batch_size = 0;
+        const cv::Size new_shape = fill_batch(images, begin, end, params, inputTensorValues, batch_size);
+        infer_batch(inputTensorValues, batch_size, new_shape, images, begin, end, params, results, sink);
+    }
+}
+
+
+void AutoBackendOnnx::preprocess(const cv::Mat& image, float* blob, const cv::Size& new_shape)
+{
+    if (task_ == YoloTasks::CLASSIFY) {
+        // classifiers are trained on resize + center crop, not letterbox
+        const double scale = std::max(static_cast<double>(new_shape.width) / image.cols,
+                                      static_cast<double>(new_shape.height) / image.rows);
+        cv::Mat resized;
+        cv::resize(image, resized, cv::Size(std::max(new_shape.width, static_cast<int>(std::round(image.cols * scale))),
+                                            std::max(new_shape.height, static_cast<int>(std::round(image.rows * scale)))),
+                   0, 0, cv::INTER_LINEAR);
+        const cv::Rect crop((resized.cols - new_shape.width) / 2, (resized.rows - new_shape.height) / 2,
+                            new_shape.width, new_shape.height);
+        fill_blob(resized(crop), blob);
+        return;
+    }
+    cv::Mat preprocessed_img;
+    const bool& scaleFill = false;  // false
+    const bool& auto_ = false; // true
+    letterbox(image, preprocessed_img, new_shape, cv::Scalar(), auto_, scaleFill, true, getStride());
+    fill_blob(preprocessed_img, blob);
+}
+
+
+void AutoBackendOnnx::postprocess(std::vector<Ort::Value>& outputTensors, int64_t batch_idx, const ImageInfo& image_info,
+    const PredictParams& params, std::vector<YoloResults>& results)
+{
+    int class_names_num = static_cast<int>(getNames().size());
+    float conf = params.conf;
+    float iou = params.iou;
+    check_deadline(image_info.deadline, "decode");
+    ImageInfo info = image_info;
+    if (info.input_size.empty()) {
+        info.input_size = getCvSize();
+    }
+    const ClassFilter class_filter = make_class_filter(params, class_names_num);
+
+    if (task_ == YoloTasks::CLASSIFY) {
+        // [bs, nc] probabilities
+        std::vector<int64_t> shape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
+        const float* probs = outputTensors[0].GetTensorMutableData<float>() + batch_idx * shape[1];
+        postprocess_classify(probs, static_cast<int>(shape[1]), info, params, results, class_filter);
+        return;
+    }
+
+    // every output is [bs, ...] so the image of interest starts at batch_idx * (per-image element count)
+    std::vector<int64_t> outputTensor0Shape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
+    float* all_data0 = outputTensors[0].GetTensorMutableData<float>() + batch_idx * outputTensor0Shape[1] * outputTensor0Shape[2];
+    cv::Mat output1;
+    if (task_ == YoloTasks::SEGMENT && outputTensors.size() > 1) {
+        std::vector<int64_t> outputTensor1Shape = outputTensors[1].GetTensorTypeAndShapeInfo().GetShape();
+        float* all_data1 = outputTensors[1].GetTensorMutableData<float>()
+            + batch_idx * outputTensor1Shape[1] * outputTensor1Shape[2] * outputTensor1Shape[3];
+        std::vector<int> mask_sz = { 1,(int)outputTensor1Shape[1],(int)outputTensor1Shape[2],(int)outputTensor1Shape[3] };
+        output1 = cv::Mat(mask_sz, CV_32F, all_data1);
+    }
+
+    if (end2end_) {
+        // already [max_det, 6 + extra] rows, no transpose needed
+        cv::Mat rows((int)outputTensor0Shape[1], (int)outputTensor0Shape[2], CV_32F, all_data0);
+        postprocess_end2end(rows, output1, info, params, results, class_filter);
+        return;
+    }
+    cv::Mat output0 = cv::Mat(cv::Size((int)outputTensor0Shape[2], (int)outputTensor0Shape[1]), CV_32F, all_data0).t();  // [bs, features, preds_num]=>[bs, preds_num, features]
+
+    if (task_ == YoloTasks::SEGMENT) {
+        // rows are [4 box, nc scores, nm mask coefficients]; without the protos output only the row layout matters
+        int mask_features_num = output1.empty() ? output0.cols - 4 - class_names_num : output1.size[1];
+        postprocess_masks(output0, output1, info, results, class_names_num, conf, iou,
+            mask_features_num, params.mask_threshold, params.with_masks && !output1.empty(), class_filter);
+    }
+    else if (task_ == YoloTasks::DETECT) {
+        postprocess_detects(output0, info, results, class_names_num, conf, iou, class_filter);
+    }
+    else if (task_ == YoloTasks::POSE) {
+        postprocess_kpts(output0, info, results, class_names_num, conf, iou, params.with_keypoints, class_filter);
+    }
+    else {
+        throw std::runtime_error("NotImplementedError: task: " + task_);
+    }
+}
+
+
 void AutoBackendOnnx::postprocess_masks(cv::Mat& output0, cv::Mat& output1, ImageInfo image_info, std::vector<YoloResults>& output,
     int& class_names_num, float& conf_threshold, float& iou_threshold,
-    int& iw, int& ih, int& mw, int& mh, int& masks_features_num, float mask_threshold /* = 0.5f */)
+    int& masks_features_num, float mask_threshold /* = 0.5f */, bool with_masks /* = true */,
+    const ClassFilter& class_filter /* = ClassFilter() */)
 {
+    const cv::Size input_size = image_info.input_size.empty() ? getCvSize() : image_info.input_size;
     output.clear();
     std::vector<int> class_ids;
     std::vector<float> confidences;
@@ -324,11 +652,21 @@ void AutoBackendOnnx::postprocess_masks(cv::Mat& output0, cv::Mat& output1, Imag
     float* pdata = (float*)output0.data;
     for (int r = 0; r < rows; ++r)
     {
-        cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
         cv::Point class_id;
-        double max_conf;
-        minMaxLoc(scores, 0, &max_conf, 0, &class_id);
-        if (max_conf > conf_threshold)
+        double max_conf = 0.0;
+        bool keep;
+        if (class_filter.empty()) {
+            cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
+            minMaxLoc(scores, 0, &max_conf, 0, &class_id);
+            keep = max_conf > conf_threshold;
+        }
+        else {
+            // only the listed classes are scanned, each against its own threshold
+            float best_conf = 0.0f;
+            keep = class_filter.best(pdata + 4, class_id.x, best_conf);
+            max_conf = best_conf;
+        }
+        if (keep)
         {
             masks.push_back(std::vector<float>(pdata + 4 + class_names_num, pdata + data_width));
             class_ids.push_back(class_id.x);
@@ -339,7 +677,7 @@ void AutoBackendOnnx::postprocess_masks(cv::Mat& output0, cv::Mat& output1, Imag
             float out_left = MAX((pdata[0] - 0.5 * out_w + 0.5), 0);
             float out_top = MAX((pdata[1] - 0.5 * out_h + 0.5), 0);
             cv::Rect_ <float> bbox = cv::Rect(out_left, out_top, (out_w + 0.5), (out_h + 0.5));
-            cv::Rect_<float> scaled_bbox = scale_boxes(getCvSize(), bbox, image_info.raw_size);
+            cv::Rect_<float> scaled_bbox = scale_boxes(input_size, bbox, image_info.raw_size);
             boxes.push_back(scaled_bbox);
         }
         pdata += data_width; // next pred
@@ -350,7 +688,56 @@ void AutoBackendOnnx::postprocess_masks(cv::Mat& output0, cv::Mat& output1, Imag
     //int top_k = 500;
     //const float& nmsde_eta = 1.0f;
     std::vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, conf_threshold, iou_threshold, nms_result); // , nms_eta, top_k);
+    cv::dnn::NMSBoxes(boxes, confidences, class_filter.min_threshold(conf_threshold), iou_threshold, nms_result); // , nms_eta, top_k);
+
+    std::vector<std::vector<float>> kept_masks;
+    kept_masks.reserve(nms_result.size());
+    for (int idx : nms_result) {
+        boxes[idx] = boxes[idx] & cv::Rect(0, 0, image_info.raw_size.width, image_info.raw_size.height);
+        output.push_back(YoloResults{ class_ids[idx], confidences[idx], boxes[idx] });
+        kept_masks.push_back(std::move(masks[idx]));
+    }
+    if (with_masks) {
+        // boxes only otherwise: skip the protos copy and the per-instance mask decoding
+        decode_masks(output1, image_info, kept_masks, mask_threshold, output);
+    }
+}
+
+
+void AutoBackendOnnx::postprocess_classify(const float* probs, int class_names_num, const ImageInfo& image_info,
+    const PredictParams& params, std::vector<YoloResults>& output, const ClassFilter& class_filter)
+{
+    output.clear();
+    int class_id = 0;
+    float conf = 0.0f;
+    bool found;
+    if (class_filter.empty()) {
+        class_id = static_cast<int>(std::max_element(probs, probs + class_names_num) - probs);
+        conf = probs[class_id];
+        found = conf > params.conf;
+    }
+    else {
+        found = class_filter.best(probs, class_id, conf);
+    }
+    if (found) {
+        // the whole image is the "box" of a classification
+        output.push_back(YoloResults{ class_id, conf, cv::Rect_<float>(0, 0, image_info.raw_size.width, image_info.raw_size.height) });
+    }
+}
+
+
+void AutoBackendOnnx::decode_masks(const cv::Mat& output1, const ImageInfo& image_info,
+    const std::vector<std::vector<float>>& coefficients, float mask_threshold, std::vector<YoloResults>& output)
+{
+    if (output.empty()) {
+        return;
+    }
+    int masks_features_num = output1.size[1];
+    int mh = output1.size[2];
+    int mw = output1.size[3];
+    const cv::Size input_size = image_info.input_size.empty() ? getCvSize() : image_info.input_size;
+    int iw = input_size.width;
+    int ih = input_size.height;
 
     // select all of the protos tensor
     cv::Size downsampled_size = cv::Size(mw, mh);
@@ -359,26 +746,89 @@ void AutoBackendOnnx::postprocess_masks(cv::Mat& output0, cv::Mat& output1, Imag
     cv::Mat temp_mask = output1(roi_rangs).clone();
     cv::Mat proto = temp_mask.reshape(0, { masks_features_num, downsampled_size.width * downsampled_size.height });
 
-    for (int i = 0; i < nms_result.size(); ++i)
+    // every instance writes only its own preassigned slot, so the order matches the serial loop
+    auto decode_range = [&](size_t first, size_t last) {
+        check_deadline(image_info.deadline, "masks");
+        for (size_t i = first; i < last; ++i)
+        {
+            cv::Rect box = output[i].bbox;
+            if (lowMemory_) {
+                _get_mask_box_local(cv::Mat(coefficients[i]).t(), proto, image_info, box, output[i].mask, mask_threshold,
+                    iw, ih, mw, mh);
+            }
+            else {
+                _get_mask2(cv::Mat(coefficients[i]).t(), proto, image_info, box, output[i].mask, mask_threshold,
+                    iw, ih, mw, mh, masks_features_num);
+            }
+        }
+    };
+    if (output.size() < PARALLEL_MASKS_MIN) {
+        decode_range(0, output.size());  // a few masks are cheaper than the dispatch
+    }
+    else {
+        (pool_ ? *pool_ : ThreadPool::global()).parallel_for(output.size(), decode_range, 2);
+    }
+
+    // floats: the proto-resolution mask, plus input- and image-sized masks (_get_mask2) or just the box (box-local)
+    size_t mask_bytes = 0;
+    size_t max_box_area = 0;
+    for (const YoloResults& result : output) {
+        mask_bytes += result.mask.total() * result.mask.elemSize();
+        max_box_area = std::max(max_box_area, static_cast<size_t>(result.mask.total()));
+    }
+    const size_t proto_bytes = static_cast<size_t>(mw) * mh * sizeof(float);
+    const size_t scratch_bytes = lowMemory_
+        ? proto_bytes + max_box_area * sizeof(float)
+        : proto_bytes + (static_cast<size_t>(iw) * ih + 2 * static_cast<size_t>(image_info.raw_size.area())) * sizeof(float);
+    update_peak(peakMaskBytes_, mask_bytes);
+    update_peak(peakMaskScratchBytes_, scratch_bytes);
+}
+
+
+void AutoBackendOnnx::postprocess_end2end(const cv::Mat& output0, const cv::Mat& output1, const ImageInfo& image_info,
+    const PredictParams& params, std::vector<YoloResults>& output, const ClassFilter& class_filter)
+{
+    output.clear();
+    const cv::Size input_size = image_info.input_size.empty() ? getCvSize() : image_info.input_size;
+    const cv::Rect_<float> bound_bbox(0, 0, image_info.raw_size.width, image_info.raw_size.height);
+    const bool segment = task_ == YoloTasks::SEGMENT && !output1.empty();
+    const bool pose = task_ == YoloTasks::POSE;
+    std::vector<std::vector<float>> coefficients;
+
+    for (int r = 0; r < output0.rows; ++r)
     {
-        int idx = nms_result[i];
-        boxes[idx] = boxes[idx] & cv::Rect(0, 0, image_info.raw_size.width, image_info.raw_size.height);
-        YoloResults result = { class_ids[idx] ,confidences[idx] ,boxes[idx] };
-        _get_mask2(cv::Mat(masks[idx]).t(), proto, image_info, boxes[idx], result.mask, mask_threshold,
-            iw, ih, mw, mh, masks_features_num);
-        output.push_back(result);
+        const float* row = output0.ptr<float>(r);
+        // rows are padded up to max_det, padding has score 0
+        if (class_filter.empty() ? row[4] <= params.conf : !class_filter.accepts(static_cast<int>(row[5]), row[4])) {
+            continue;
+        }
+        cv::Rect_<float> bbox(row[0], row[1], row[2] - row[0], row[3] - row[1]);  // xyxy in network input coords
+        cv::Rect_<float> scaled_bbox = scale_boxes(input_size, bbox, image_info.raw_size) & bound_bbox;
+        YoloResults result = { static_cast<int>(row[5]), row[4], scaled_bbox };
+        if (segment) {
+            coefficients.emplace_back(row + 6, row + output0.cols);
+            result.bbox = cv::Rect(result.bbox);  // masks are cut with integer boxes, keep them consistent
+        }
+        else if (pose && params.with_keypoints) {
+            std::vector<float> kpts(row + 6, row + output0.cols);
+            result.keypoints = scale_coords(input_size, kpts, image_info.raw_size);
+        }
+        output.push_back(std::move(result));
+    }
+    if (segment && params.with_masks) {
+        decode_masks(output1, image_info, coefficients, params.mask_threshold, output);
     }
 }
 
 
 void AutoBackendOnnx::postprocess_detects(cv::Mat& output0, ImageInfo image_info, std::vector<YoloResults>& output,
-    int& class_names_num, float& conf_threshold, float& iou_threshold)
+    int& class_names_num, float& conf_threshold, float& iou_threshold, const ClassFilter& class_filter /* = ClassFilter() */)
 {
     output.clear();
+    const cv::Size input_size = image_info.input_size.empty() ? getCvSize() : image_info.input_size;
     std::vector<int> class_ids;
     std::vector<float> confidences;
     std::vector<cv::Rect> boxes;
-    std::vector<std::vector<float>> masks;
     // 4 - your default number of rect parameters {x, y, w, h}
     int data_width = class_names_num + 4;
     int rows = output0.rows;
@@ -386,14 +836,22 @@ void AutoBackendOnnx::postprocess_detects(cv::Mat& output0, ImageInfo image_info
 
     for (int r = 0; r < rows; ++r)
     {
-        cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
         cv::Point class_id;
-        double max_conf;
-        minMaxLoc(scores, nullptr, &max_conf, nullptr, &class_id);
+        double max_conf = 0.0;
+        bool keep;
+        if (class_filter.empty()) {
+            cv::Mat scores(1, class_names_num, CV_32FC1, pdata + 4);
+            minMaxLoc(scores, nullptr, &max_conf, nullptr, &class_id);
+            keep = max_conf > conf_threshold;
+        }
+        else {
+            float best_conf = 0.0f;
+            keep = class_filter.best(pdata + 4, class_id.x, best_conf);
+            max_conf = best_conf;
+        }
 
-        if (max_conf > conf_threshold)
+        if (keep)
         {
-            masks.emplace_back(pdata + 4 + class_names_num, pdata + data_width);
             class_ids.push_back(class_id.x);
             confidences.push_back((float) max_conf);
 
@@ -403,7 +861,7 @@ void AutoBackendOnnx::postprocess_detects(cv::Mat& output0, ImageInfo image_info
             float out_top = MAX((pdata[1] - 0.5 * out_h + 0.5), 0);
 
             cv::Rect_ <float> bbox = cv::Rect_ <float> (out_left, out_top, (out_w + 0.5), (out_h + 0.5));
-            cv::Rect_<float> scaled_bbox = scale_boxes(getCvSize(), bbox, image_info.raw_size);
+            cv::Rect_<float> scaled_bbox = scale_boxes(input_size, bbox, image_info.raw_size);
 
             boxes.push_back(scaled_bbox);
         }
@@ -411,7 +869,7 @@ void AutoBackendOnnx::postprocess_detects(cv::Mat& output0, ImageInfo image_info
     }
 
     std::vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, conf_threshold, iou_threshold, nms_result); // , nms_eta, top_k);
+    cv::dnn::NMSBoxes(boxes, confidences, class_filter.min_threshold(conf_threshold), iou_threshold, nms_result); // , nms_eta, top_k);
     for (int idx : nms_result)
     {
         boxes[idx] = boxes[idx] & cv::Rect(0, 0, image_info.raw_size.width, image_info.raw_size.height);
@@ -421,14 +879,15 @@ void AutoBackendOnnx::postprocess_detects(cv::Mat& output0, ImageInfo image_info
 }
 
 void AutoBackendOnnx::postprocess_kpts(cv::Mat& output0, ImageInfo& image_info, std::vector<YoloResults>& output,
-                                          int& class_names_num, float& conf_threshold, float& iou_threshold)
+                                          int& class_names_num, float& conf_threshold, float& iou_threshold, bool with_keypoints /* = true */,
+                                          const ClassFilter& class_filter /* = ClassFilter() */)
 {
     std::vector<cv::Rect> boxes;
     std::vector<float> confidences;
     std::vector<int> class_ids;
     std::vector<std::vector<float>> rest;
-    std::tie(boxes, confidences, class_ids, rest) = non_max_suppression(output0, class_names_num, output0.cols, conf_threshold, iou_threshold);
-    cv::Size img1_shape = getCvSize();
+    std::tie(boxes, confidences, class_ids, rest) = non_max_suppression(output0, class_names_num, output0.cols, conf_threshold, iou_threshold, class_filter);
+    cv::Size img1_shape = image_info.input_size.empty() ? getCvSize() : image_info.input_size;
     auto bound_bbox = cv::Rect_ <float> (0, 0, image_info.raw_size.width, image_info.raw_size.height);
     for (int i = 0; i < boxes.size(); i++) {
         //             pred[:, :4] = ops.scale_boxes(img.shape[2:], pred[:, :4], shape).round()
@@ -449,7 +908,7 @@ void AutoBackendOnnx::postprocess_kpts(cv::Mat& output0, ImageInfo& image_info,
 //        scale_coords(img1_shape, kpt, image_info.raw_size);
         // TODO: overload scale_coords so that will accept cv::Mat of shape [17, 3]
         //      so that it will be more similar to what we have in python
-        std::vector<float> kpt = scale_coords(img1_shape, rest[i], image_info.raw_size);
+        std::vector<float> kpt = with_keypoints ? scale_coords(img1_shape, rest[i], image_info.raw_size) : std::vector<float>();
         YoloResults tmp_res = { class_ids[i], confidences[i], scaled_bbox, {}, kpt};
         output.push_back(tmp_res);
     }
@@ -494,17 +953,51 @@ void AutoBackendOnnx::_get_mask2(const cv::Mat& masks_features,
 }
 
 
+void AutoBackendOnnx::_get_mask_box_local(const cv::Mat& masks_features, const cv::Mat& proto, const ImageInfo& image_info,
+    const cv::Rect& bound, cv::Mat& mask_out, float mask_thresh, int iw, int ih, int mw, int mh)
+{
+    if (bound.width <= 0 || bound.height <= 0) {
+        mask_out = cv::Mat();
+        return;
+    }
+    // threshold the logits instead of the sigmoid: same decision, no exp() over the mask
+    const float p = std::min(std::max(mask_thresh, 1e-6f), 1.0f - 1e-6f);
+    const double logit_thresh = std::log(p / (1.0f - p));
+    cv::Mat logits = masks_features * proto;
+    logits = logits.reshape(1, mh);
+
+    // image pixel centre -> letterboxed input -> proto pixel centre, as the inverse map of one affine warp
+    const cv::Size img0_shape = image_info.raw_size;
+    const double gain = std::min(static_cast<double>(ih) / img0_shape.height, static_cast<double>(iw) / img0_shape.width);
+    const double pad_x = (iw - img0_shape.width * gain) / 2.0;
+    const double pad_y = (ih - img0_shape.height * gain) / 2.0;
+    const double sx = static_cast<double>(mw) / iw;
+    const double sy = static_cast<double>(mh) / ih;
+    double inverse_values[6] = {
+        gain * sx, 0.0, ((bound.x + 0.5) * gain + pad_x) * sx - 0.5,
+        0.0, gain * sy, ((bound.y + 0.5) * gain + pad_y) * sy - 0.5 };
+    const cv::Mat inverse(2, 3, CV_64F, inverse_values);
+    cv::Mat box_logits;
+    cv::warpAffine(logits, box_logits, inverse, bound.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+    mask_out = box_logits > logit_thresh;
+}
+
+
 void AutoBackendOnnx::fill_blob(cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape) {
 
-	cv::Mat floatImage;
     if (inputTensorShape.empty())
     {
         inputTensorShape = getInputTensorShape();
     }
-    int inputChannelsNum = inputTensorShape[1];
+    blob = new float[image.cols * image.rows * image.channels()];
+    fill_blob(image, blob);
+}
+
+void AutoBackendOnnx::fill_blob(const cv::Mat& image, float* blob) {
+
+    cv::Mat floatImage;
     int rtype = CV_32FC3;
     image.convertTo(floatImage, rtype, 1.0f / 255.0);
-    blob = new float[floatImage.cols * floatImage.rows * floatImage.channels()];
     cv::Size floatImageSize{ floatImage.cols, floatImage.rows };
 
     // hwc -> chw
@@ -515,4 +1008,3 @@ void AutoBackendOnnx::fill_blob(cv::Mat& image, float*& blob, std::vector<int64_
     }
     cv::split(floatImage, chw);
 }
-
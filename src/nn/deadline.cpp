@@ -0,0 +1,79 @@
+#include "nn/deadline.h"
+
+#include <algorithm>
+#include <thread>
+
+
+DeadlineExceededError::DeadlineExceededError(const std::string& stage)
+    : std::runtime_error("DeadlineExceededError: deadline passed before or during " + stage), stage_(stage) {
+}
+
+const std::string& DeadlineExceededError::stage() const {
+    return stage_;
+}
+
+void check_deadline(const Deadline& deadline, const char* stage) {
+    if (has_deadline(deadline) && std::chrono::steady_clock::now() >= deadline) {
+        throw DeadlineExceededError(stage);
+    }
+}
+
+
+RunWatchdog::Watch::Watch(const Deadline& deadline, Ort::RunOptions& options)
+    : id_(RunWatchdog::global().add(deadline, options)) {
+}
+
+RunWatchdog::Watch::~Watch() {
+    RunWatchdog::global().remove(id_);
+}
+
+RunWatchdog& RunWatchdog::global() {
+    static RunWatchdog* watchdog = new RunWatchdog();  // intentionally leaked, like ThreadPool::global()
+    return *watchdog;
+}
+
+RunWatchdog::RunWatchdog() {
+    std::thread(&RunWatchdog::loop, this).detach();
+}
+
+uint64_t RunWatchdog::add(const Deadline& deadline, Ort::RunOptions& options) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        entries_.emplace(id, Entry{ deadline, &options });
+    }
+    cv_.notify_one();
+    return id;
+}
+
+void RunWatchdog::remove(uint64_t id) {
+    // SetTerminate() is only called under the mutex, so the options are never touched after this returns
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(id);
+}
+
+void RunWatchdog::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (entries_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        const Deadline now = std::chrono::steady_clock::now();
+        Deadline earliest = Deadline::max();
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.deadline <= now) {
+                it->second.options->SetTerminate();
+                it = entries_.erase(it);
+            }
+            else {
+                earliest = std::min(earliest, it->second.deadline);
+                ++it;
+            }
+        }
+        if (earliest != Deadline::max()) {
+            cv_.wait_until(lock, earliest);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#include "nn/execution_providers.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "constants.h"
+
+
+namespace {
+    std::mutex registry_mutex;
+
+    // a deque, so pointers handed out by find_execution_provider() survive later registrations
+
+    std::deque<ExecutionProviderPlugin>& registry() {
+        static std::deque<ExecutionProviderPlugin> plugins = [] {
+            std::deque<ExecutionProviderPlugin> builtin;
+            builtin.push_back({ OnnxProviders::CPU, "CPUExecutionProvider", true, [](Ort::SessionOptions&, const ExecutionProviderContext&) {
+                // the default provider, always present
+            } });
+            builtin.push_back({ OnnxProviders::CUDA, "CUDAExecutionProvider", false, [](Ort::SessionOptions& options, const ExecutionProviderContext&) {
+                OrtCUDAProviderOptions cudaOption;
+                options.AppendExecutionProvider_CUDA(cudaOption);
+            } });
+            builtin.push_back({ OnnxProviders::OPENVINO, "OpenVINOExecutionProvider", true, [](Ort::SessionOptions& options, const ExecutionProviderContext&) {
+                options.AppendExecutionProvider_OpenVINO_V2({ { "device_type", "CPU" } });
+            } });
+            builtin.push_back({ OnnxProviders::DNNL, "DnnlExecutionProvider", true, [](Ort::SessionOptions& options, const ExecutionProviderContext&) {
+                const OrtApi& api = Ort::GetApi();
+                OrtDnnlProviderOptions* dnnl = nullptr;
+                Ort::ThrowOnError(api.CreateDnnlProviderOptions(&dnnl));
+                std::unique_ptr<OrtDnnlProviderOptions, void (*)(OrtDnnlProviderOptions*)> guard(dnnl, api.ReleaseDnnlProviderOptions);
+                Ort::ThrowOnError(api.SessionOptionsAppendExecutionProvider_Dnnl(options, dnnl));
+            } });
+            builtin.push_back({ OnnxProviders::XNNPACK, "XnnpackExecutionProvider", true,
+                                [](Ort::SessionOptions& options, const ExecutionProviderContext& context) {
+                // XNNPACK brings its own pool, sized like the session's; ORT's intra-op pool then only runs the nodes
+                // XNNPACK doesn't take
+                const int threads = std::max(1, context.intra_op_threads);
+                options.AppendExecutionProvider("XNNPACK", { { "intra_op_num_threads", std::to_string(threads) } });
+            } });
+            return builtin;
+        }();
+        return plugins;
+    }
+}
+
+
+void register_execution_provider(const ExecutionProviderPlugin& plugin) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::deque<ExecutionProviderPlugin>& plugins = registry();
+    auto existing = std::find_if(plugins.begin(), plugins.end(),
+        [&plugin](const ExecutionProviderPlugin& p) { return p.name == plugin.name; });
+    if (existing != plugins.end()) {
+        *existing = plugin;
+    }
+    else {
+        plugins.push_back(plugin);
+    }
+}
+
+const ExecutionProviderPlugin* find_execution_provider(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const ExecutionProviderPlugin& plugin : registry()) {
+        if (plugin.name == name || plugin.ort_name == name) {
+            return &plugin;
+        }
+    }
+    return nullptr;
+}
+
+bool is_execution_provider_available(const ExecutionProviderPlugin& plugin) {
+    static const std::vector<std::string> available = Ort::GetAvailableProviders();
+    return std::find(available.begin(), available.end(), plugin.ort_name) != available.end();
+}
+
+std::vector<std::string> parse_execution_providers(const std::string& providers) {
+    std::vector<std::string> names;
+    std::stringstream list(providers);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        const ExecutionProviderPlugin* plugin = find_execution_provider(item);
+        if (plugin == nullptr) {
+            throw std::runtime_error("NotImplemented provider=" + item);
+        }
+        names.push_back(plugin->name);
+    }
+    return names;
+}
+
+std::vector<std::string> auto_execution_providers() {
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const ExecutionProviderPlugin& plugin : registry()) {
+        if (plugin.cpu && plugin.name != OnnxProviders::CPU && is_execution_provider_available(plugin)) {
+            names.push_back(plugin.name);
+        }
+    }
+    names.push_back(OnnxProviders::CPU);
+    return names;
+}
@@ -1,49 +1,285 @@
 #include "nn/onnx_model_base.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <onnxruntime/onnxruntime_cxx_api.h>
 #include <onnxruntime/onnxruntime_c_api.h>
 
 #include "constants.h"
+#include "nn/execution_providers.h"
+#include "utils/affinity.h"
 #include "utils/common.h"
 
+namespace {
+    // the env arena can only be registered once per process (OrtEnv itself is a process-wide singleton)
+    std::once_flag env_allocator_flag;
+
+    std::mutex global_env_mutex;
+    std::shared_ptr<Ort::Env> global_env;
+    int global_intra_threads = 0;
+    bool any_env_created = false;
+
+    // `--provider=auto` benchmarks once per model file; replicas (--sessions, --numa) reuse the choice so they
+    // all end up on the same provider
+    std::mutex auto_choice_mutex;
+    std::map<std::string, std::pair<std::string, double>> auto_choices;  // model path -> provider, latency
+
+    // median latency of a few runs on zero inputs; dynamic dims get batch 1 and 640 px
+    double benchmark_session(Ort::Session& session, int runs = 5) {
+        Ort::AllocatorWithDefaultOptions allocator;
+        std::vector<std::string> inputNames;
+        std::vector<std::vector<int64_t>> shapes;
+        std::vector<std::vector<float>> buffers;
+        std::vector<Ort::Value> inputs;
+        Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        for (size_t i = 0; i < session.GetInputCount(); ++i) {
+            inputNames.emplace_back(session.GetInputNameAllocated(i, allocator).get());
+            Ort::ConstTensorTypeAndShapeInfo info = session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo();
+            if (info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+                throw std::runtime_error("provider benchmark: input " + inputNames.back() + " is not float");
+            }
+            std::vector<int64_t> shape = info.GetShape();
+            for (size_t d = 0; d < shape.size(); ++d) {
+                if (shape[d] <= 0) {
+                    shape[d] = d == 0 ? 1 : 640;
+                }
+            }
+            shapes.push_back(shape);
+            buffers.emplace_back(static_cast<size_t>(vector_product(shape)), 0.0f);
+        }
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            inputs.push_back(Ort::Value::CreateTensor<float>(memoryInfo, buffers[i].data(), buffers[i].size(),
+                                                             shapes[i].data(), shapes[i].size()));
+        }
+        std::vector<std::string> outputNames;
+        for (size_t i = 0; i < session.GetOutputCount(); ++i) {
+            outputNames.emplace_back(session.GetOutputNameAllocated(i, allocator).get());
+        }
+        std::vector<const char*> inputNamesCStr, outputNamesCStr;
+        for (const std::string& name : inputNames) {
+            inputNamesCStr.push_back(name.c_str());
+        }
+        for (const std::string& name : outputNames) {
+            outputNamesCStr.push_back(name.c_str());
+        }
+
+        std::vector<double> times;
+        for (int run = -1; run < runs; ++run) {  // run -1 warms up (first-run kernel setup, arena growth)
+            const auto start = std::chrono::steady_clock::now();
+            session.Run(Ort::RunOptions{ nullptr }, inputNamesCStr.data(), inputs.data(), inputs.size(),
+                        outputNamesCStr.data(), outputNamesCStr.size());
+            if (run >= 0) {
+                times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        return times[times.size() / 2];
+    }
+
+    void register_env_allocator(Ort::Env& env, size_t max_bytes) {
+        std::call_once(env_allocator_flag, [&env, max_bytes]() {
+            Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+            // 0/-1 - ORT defaults for max memory, extend strategy, initial chunk and dead bytes per chunk;
+            // a capped arena grows by exactly what is requested (kSameAsRequested) instead of doubling
+            Ort::ArenaCfg arenaCfg(max_bytes, max_bytes > 0 ? 1 : -1, -1, -1);
+            env.CreateAndRegisterAllocator(memoryInfo, arenaCfg);
+        });
+    }
+}
+
 OnnxModelBase::OnnxModelBase(const char* modelPath, const char* logid, const char* provider)
-    : modelPath_(modelPath)
+    : OnnxModelBase(modelPath, logid, provider, OnnxSessionConfig())
+{
+}
+
+OnnxModelBase::OnnxModelBase(const char* modelPath, const char* logid, const char* provider, const OnnxSessionConfig& config)
+    : modelPath_(modelPath), prepackedWeights(config.prepacked_weights)
 {
     // Initialize the ONNX Runtime environment
-    env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, logid);
+    {
+        std::lock_guard<std::mutex> lock(global_env_mutex);
+        globalEnv = global_env;
+        any_env_created = true;
+    }
+    if (!globalEnv) {
+        env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, logid);
+    }
+    Ort::Env& sessionEnv = globalEnv ? *globalEnv : env;
     Ort::SessionOptions sessionOptions = Ort::SessionOptions();
+    if (globalEnv) {
+        // run on the env's thread pools, shared by every session in the process
+        sessionOptions.DisablePerSessionThreads();
+        sessionOptions.SetLogId(logid);
+    }
+    if (!config.intra_op_cpus.empty()) {
+        if (globalEnv) {
+            std::cerr << "Warning: intra_op_cpus is ignored for sessions on the global thread pools" << std::endl;
+        }
+        else {
+            // ORT only creates threads for the extra workers, the caller of Run() is worker 0;
+            // the affinity string lists one CPU set per extra worker, separated by ';'
+            std::string affinities;
+            for (size_t i = 1; i < config.intra_op_cpus.size(); ++i) {
+                affinities += (i > 1 ? ";" : "") + std::to_string(config.intra_op_cpus[i] + 1);  // 1-based ids
+            }
+            sessionOptions.SetIntraOpNumThreads(static_cast<int>(config.intra_op_cpus.size()));
+            if (!affinities.empty()) {
+                sessionOptions.AddConfigEntry("session.intra_op_thread_affinities", affinities.c_str());
+            }
+        }
+    }
+    if (config.intra_op_threads > 0 && config.intra_op_cpus.empty()) {
+        if (globalEnv) {
+            std::cerr << "Warning: intra_op_threads is ignored for sessions on the global thread pools" << std::endl;
+        }
+        else {
+            sessionOptions.SetIntraOpNumThreads(config.intra_op_threads);
+        }
+    }
+    if (config.parallel_execution) {
+        sessionOptions.SetExecutionMode(ORT_PARALLEL);
+    }
+    lowMemory_ = config.low_memory;
+    const bool envArena = config.use_env_allocators || config.arena_max_bytes > 0;
+    if (config.low_memory) {
+        // planned buffers are sized for the largest run seen and never given back
+        sessionOptions.DisableMemPattern();
+        if (!envArena) {
+            sessionOptions.DisableCpuMemArena();
+        }
+        shrinkArena_ = envArena;
+    }
+    if (envArena) {
+        register_env_allocator(sessionEnv, config.arena_max_bytes);
+        sessionOptions.AddConfigEntry("session.use_env_allocators", "1");
+    }
 
-    // Get list of available providers from the runtime
-    std::vector<std::string> availableProviders = Ort::GetAvailableProviders();
-    auto cudaAvailable = std::find(availableProviders.begin(), availableProviders.end(), OnnxProviders::CUDA);
-    OrtCUDAProviderOptions cudaOption;
+    // providers with their own thread pool (XNNPACK) size it like the session's intra-op pool
+    ExecutionProviderContext providerContext;
+    if (globalEnv) {
+        providerContext.intra_op_threads = global_intra_threads;
+    }
+    else if (!config.intra_op_cpus.empty()) {
+        providerContext.intra_op_threads = static_cast<int>(config.intra_op_cpus.size());
+    }
+    else if (config.intra_op_threads > 0) {
+        providerContext.intra_op_threads = config.intra_op_threads;
+    }
+    if (providerContext.intra_op_threads <= 0) {
+        providerContext.intra_op_threads = static_cast<int>(current_thread_cpus().size());
+    }
 
+    // `--provider` is an ordered fallback list ("openvino,dnnl,cpu"); cpu is always the last resort
     std::string providerStr(provider);
-    if (providerStr == OnnxProviders::CUDA) {
-        if (cudaAvailable == availableProviders.end()) {
-            std::cout << "CUDA is not supported by your ONNXRuntime build. Falling back to CPU." << std::endl;
-            // CPU is default so we do nothing
-        } else {
-            sessionOptions.AppendExecutionProvider_CUDA(cudaOption);
+    bool autoSelect = providerStr == OnnxProviders::AUTO;
+    std::vector<std::string> candidates;
+    double reusedLatencyMs = -1.0;
+    if (autoSelect) {
+        std::lock_guard<std::mutex> lock(auto_choice_mutex);
+        auto choice = auto_choices.find(modelPath_);
+        if (choice != auto_choices.end()) {
+            candidates.push_back(choice->second.first);
+            reusedLatencyMs = choice->second.second;
+            autoSelect = false;
         }
     }
-    else if (providerStr == OnnxProviders::CPU || providerStr == OnnxProviders::CPUExecutionProvider) {
-        // CPU is the default provider in ONNX Runtime, so no need to append an execution provider.
-        // Do nothing.
+    if (candidates.empty()) {
+        candidates = autoSelect ? auto_execution_providers() : parse_execution_providers(providerStr);
     }
-    else {
-        throw std::runtime_error("NotImplemented provider=" + providerStr);
+    if (std::find(candidates.begin(), candidates.end(), OnnxProviders::CPU) == candidates.end()) {
+        candidates.push_back(OnnxProviders::CPU);
     }
 
-    std::cout << "Inference device: " << providerStr << std::endl;
-
+    // sessions created with the same container reuse the weights another session already prepacked
+    OrtPrepackedWeightsContainer* prepackedContainer = prepackedWeights ? static_cast<OrtPrepackedWeightsContainer*>(*prepackedWeights) : nullptr;
+    auto createSession = [&](const Ort::SessionOptions& options) {
     #ifdef _WIN32
         auto modelPathW = get_win_path(modelPath);  // For Windows: convert to wstring
-        session = Ort::Session(env, modelPathW.c_str(), sessionOptions);
+        return prepackedContainer
+            ? Ort::Session(sessionEnv, modelPathW.c_str(), options, prepackedContainer)
+            : Ort::Session(sessionEnv, modelPathW.c_str(), options);
     #else
-        session = Ort::Session(env, modelPath, sessionOptions);  // For Linux (and macOS)
+        return prepackedContainer
+            ? Ort::Session(sessionEnv, modelPath, options, prepackedContainer)
+            : Ort::Session(sessionEnv, modelPath, options);  // For Linux (and macOS)
     #endif
+    };
+
+    std::string benchmarkLog;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const std::string& name = candidates[i];
+        const ExecutionProviderPlugin* plugin = find_execution_provider(name);
+        const bool last = i + 1 == candidates.size();
+        if (!is_execution_provider_available(*plugin)) {
+            std::cout << name << " is not supported by your ONNXRuntime build, trying the next provider." << std::endl;
+            continue;
+        }
+        Ort::Session candidate{ nullptr };
+        try {
+            Ort::SessionOptions options = sessionOptions.Clone();
+            plugin->append(options, providerContext);
+            candidate = createSession(options);
+        }
+        catch (const std::exception& e) {
+            if (last) {
+                throw;
+            }
+            std::cerr << "Warning: provider " << name << " failed (" << e.what() << "), trying the next one" << std::endl;
+            continue;
+        }
+        if (!autoSelect) {
+            session = std::move(candidate);
+            provider_ = name;
+            break;
+        }
+        // --provider=auto: keep the fastest one on this model
+        double latency = 0.0;
+        try {
+            latency = benchmark_session(candidate);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Warning: cannot benchmark provider " << name << ": " << e.what() << std::endl;
+            if (provider_.empty()) {
+                session = std::move(candidate);
+                provider_ = name;
+            }
+            continue;
+        }
+        std::ostringstream entry;
+        entry << (benchmarkLog.empty() ? "" : ", ") << name << " " << std::fixed << std::setprecision(1) << latency << " ms";
+        benchmarkLog += entry.str();
+        if (provider_.empty() || providerLatencyMs_ < 0.0 || latency < providerLatencyMs_) {
+            session = std::move(candidate);
+            provider_ = name;
+            providerLatencyMs_ = latency;
+        }
+    }
+    if (provider_.empty()) {
+        throw std::runtime_error("No usable execution provider in '" + providerStr + "'");
+    }
+
+    if (autoSelect) {
+        {
+            std::lock_guard<std::mutex> lock(auto_choice_mutex);
+            auto_choices.emplace(modelPath_, std::make_pair(provider_, providerLatencyMs_));
+        }
+        std::cout << "Provider benchmark: " << benchmarkLog << std::endl;
+        std::cout << "Inference device: " << provider_ << " (" << providerLatencyMs_ << " ms per run)" << std::endl;
+    }
+    else if (reusedLatencyMs >= 0.0 && provider_ == candidates[0]) {
+        providerLatencyMs_ = reusedLatencyMs;
+        std::cout << "Inference device: " << provider_ << " (benchmarked by an earlier session, " << providerLatencyMs_
+                  << " ms per run)" << std::endl;
+    }
+    else {
+        std::cout << "Inference device: " << provider_ << std::endl;
+    }
 
     // ----------------
     // Initialize input names and copy them to member storage to extend lifetime
@@ -52,6 +288,7 @@ OnnxModelBase::OnnxModelBase(const char* modelPath, const char* logid, const cha
     for (size_t i = 0; i < inputNodesNum; i++) {
         auto input_name = session.GetInputNameAllocated(i, allocator);
         inputNodeNames.push_back(std::string(input_name.get()));
+        inputNodeShapes.push_back(session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape());
     }
     for (const auto& name : inputNodeNames) {
         inputNamesCStr.push_back(name.c_str());
@@ -64,6 +301,7 @@ OnnxModelBase::OnnxModelBase(const char* modelPath, const char* logid, const cha
     for (size_t i = 0; i < outputNodesNum; i++) {
         auto output_name = session.GetOutputNameAllocated(i, output_names_allocator);
         outputNodeNames.push_back(std::string(output_name.get()));
+        outputNodeShapes.push_back(session.GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape());
     }
     for (const auto& name : outputNodeNames) {
         outputNamesCStr.push_back(name.c_str());
@@ -88,6 +326,41 @@ OnnxModelBase::OnnxModelBase(const char* modelPath, const char* logid, const cha
     }
 }
 
+OnnxModelBase::~OnnxModelBase()
+{
+    // the session references the prepacked weights and the shared env, release it before they can go away
+    session = Ort::Session(nullptr);
+}
+
+std::shared_ptr<Ort::PrepackedWeightsContainer> OnnxModelBase::sharedPrepackedWeights()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<Ort::PrepackedWeightsContainer> shared;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<Ort::PrepackedWeightsContainer> container = shared.lock();
+    if (!container) {
+        container = std::make_shared<Ort::PrepackedWeightsContainer>();
+        shared = container;
+    }
+    return container;
+}
+
+bool OnnxModelBase::useGlobalThreadPools(const OnnxThreadingConfig& config)
+{
+    std::lock_guard<std::mutex> lock(global_env_mutex);
+    if (any_env_created || global_env) {
+        std::cerr << "Warning: global thread pools must be configured before the first model is created" << std::endl;
+        return false;
+    }
+    Ort::ThreadingOptions threadingOptions;
+    threadingOptions.SetGlobalIntraOpNumThreads(config.intra_op_threads);
+    threadingOptions.SetGlobalInterOpNumThreads(config.inter_op_threads);
+    threadingOptions.SetGlobalSpinControl(config.allow_spinning ? 1 : 0);
+    global_env = std::make_shared<Ort::Env>(threadingOptions, ORT_LOGGING_LEVEL_WARNING, "helmsman");
+    global_intra_threads = config.intra_op_threads;
+    return true;
+}
+
 const std::vector<std::string>& OnnxModelBase::getInputNames() {
     return inputNodeNames;
 }
@@ -111,6 +384,28 @@ const Ort::Session& OnnxModelBase::getSession()
     return session;
 }
 
+const std::string& OnnxModelBase::getProvider() const
+{
+    return provider_;
+}
+
+double OnnxModelBase::getProviderLatencyMs() const
+{
+    return providerLatencyMs_;
+}
+
+bool OnnxModelBase::isLowMemory() const
+{
+    return lowMemory_;
+}
+
+void OnnxModelBase::configureRun(Ort::RunOptions& runOptions) const
+{
+    if (shrinkArena_) {
+        runOptions.AddConfigEntry("memory.enable_memory_arena_shrinkage", "cpu:0");
+    }
+}
+
 const char* OnnxModelBase::getModelPath()
 {
     return modelPath_;
@@ -126,12 +421,60 @@ const std::vector<const char*> OnnxModelBase::getInputNamesCStr()
     return inputNamesCStr;
 }
 
+const std::vector<std::vector<int64_t>>& OnnxModelBase::getInputShapes()
+{
+    return inputNodeShapes;
+}
+
+const std::vector<std::vector<int64_t>>& OnnxModelBase::getOutputShapes()
+{
+    return outputNodeShapes;
+}
+
 std::vector<Ort::Value> OnnxModelBase::forward(std::vector<Ort::Value>& inputTensors)
 {
-    return session.Run(Ort::RunOptions{ nullptr },
+    return forward(inputTensors, outputNamesCStr);
+}
+
+std::vector<Ort::Value> OnnxModelBase::forward(std::vector<Ort::Value>& inputTensors, const std::vector<const char*>& outputNames)
+{
+    Ort::RunOptions runOptions{ nullptr };
+    if (shrinkArena_) {
+        runOptions = Ort::RunOptions();
+        configureRun(runOptions);
+    }
+    // ORT prunes the nodes that only feed outputs nobody asked for
+    return session.Run(runOptions,
         inputNamesCStr.data(),
         inputTensors.data(),
         inputNamesCStr.size(),
-        outputNamesCStr.data(),
-        outputNamesCStr.size());
+        outputNames.data(),
+        outputNames.size());
+}
+
+std::vector<Ort::Value> OnnxModelBase::forward(std::vector<Ort::Value>& inputTensors, const std::vector<const char*>& outputNames,
+    const Deadline& deadline)
+{
+    if (!has_deadline(deadline)) {
+        return forward(inputTensors, outputNames);
+    }
+    check_deadline(deadline, "forward");
+    Ort::RunOptions runOptions;
+    configureRun(runOptions);
+    RunWatchdog::Watch watch(deadline, runOptions);
+    try {
+        return session.Run(runOptions,
+            inputNamesCStr.data(),
+            inputTensors.data(),
+            inputNamesCStr.size(),
+            outputNames.data(),
+            outputNames.size());
+    }
+    catch (const Ort::Exception&) {
+        // a terminated Run() fails with a generic error, tell it apart from real failures by the clock
+        if (std::chrono::steady_clock::now() >= deadline) {
+            throw DeadlineExceededError("forward");
+        }
+        throw;
+    }
 }
@@ -0,0 +1,99 @@
+#include "pipeline/annotated_video_writer.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+
+AnnotatedVideoWriter::AnnotatedVideoWriter(const std::string& path, const cv::Size& frame_size,
+                                           const ResultPlotter& plotter, const AnnotatedVideoWriterConfig& config)
+    : config_(config), plotter_(plotter), frame_size_(frame_size) {
+    if (config_.fourcc.size() != 4) {
+        throw std::runtime_error("AnnotatedVideoWriter: fourcc must have 4 characters, got '" + config_.fourcc + "'");
+    }
+    if (config_.max_queue == 0) {
+        config_.max_queue = 1;
+    }
+    const int fourcc = cv::VideoWriter::fourcc(config_.fourcc[0], config_.fourcc[1], config_.fourcc[2], config_.fourcc[3]);
+    const double fps = config_.fps > 0.0 ? config_.fps : 30.0;
+    if (!writer_.open(path, fourcc, fps, frame_size_) || !writer_.isOpened()) {
+        throw std::runtime_error("AnnotatedVideoWriter: unable to open " + path + " for writing");
+    }
+    thread_ = std::thread(&AnnotatedVideoWriter::worker, this);
+}
+
+AnnotatedVideoWriter::~AnnotatedVideoWriter() {
+    close();
+}
+
+bool AnnotatedVideoWriter::write(cv::Mat frame, std::vector<YoloResults> results) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closing_) {
+            throw std::runtime_error("AnnotatedVideoWriter: write() after close()");
+        }
+        if (queue_.size() >= config_.max_queue) {
+            if (config_.drop_when_full) {
+                ++stats_.dropped;
+                return false;
+            }
+            not_full_.wait(lock, [this] { return queue_.size() < config_.max_queue; });
+        }
+        queue_.push_back(Item{ std::move(frame), std::move(results) });
+    }
+    not_empty_.notify_one();
+    return true;
+}
+
+void AnnotatedVideoWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_) {
+            return;
+        }
+        closing_ = true;
+    }
+    not_empty_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    writer_.release();
+}
+
+AnnotatedVideoWriterStats AnnotatedVideoWriter::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void AnnotatedVideoWriter::worker() {
+    using clock = std::chrono::steady_clock;
+    while (true) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;  // closing and drained
+            }
+            item = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        not_full_.notify_one();
+
+        auto t0 = clock::now();
+        plotter_.draw(item.frame, item.results);
+        if (item.frame.size() != frame_size_) {
+            // cv::VideoWriter silently skips frames of a different size
+            cv::resize(item.frame, item.frame, frame_size_);
+        }
+        auto t1 = clock::now();
+        writer_.write(item.frame);
+        auto t2 = clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.written;
+        stats_.render_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats_.encode_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+    }
+}
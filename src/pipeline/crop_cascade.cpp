@@ -0,0 +1,107 @@
+#include "pipeline/crop_cascade.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+
+CropCascade::CropCascade(AutoBackendOnnx& detector, AutoBackendOnnx& refiner, const CropCascadeConfig& config)
+    : detector_(detector), refiner_(refiner), config_(config) {
+    if (refiner_.getTask() != YoloTasks::CLASSIFY && refiner_.getTask() != YoloTasks::POSE) {
+        throw std::invalid_argument("CropCascade: the second stage must be a classify or pose model, got task '"
+                                    + refiner_.getTask() + "'");
+    }
+}
+
+std::vector<YoloResults> CropCascade::predict(const cv::Mat& image, const PredictParams& params) {
+    return std::move(predict_batch({ image }, { params })[0]);
+}
+
+std::vector<std::vector<YoloResults>> CropCascade::predict_batch(const std::vector<cv::Mat>& images,
+                                                                 const std::vector<PredictParams>& params) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<YoloResults>> detections = detector_.predict_batch(images, params);
+    stats_.detect_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    refine(images, detections);
+    return detections;
+}
+
+void CropCascade::refine(const std::vector<cv::Mat>& images, std::vector<std::vector<YoloResults>>& detections) {
+    if (images.size() != detections.size()) {
+        throw std::invalid_argument("CropCascade::refine: expected one result list per image");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    struct CropRef {
+        size_t image;
+        size_t result;
+        cv::Rect roi;
+    };
+    std::vector<CropRef> refs;
+    std::vector<cv::Mat> crops;
+    std::vector<size_t> order;
+    for (size_t i = 0; i < images.size(); ++i) {
+        const std::vector<YoloResults>& results = detections[i];
+        const cv::Rect bounds(0, 0, images[i].cols, images[i].rows);
+        order.resize(results.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&results](size_t a, size_t b) { return results[a].conf > results[b].conf; });
+
+        size_t taken = 0;
+        for (size_t j : order) {
+            if (taken >= config_.max_crops) {
+                break;
+            }
+            const YoloResults& result = results[j];
+            if (!config_.classes.empty()
+                && std::find(config_.classes.begin(), config_.classes.end(), result.class_idx) == config_.classes.end()) {
+                continue;
+            }
+            const float pad_x = result.bbox.width * config_.padding;
+            const float pad_y = result.bbox.height * config_.padding;
+            const cv::Rect roi = cv::Rect(cv::Rect_<float>(result.bbox.x - pad_x, result.bbox.y - pad_y,
+                                                           result.bbox.width + 2 * pad_x, result.bbox.height + 2 * pad_y)) & bounds;
+            if (roi.width < config_.min_size || roi.height < config_.min_size) {
+                continue;
+            }
+            refs.push_back(CropRef{ i, j, roi });
+            crops.push_back(images[i](roi));  // a view; predict_batch resizes it into the blob (after a cvtColor copy if the model converts color)
+            ++taken;
+        }
+    }
+    stats_.images += images.size();
+    if (crops.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<YoloResults>> refined = refiner_.predict_batch(crops, { config_.params });
+    const bool pose = refiner_.getTask() == YoloTasks::POSE;
+    for (size_t k = 0; k < refs.size(); ++k) {
+        const std::vector<YoloResults>& second = refined[k];
+        if (second.empty()) {
+            continue;
+        }
+        YoloResults& target = detections[refs[k].image][refs[k].result];
+        const YoloResults& best = *std::max_element(second.begin(), second.end(),
+            [](const YoloResults& a, const YoloResults& b) { return a.conf < b.conf; });
+        if (pose) {
+            // crop coordinates -> image coordinates, keypoints are (x, y, visibility) triplets
+            target.keypoints = best.keypoints;
+            for (size_t v = 0; v + 1 < target.keypoints.size(); v += 3) {
+                target.keypoints[v] += static_cast<float>(refs[k].roi.x);
+                target.keypoints[v + 1] += static_cast<float>(refs[k].roi.y);
+            }
+        }
+        else {
+            target.sub_class_idx = best.class_idx;
+            target.sub_conf = best.conf;
+        }
+        ++stats_.refined;
+    }
+    stats_.crops += crops.size();
+    stats_.refine_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+CropCascadeStats CropCascade::getStats() const {
+    return stats_;
+}
@@ -0,0 +1,307 @@
+#include "pipeline/frame_archive.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+    constexpr char MAGIC[8] = { 'H', 'L', 'M', 'S', 'H', 'F', 'A', '1' };
+    constexpr uint64_t HEADER_SIZE = 64;
+    constexpr uint64_t ALIGNMENT = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t kind;
+        uint32_t entry_size;
+        uint64_t count;
+        uint64_t index_offset;
+    };
+    static_assert(sizeof(Header) <= HEADER_SIZE, "frame archive header must fit its slot");
+}
+
+
+FrameArchiveWriter::FrameArchiveWriter(const std::string& path, FrameArchiveKind kind)
+    : path_(path), file_(path, std::ios::binary | std::ios::trunc), kind_(kind), offset_(HEADER_SIZE)
+{
+    if (!file_) {
+        throw std::runtime_error("FrameArchiveWriter: cannot create " + path);
+    }
+    const char zeros[HEADER_SIZE] = {};
+    file_.write(zeros, HEADER_SIZE);  // filled in by close()
+}
+
+FrameArchiveWriter::~FrameArchiveWriter()
+{
+    try {
+        close();
+    }
+    catch (...) {
+    }
+}
+
+void FrameArchiveWriter::writePayload(const void* data, size_t bytes, FrameArchiveEntry& entry)
+{
+    if (closed_) {
+        throw std::runtime_error("FrameArchiveWriter: append() after close()");
+    }
+    const char zeros[ALIGNMENT] = {};
+    const uint64_t padding = (ALIGNMENT - offset_ % ALIGNMENT) % ALIGNMENT;
+    file_.write(zeros, static_cast<std::streamsize>(padding));
+    offset_ += padding;
+    entry.offset = offset_;
+    entry.bytes = bytes;
+    file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    if (!file_) {
+        throw std::runtime_error("FrameArchiveWriter: write to " + path_ + " failed");
+    }
+    offset_ += bytes;
+    index_.push_back(entry);
+}
+
+void FrameArchiveWriter::append(const cv::Mat& frame, double timestamp_ms)
+{
+    if (kind_ != FrameArchiveKind::FRAMES) {
+        throw std::logic_error("FrameArchiveWriter: append() on a blob archive");
+    }
+    const cv::Mat continuous = frame.isContinuous() ? frame : frame.clone();
+    FrameArchiveEntry entry;
+    entry.rows = entry.raw_rows = frame.rows;
+    entry.cols = entry.raw_cols = frame.cols;
+    entry.type = frame.type();
+    entry.timestamp_ms = timestamp_ms;
+    writePayload(continuous.data, continuous.total() * continuous.elemSize(), entry);
+}
+
+void FrameArchiveWriter::appendBlob(const float* blob, const cv::Size& input_size, int channels, const cv::Size& raw_size,
+                                    double timestamp_ms)
+{
+    if (kind_ != FrameArchiveKind::BLOBS) {
+        throw std::logic_error("FrameArchiveWriter: appendBlob() on a frame archive");
+    }
+    FrameArchiveEntry entry;
+    entry.rows = input_size.height;
+    entry.cols = input_size.width;
+    entry.type = CV_32FC(channels);
+    entry.raw_rows = raw_size.height;
+    entry.raw_cols = raw_size.width;
+    entry.timestamp_ms = timestamp_ms;
+    writePayload(blob, static_cast<size_t>(channels) * input_size.area() * sizeof(float), entry);
+}
+
+void FrameArchiveWriter::close()
+{
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    const uint64_t padding = (8 - offset_ % 8) % 8;  // keep the index's doubles aligned in the mapping
+    const char zeros[8] = {};
+    file_.write(zeros, static_cast<std::streamsize>(padding));
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.kind = static_cast<uint32_t>(kind_);
+    header.entry_size = sizeof(FrameArchiveEntry);
+    header.count = index_.size();
+    header.index_offset = offset_ + padding;
+    file_.write(reinterpret_cast<const char*>(index_.data()), static_cast<std::streamsize>(index_.size() * sizeof(FrameArchiveEntry)));
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.close();
+    if (!file_) {
+        throw std::runtime_error("FrameArchiveWriter: finishing " + path_ + " failed");
+    }
+}
+
+size_t FrameArchiveWriter::size() const
+{
+    return index_.size();
+}
+
+uint64_t FrameArchiveWriter::bytes() const
+{
+    return offset_;
+}
+
+
+#ifndef _WIN32
+
+FrameArchive::FrameArchive(const std::string& path, bool preload)
+    : path_(path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("FrameArchive: cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER_SIZE)) {
+        ::close(fd);
+        throw std::runtime_error("FrameArchive: " + path + " is not a frame archive");
+    }
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (preload) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void* base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, flags, fd, 0);
+    const int err = errno;
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("FrameArchive: mmap of " + path + " failed: " + std::strerror(err));
+    }
+    base_ = static_cast<uint8_t*>(base);
+    size_ = static_cast<size_t>(st.st_size);
+
+    const Header* header = reinterpret_cast<const Header*>(base_);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->entry_size != sizeof(FrameArchiveEntry)
+        || header->kind > static_cast<uint32_t>(FrameArchiveKind::BLOBS)
+        || header->index_offset > size_ || header->count > (size_ - header->index_offset) / sizeof(FrameArchiveEntry)) {
+        munmap(base_, size_);
+        throw std::runtime_error("FrameArchive: " + path + " is not a frame archive or was not closed");
+    }
+    kind_ = static_cast<FrameArchiveKind>(header->kind);
+    index_ = reinterpret_cast<const FrameArchiveEntry*>(base_ + header->index_offset);
+    count_ = static_cast<size_t>(header->count);
+    for (size_t i = 0; i < count_; ++i) {
+        const FrameArchiveEntry& e = index_[i];
+        if (e.offset > size_ || e.bytes > size_ - e.offset) {
+            munmap(base_, size_);
+            throw std::runtime_error("FrameArchive: " + path + " is truncated at entry " + std::to_string(i));
+        }
+        // frame() and blob() wrap the payload as rows x cols of `type`: that must be exactly what is stored
+        const bool type_ok = kind_ == FrameArchiveKind::BLOBS ? CV_MAT_DEPTH(e.type) == CV_32F
+                                                              : CV_MAT_DEPTH(e.type) <= CV_64F;
+        if (e.rows <= 0 || e.cols <= 0 || !type_ok || e.type < 0
+            || e.bytes != static_cast<uint64_t>(e.rows) * static_cast<uint64_t>(e.cols) * CV_ELEM_SIZE(e.type)) {
+            munmap(base_, size_);
+            throw std::runtime_error("FrameArchive: " + path + " has an invalid entry " + std::to_string(i) + " ("
+                                     + std::to_string(e.cols) + "x" + std::to_string(e.rows) + ", type "
+                                     + std::to_string(e.type) + ", " + std::to_string(e.bytes) + " bytes)");
+        }
+    }
+    madvise(base_, size_, MADV_SEQUENTIAL);
+}
+
+FrameArchive::~FrameArchive()
+{
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+    }
+}
+
+#else
+
+FrameArchive::FrameArchive(const std::string& path, bool) : path_(path)
+{
+    throw std::runtime_error("NotImplementedError: FrameArchive requires POSIX mmap");
+}
+
+FrameArchive::~FrameArchive() = default;
+
+#endif
+
+
+FrameArchiveKind FrameArchive::getKind() const
+{
+    return kind_;
+}
+
+size_t FrameArchive::size() const
+{
+    return count_;
+}
+
+const FrameArchiveEntry& FrameArchive::entry(size_t i) const
+{
+    if (i >= count_) {
+        throw std::out_of_range("FrameArchive: entry " + std::to_string(i) + " of " + std::to_string(count_));
+    }
+    return index_[i];
+}
+
+cv::Mat FrameArchive::frame(size_t i) const
+{
+    const FrameArchiveEntry& e = entry(i);
+    if (kind_ != FrameArchiveKind::FRAMES) {
+        throw std::logic_error("FrameArchive: " + path_ + " holds blobs, not frames");
+    }
+    return cv::Mat(e.rows, e.cols, e.type, base_ + e.offset);
+}
+
+float* FrameArchive::blob(size_t i) const
+{
+    const FrameArchiveEntry& e = entry(i);
+    if (kind_ != FrameArchiveKind::BLOBS) {
+        throw std::logic_error("FrameArchive: " + path_ + " holds frames, not blobs");
+    }
+    return reinterpret_cast<float*>(base_ + e.offset);
+}
+
+double FrameArchive::getFps() const
+{
+    if (count_ < 2 || index_[count_ - 1].timestamp_ms <= index_[0].timestamp_ms) {
+        return 0.0;
+    }
+    return (count_ - 1) * 1000.0 / (index_[count_ - 1].timestamp_ms - index_[0].timestamp_ms);
+}
+
+const std::string& FrameArchive::getPath() const
+{
+    return path_;
+}
+
+
+ArchiveFrameSource::ArchiveFrameSource(const std::string& path, bool pace, bool loop)
+    : archive_(path), pace_(pace), loop_(loop), started_at_(std::chrono::steady_clock::now())
+{
+    if (archive_.getKind() != FrameArchiveKind::FRAMES) {
+        throw std::invalid_argument("ArchiveFrameSource: " + path + " holds preprocessed blobs, replay it with --replay");
+    }
+}
+
+bool ArchiveFrameSource::read(cv::Mat& frame)
+{
+    if (next_ == archive_.size()) {
+        if (!loop_ || archive_.size() == 0) {
+            return false;
+        }
+        next_ = 0;
+        started_at_ = std::chrono::steady_clock::now();
+    }
+    if (pace_) {
+        const double offset_ms = archive_.entry(next_).timestamp_ms - archive_.entry(0).timestamp_ms;
+        std::this_thread::sleep_until(started_at_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(offset_ms)));
+    }
+    frame = archive_.frame(next_++);
+    return true;
+}
+
+double ArchiveFrameSource::getFps() const
+{
+    return archive_.getFps();
+}
+
+cv::Size ArchiveFrameSource::getFrameSize() const
+{
+    return archive_.size() ? cv::Size(archive_.entry(0).cols, archive_.entry(0).rows) : cv::Size();
+}
+
+bool ArchiveFrameSource::isLive() const
+{
+    return pace_;
+}
+
+const std::string& ArchiveFrameSource::getName() const
+{
+    return archive_.getPath();
+}
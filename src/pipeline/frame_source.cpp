@@ -0,0 +1,65 @@
+#include "pipeline/frame_source.h"
+
+#include "pipeline/frame_archive.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+
+VideoCaptureSource::VideoCaptureSource(const std::string& uri, bool pace_files)
+    : name_(uri) {
+    const bool is_camera = !uri.empty() && std::all_of(uri.begin(), uri.end(),
+        [](unsigned char ch) { return std::isdigit(ch) != 0; });
+    if (is_camera) {
+        capture_.open(std::stoi(uri));
+    }
+    else {
+        capture_.open(uri);
+    }
+    if (!capture_.isOpened()) {
+        throw std::runtime_error("VideoCaptureSource: unable to open video source: " + uri);
+    }
+    is_file_ = !is_camera && std::filesystem::is_regular_file(uri);
+    fps_ = capture_.get(cv::CAP_PROP_FPS);
+    pace_ = pace_files && is_file_ && fps_ > 0.0;
+    frame_size_ = cv::Size(static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_WIDTH)),
+                           static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    next_frame_ = std::chrono::steady_clock::now();
+}
+
+bool VideoCaptureSource::read(cv::Mat& frame) {
+    if (pace_) {
+        std::this_thread::sleep_until(next_frame_);
+        next_frame_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps_));
+    }
+    return capture_.read(frame) && !frame.empty();
+}
+
+double VideoCaptureSource::getFps() const {
+    return fps_;
+}
+
+cv::Size VideoCaptureSource::getFrameSize() const {
+    return frame_size_;
+}
+
+bool VideoCaptureSource::isLive() const {
+    return !is_file_ || pace_;
+}
+
+const std::string& VideoCaptureSource::getName() const {
+    return name_;
+}
+
+
+std::unique_ptr<FrameSource> open_frame_source(const std::string& uri, bool pace_files) {
+    std::string ext = std::filesystem::path(uri).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    if (ext == ".hfa") {
+        return std::make_unique<ArchiveFrameSource>(uri, pace_files);
+    }
+    return std::make_unique<VideoCaptureSource>(uri, pace_files);
+}
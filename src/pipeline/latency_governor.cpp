@@ -0,0 +1,88 @@
+#include "pipeline/latency_governor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+std::string QualityLevel::describe() const {
+    std::string text = with_masks ? "masks" : "boxes";
+    if (scale != 1.0) {
+        text += " @" + std::to_string(static_cast<int>(scale * 100.0 + 0.5)) + "%";
+    }
+    return text;
+}
+
+
+LatencyGovernor::LatencyGovernor(const std::vector<QualityLevel>& levels, const LatencyGovernorConfig& config)
+    : levels_(levels), config_(config) {
+    if (levels_.empty()) {
+        throw std::invalid_argument("LatencyGovernor: the quality ladder must have at least one level");
+    }
+    stats_.frames_per_level.assign(levels_.size(), 0);
+}
+
+std::vector<QualityLevel> LatencyGovernor::makeLadder(bool has_masks, bool dynamic_input) {
+    std::vector<QualityLevel> ladder{ QualityLevel{ has_masks, 1.0 } };
+    if (has_masks) {
+        ladder.push_back(QualityLevel{ false, 1.0 });
+    }
+    if (dynamic_input) {
+        ladder.push_back(QualityLevel{ false, 0.75 });
+        ladder.push_back(QualityLevel{ false, 0.5 });
+    }
+    return ladder;
+}
+
+bool LatencyGovernor::admit(clock::time_point captured_at) {
+    if (clock::now() - captured_at > config_.budget) {
+        ++stats_.dropped_stale;
+        return false;
+    }
+    return true;
+}
+
+void LatencyGovernor::record(clock::time_point captured_at, clock::time_point done_at) {
+    const double latency_ms = std::chrono::duration<double, std::milli>(done_at - captured_at).count();
+    const double budget_ms = static_cast<double>(config_.budget.count());
+
+    ++stats_.processed;
+    ++stats_.frames_per_level[level_];
+    total_latency_ms_ += latency_ms;
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency_ms);
+    if (latency_ms > budget_ms) {
+        ++stats_.over_budget;
+    }
+
+    ewma_ms_ = ewma_ms_ < 0.0 ? latency_ms : config_.smoothing * latency_ms + (1.0 - config_.smoothing) * ewma_ms_;
+    if (ewma_ms_ > budget_ms) {
+        calm_frames_ = 0;
+        if (level_ + 1 < levels_.size()) {
+            ++level_;
+            ewma_ms_ = -1.0;  // the next level has its own cost, start measuring afresh
+        }
+    }
+    else if (ewma_ms_ < config_.recover_ratio * budget_ms) {
+        if (++calm_frames_ >= config_.recover_frames && level_ > 0) {
+            --level_;
+            calm_frames_ = 0;
+            ewma_ms_ = -1.0;
+        }
+    }
+    else {
+        calm_frames_ = 0;
+    }
+}
+
+const QualityLevel& LatencyGovernor::level() const {
+    return levels_[level_];
+}
+
+size_t LatencyGovernor::levelIndex() const {
+    return level_;
+}
+
+LatencyGovernorStats LatencyGovernor::getStats() const {
+    LatencyGovernorStats stats = stats_;
+    stats.mean_latency_ms = stats.processed ? total_latency_ms_ / static_cast<double>(stats.processed) : 0.0;
+    return stats;
+}
@@ -0,0 +1,139 @@
+#include "pipeline/latest_frame_grabber.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+
+
+LatestFrameGrabber::LatestFrameGrabber(const std::string& source, bool pace_files) {
+    std::string ext = std::filesystem::path(source).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    if (ext == ".hfa") {
+        archive_ = open_frame_source(source, pace_files);  // paces itself
+        is_file_ = true;
+        fps_ = archive_->getFps();
+        frame_size_ = archive_->getFrameSize();
+        thread_ = std::thread(&LatestFrameGrabber::run, this);
+        return;
+    }
+    const bool is_camera = !source.empty() && std::all_of(source.begin(), source.end(),
+        [](unsigned char ch) { return std::isdigit(ch) != 0; });
+    if (is_camera) {
+        capture_.open(std::stoi(source));
+    }
+    else {
+        capture_.open(source);
+    }
+    if (!capture_.isOpened()) {
+        throw std::runtime_error("LatestFrameGrabber: unable to open video source: " + source);
+    }
+    is_file_ = !is_camera && std::filesystem::is_regular_file(source);
+    fps_ = capture_.get(cv::CAP_PROP_FPS);
+    pace_ = pace_files && is_file_ && fps_ > 0.0;
+    frame_size_ = cv::Size(static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_WIDTH)),
+                           static_cast<int>(capture_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    if (!is_file_) {
+        // don't let the driver/backend queue up frames on our behalf either
+        capture_.set(cv::CAP_PROP_BUFFERSIZE, 1);
+    }
+    thread_ = std::thread(&LatestFrameGrabber::run, this);
+}
+
+LatestFrameGrabber::~LatestFrameGrabber() {
+    stop();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    capture_.release();
+}
+
+void LatestFrameGrabber::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+}
+
+double LatestFrameGrabber::getFps() const {
+    return fps_;
+}
+
+cv::Size LatestFrameGrabber::getFrameSize() const {
+    return frame_size_;
+}
+
+LatestFrameGrabberStats LatestFrameGrabber::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LatestFrameGrabberStats stats = stats_;
+    stats.skipped = stats.grabbed - stats.retrieved;
+    return stats;
+}
+
+bool LatestFrameGrabber::next(GrabbedFrame& frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!ready_) {
+        waiting_ = true;
+        cv_.wait(lock, [this] { return ready_ || finished_ || stopping_; });
+        waiting_ = false;
+    }
+    if (!ready_) {
+        return false;
+    }
+    frame = std::move(pending_);
+    pending_ = GrabbedFrame();
+    ready_ = false;
+    return true;
+}
+
+void LatestFrameGrabber::run() {
+    using clock = std::chrono::steady_clock;
+    const auto frame_interval = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(pace_ ? 1.0 / fps_ : 0.0));
+    auto next_grab = clock::now();
+    uint64_t index = 0;
+
+    while (true) {
+        if (pace_) {
+            std::this_thread::sleep_until(next_grab);
+            next_grab += frame_interval;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                break;
+            }
+        }
+        // grab() blocks until the camera delivers (a paced archive read sleeps), so it runs without holding the lock
+        cv::Mat image;
+        const bool grabbed = archive_ ? archive_->read(image) : capture_.grab();
+        const auto captured_at = clock::now();
+        ++index;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!grabbed) {
+            break;
+        }
+        ++stats_.grabbed;
+        if (!waiting_ || ready_) {
+            continue;  // nobody is waiting: skip this frame without decoding its pixels
+        }
+        if (!archive_ && (!capture_.retrieve(image) || image.empty())) {
+            continue;
+        }
+        pending_.image = std::move(image);
+        pending_.index = index;
+        pending_.captured_at = captured_at;
+        ready_ = true;
+        ++stats_.retrieved;
+        lock.unlock();
+        cv_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    cv_.notify_all();
+}
@@ -0,0 +1,221 @@
+#include "pipeline/model_cascade.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+    // the threshold predict_batch would have applied to this class with the caller's params
+    float class_threshold(const PredictParams& params, int class_id) {
+        for (size_t i = 0; i < params.classes.size(); ++i) {
+            if (params.classes[i] == class_id) {
+                return i < params.class_conf.size() && params.class_conf[i] > 0.0f ? params.class_conf[i] : params.conf;
+            }
+        }
+        return params.conf;
+    }
+
+    PredictParams lowered(const PredictParams& params, float band) {
+        PredictParams p = params;
+        p.conf = std::max(0.0f, p.conf - band);
+        for (float& conf : p.class_conf) {
+            if (conf > 0.0f) {
+                conf = std::max(std::numeric_limits<float>::min(), conf - band);  // 0 would mean "use conf"
+            }
+        }
+        return p;
+    }
+
+    float box_iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b) {
+        const float inter = (a & b).area();
+        const float uni = a.area() + b.area() - inter;
+        return uni > 0.0f ? inter / uni : 0.0f;
+    }
+
+    // padded boxes, overlapping ones merged so that no object is sent twice
+    std::vector<cv::Rect> build_regions(const std::vector<const YoloResults*>& boxes, float padding, const cv::Size& size) {
+        const cv::Rect bounds(0, 0, size.width, size.height);
+        std::vector<cv::Rect> regions;
+        for (const YoloResults* box : boxes) {
+            const float pad_x = box->bbox.width * padding;
+            const float pad_y = box->bbox.height * padding;
+            const cv::Rect region = cv::Rect(cv::Rect_<float>(box->bbox.x - pad_x, box->bbox.y - pad_y,
+                                                              box->bbox.width + 2 * pad_x, box->bbox.height + 2 * pad_y)) & bounds;
+            if (!region.empty()) {
+                regions.push_back(region);
+            }
+        }
+        for (bool merged = true; merged;) {
+            merged = false;
+            for (size_t a = 0; a < regions.size() && !merged; ++a) {
+                for (size_t b = a + 1; b < regions.size(); ++b) {
+                    if ((regions[a] & regions[b]).area() > 0) {
+                        regions[a] |= regions[b];
+                        regions.erase(regions.begin() + b);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return regions;
+    }
+}
+
+
+ModelCascade::ModelCascade(AutoBackendOnnx& small, AutoBackendOnnx& large, const ModelCascadeConfig& config)
+    : small_(small), large_(large), config_(config) {
+    if (small_.getNc() != large_.getNc()) {
+        throw std::invalid_argument("ModelCascade: both models must have the same classes, got " + std::to_string(small_.getNc())
+                                    + " and " + std::to_string(large_.getNc()));
+    }
+    if (small_.getTask() == YoloTasks::CLASSIFY || large_.getTask() == YoloTasks::CLASSIFY) {
+        throw std::invalid_argument("ModelCascade: classify models have no boxes to escalate, use CropCascade");
+    }
+    if (config_.band < 0.0f) {
+        throw std::invalid_argument("ModelCascade: band must not be negative");
+    }
+}
+
+std::vector<YoloResults> ModelCascade::predict(const cv::Mat& image, const PredictParams& params) {
+    return std::move(predict_batch({ image }, { params })[0]);
+}
+
+std::vector<std::vector<YoloResults>> ModelCascade::predict_batch(const std::vector<cv::Mat>& images,
+                                                                  const std::vector<PredictParams>& params) {
+    if (params.size() != 1 && params.size() != images.size()) {
+        throw std::invalid_argument("ModelCascade: expected one PredictParams per image or a single one for all");
+    }
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+    std::vector<PredictParams> small_params;
+    small_params.reserve(params.size());
+    for (const PredictParams& p : params) {
+        small_params.push_back(lowered(p, config_.band));
+    }
+    std::vector<std::vector<YoloResults>> first = small_.predict_batch(images, small_params);
+    const clock::time_point small_done = clock::now();
+    stats_.small_ms += std::chrono::duration<double, std::milli>(small_done - start).count();
+    stats_.frames += images.size();
+
+    // per image: no escalation, the whole frame, or a few regions of it
+    struct Crop {
+        size_t image;
+        cv::Point offset;
+    };
+    std::vector<Crop> crops;
+    std::vector<cv::Mat> crop_images;
+    std::vector<PredictParams> crop_params;
+    std::vector<bool> escalated(images.size(), false);
+    std::vector<std::vector<YoloResults>> results(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        const PredictParams& p = params.size() == 1 ? params[0] : params[i];
+        std::vector<const YoloResults*> ambiguous;
+        int64_t count = 0;
+        for (const YoloResults& result : first[i]) {
+            const float threshold = class_threshold(p, result.class_idx);
+            if (result.conf < threshold + config_.band) {
+                ambiguous.push_back(&result);  // the small model only reports boxes above threshold - band
+            }
+            if (result.conf > threshold) {
+                ++count;
+            }
+        }
+        const bool jump = config_.count_jump > 0 && previous_count_ >= 0 && std::llabs(count - previous_count_) >= config_.count_jump;
+        const bool unsure = !ambiguous.empty() && ambiguous.size() >= config_.min_ambiguous;
+        if (!jump && !unsure) {
+            for (YoloResults& result : first[i]) {
+                if (result.conf > class_threshold(p, result.class_idx)) {
+                    results[i].push_back(std::move(result));
+                }
+            }
+            previous_count_ = static_cast<int64_t>(results[i].size());
+            continue;
+        }
+
+        escalated[i] = true;
+        ++stats_.escalated;
+        stats_.count_jumps += (jump && !unsure) ? 1 : 0;
+        std::vector<cv::Rect> regions;
+        if (config_.regions && !jump) {
+            regions = build_regions(ambiguous, config_.region_padding, images[i].size());
+            double area = 0.0;
+            for (const cv::Rect& region : regions) {
+                area += region.area();
+            }
+            if (area > config_.max_region_area * images[i].total()) {
+                regions.clear();  // most of the frame anyway
+            }
+        }
+        if (regions.empty()) {
+            crops.push_back(Crop{ i, cv::Point() });
+            crop_images.push_back(images[i]);
+            crop_params.push_back(p);
+        }
+        else {
+            ++stats_.escalated_regions;
+            stats_.regions += regions.size();
+            for (const cv::Rect& region : regions) {
+                crops.push_back(Crop{ i, region.tl() });
+                crop_images.push_back(images[i](region));  // a view; only a color conversion copies it before the resize into the blob
+                crop_params.push_back(p);
+            }
+        }
+        // the final count of this frame is only known after the large model ran, later frames of this call
+        // compare against the last frame that wasn't escalated
+    }
+    if (crops.empty()) {
+        return results;
+    }
+
+    std::vector<std::vector<YoloResults>> second = large_.predict_batch(crop_images, crop_params);
+    for (size_t k = 0; k < crops.size(); ++k) {
+        std::vector<YoloResults>& target = results[crops[k].image];
+        for (YoloResults& result : second[k]) {
+            // crop coordinates -> image coordinates; masks are relative to their box and need no shift
+            result.bbox.x += static_cast<float>(crops[k].offset.x);
+            result.bbox.y += static_cast<float>(crops[k].offset.y);
+            for (size_t v = 0; v + 1 < result.keypoints.size(); v += 3) {
+                result.keypoints[v] += static_cast<float>(crops[k].offset.x);
+                result.keypoints[v + 1] += static_cast<float>(crops[k].offset.y);
+            }
+            target.push_back(std::move(result));
+        }
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (!escalated[i]) {
+            continue;
+        }
+        const PredictParams& p = params.size() == 1 ? params[0] : params[i];
+        // the large model decides on everything ambiguous; confident small-model boxes it didn't find are kept
+        const size_t large_count = results[i].size();
+        for (YoloResults& result : first[i]) {
+            if (result.conf < class_threshold(p, result.class_idx) + config_.band) {
+                continue;
+            }
+            bool duplicate = false;
+            for (size_t j = 0; j < large_count && !duplicate; ++j) {
+                duplicate = results[i][j].class_idx == result.class_idx && box_iou(results[i][j].bbox, result.bbox) >= p.iou;
+            }
+            if (!duplicate) {
+                results[i].push_back(std::move(result));
+            }
+        }
+    }
+    // the count of the last frame is the reference for the next call
+    previous_count_ = static_cast<int64_t>(results.back().size());
+    stats_.large_ms += std::chrono::duration<double, std::milli>(clock::now() - small_done).count();
+    return results;
+}
+
+void ModelCascade::reset() {
+    previous_count_ = -1;
+}
+
+ModelCascadeStats ModelCascade::getStats() const {
+    return stats_;
+}
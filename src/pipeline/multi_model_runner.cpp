@@ -0,0 +1,115 @@
+#include "pipeline/multi_model_runner.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+
+
+namespace {
+    std::string describe_size(const cv::Size& size) {
+        return std::to_string(size.width) + "x" + std::to_string(size.height);
+    }
+
+    void check_compatible(AutoBackendOnnx& first, AutoBackendOnnx& other) {
+        const std::string pair = std::string(first.getModelPath()) + " and " + other.getModelPath();
+        auto fail = [&pair](const std::string& what) {
+            throw std::invalid_argument("MultiModelRunner: " + pair + " can't share an input blob: " + what);
+        };
+        if (first.getCh() != other.getCh()) {
+            fail("different channel counts");
+        }
+        if (first.getCvSize() != other.getCvSize()) {
+            fail("imgsz " + describe_size(first.getCvSize()) + " vs " + describe_size(other.getCvSize()));
+        }
+        if (first.getStride() != other.getStride()) {
+            fail("stride " + std::to_string(first.getStride()) + " vs " + std::to_string(other.getStride()));
+        }
+        if (first.hasDynamicInputSize() != other.hasDynamicInputSize()) {
+            fail("only one of them has a dynamic input size");
+        }
+        if (first.getMaxBatch() != other.getMaxBatch()) {
+            fail("batch dimension " + std::to_string(first.getMaxBatch()) + " vs " + std::to_string(other.getMaxBatch()));
+        }
+        if ((first.getTask() == YoloTasks::CLASSIFY) != (other.getTask() == YoloTasks::CLASSIFY)) {
+            fail("classifiers are center-cropped, the other tasks letterboxed");
+        }
+    }
+}
+
+
+MultiModelRunner::MultiModelRunner(const std::vector<AutoBackendOnnx*>& models, const MultiModelRunnerConfig& config)
+    : models_(models), config_(config) {
+    if (models_.empty()) {
+        throw std::invalid_argument("MultiModelRunner: at least one model is required");
+    }
+    for (size_t i = 1; i < models_.size(); ++i) {
+        check_compatible(*models_[0], *models_[i]);
+    }
+    stats_.model_ms.assign(models_.size(), 0.0);
+    if (config_.concurrent && models_.size() > 1) {
+        dispatch_ = std::make_unique<ThreadPool>(models_.size() - 1);
+    }
+}
+
+std::vector<std::vector<YoloResults>> MultiModelRunner::predict(const cv::Mat& image, const std::vector<PredictParams>& params) {
+    std::vector<std::vector<std::vector<YoloResults>>> batch = predict_batch({ image }, params);
+    std::vector<std::vector<YoloResults>> results;
+    results.reserve(batch.size());
+    for (std::vector<std::vector<YoloResults>>& per_model : batch) {
+        results.push_back(std::move(per_model[0]));
+    }
+    return results;
+}
+
+std::vector<std::vector<std::vector<YoloResults>>> MultiModelRunner::predict_batch(const std::vector<cv::Mat>& images,
+                                                                                   const std::vector<PredictParams>& params) {
+    if (params.size() != models_.size()) {
+        throw std::invalid_argument("MultiModelRunner: expected one PredictParams per model, got " + std::to_string(params.size())
+                                    + " for " + std::to_string(models_.size()) + " models");
+    }
+    for (const PredictParams& p : params) {
+        if (p.conversionCode != params[0].conversionCode || p.imgsz != params[0].imgsz) {
+            throw std::invalid_argument("MultiModelRunner: all models must use the same conversionCode and imgsz");
+        }
+    }
+    using clock = std::chrono::steady_clock;
+    std::vector<std::vector<std::vector<YoloResults>>> results(models_.size(), std::vector<std::vector<YoloResults>>(images.size()));
+    if (images.empty()) {
+        return results;
+    }
+
+    const int64_t max_batch = models_[0]->getMaxBatch();
+    const size_t chunk_size = max_batch > 0 ? static_cast<size_t>(max_batch) : images.size();
+    for (size_t begin = 0; begin < images.size(); begin += chunk_size) {
+        const size_t end = std::min(images.size(), begin + chunk_size);
+        const clock::time_point start = clock::now();
+        int64_t batch_size = 0;
+        const cv::Size new_shape = models_[0]->fill_batch(images, begin, end, { params[0] }, blob_, batch_size);
+        stats_.preprocess_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        auto run_models = [&](size_t first, size_t last) {
+            for (size_t m = first; m < last; ++m) {
+                const clock::time_point model_start = clock::now();
+                models_[m]->infer_batch(blob_, batch_size, new_shape, images, begin, end, { params[m] }, results[m]);
+                stats_.model_ms[m] += std::chrono::duration<double, std::milli>(clock::now() - model_start).count();
+            }
+        };
+        if (dispatch_) {
+            dispatch_->parallel_for(models_.size(), run_models);
+        }
+        else {
+            run_models(0, models_.size());
+        }
+    }
+    stats_.images += images.size();
+    return results;
+}
+
+const std::vector<AutoBackendOnnx*>& MultiModelRunner::getModels() const {
+    return models_;
+}
+
+MultiModelRunnerStats MultiModelRunner::getStats() const {
+    return stats_;
+}
@@ -0,0 +1,338 @@
+#include "pipeline/multi_stream_engine.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "pipeline/result_cache.h"
+#include "utils/affinity.h"
+#include "utils/memory.h"
+
+
+MultiStreamEngine::MultiStreamEngine(const std::vector<AutoBackendOnnx*>& sessions, const MultiStreamEngineConfig& config,
+                                     ResultCallback callback)
+    : sessions_(sessions), config_(config), callback_(std::move(callback)) {
+    if (sessions_.empty()) {
+        throw std::invalid_argument("MultiStreamEngine: at least one session is required");
+    }
+    if (config_.max_batch < 1) {
+        throw std::invalid_argument("MultiStreamEngine: max_batch must be >= 1, got " + std::to_string(config_.max_batch));
+    }
+    if ((!config_.session_nodes.empty() && config_.session_nodes.size() != sessions_.size())
+        || (!config_.session_cpus.empty() && config_.session_cpus.size() != sessions_.size())) {
+        throw std::invalid_argument("MultiStreamEngine: session_nodes/session_cpus must have one entry per session");
+    }
+}
+
+MultiStreamEngine::~MultiStreamEngine() {
+    stop();
+}
+
+size_t MultiStreamEngine::addStream(std::unique_ptr<FrameSource> source, StreamConfig config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_) {
+        throw std::runtime_error("MultiStreamEngine: addStream() after start()");
+    }
+    auto stream = std::make_unique<Stream>();
+    if (config.name.empty()) {
+        config.name = source->getName();
+    }
+    config.priority = std::max(1, config.priority);
+    if (config.node >= 0 && !config_.session_nodes.empty()
+        && std::find(config_.session_nodes.begin(), config_.session_nodes.end(), config.node) == config_.session_nodes.end()) {
+        throw std::invalid_argument("MultiStreamEngine: no session on NUMA node " + std::to_string(config.node) + " for " + config.name);
+    }
+    stream->stats.name = config.name;
+    stream->source = std::move(source);
+    stream->config = std::move(config);
+    streams_.push_back(std::move(stream));
+    return streams_.size() - 1;
+}
+
+void MultiStreamEngine::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        started_at_ = std::chrono::steady_clock::now();
+    }
+    for (size_t i = 0; i < streams_.size(); ++i) {
+        streams_[i]->reader = std::thread(&MultiStreamEngine::readLoop, this, i);
+    }
+    for (size_t i = 0; i < sessions_.size(); ++i) {
+        workers_.emplace_back(&MultiStreamEngine::workLoop, this, i);
+    }
+}
+
+void MultiStreamEngine::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return stopping_ || allDone(); });
+}
+
+bool MultiStreamEngine::waitFor(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return done_cv_.wait_for(lock, timeout, [this] { return stopping_ || allDone(); });
+}
+
+void MultiStreamEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    slot_cv_.notify_all();
+    done_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    // a reader blocked inside FrameSource::read() finishes that read before it sees stopping_
+    for (std::unique_ptr<Stream>& stream : streams_) {
+        if (stream->reader.joinable()) {
+            stream->reader.join();
+        }
+    }
+}
+
+std::vector<StreamStats> MultiStreamEngine::getStreamStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double elapsed = started_ ? std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at_).count() : 0.0;
+    std::vector<StreamStats> stats;
+    stats.reserve(streams_.size());
+    for (const std::unique_ptr<Stream>& stream : streams_) {
+        StreamStats s = stream->stats;
+        s.finished = stream->finished;
+        s.mean_latency_ms = s.processed ? stream->total_latency_ms / static_cast<double>(s.processed) : 0.0;
+        s.fps = elapsed > 0.0 ? static_cast<double>(s.processed) / elapsed : 0.0;
+        stats.push_back(std::move(s));
+    }
+    return stats;
+}
+
+MultiStreamEngineStats MultiStreamEngine::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool MultiStreamEngine::isReady(const Stream& stream, int node) const {
+    return stream.has_frame && !stream.in_flight && (node < 0 || stream.config.node < 0 || stream.config.node == node);
+}
+
+bool MultiStreamEngine::allDone() const {
+    for (const std::unique_ptr<Stream>& stream : streams_) {
+        if (!stream->finished || stream->has_frame || stream->in_flight) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MultiStreamEngine::readLoop(size_t index) {
+    using clock = std::chrono::steady_clock;
+    Stream& stream = *streams_[index];
+    if (stream.config.node >= 0 && !config_.session_cpus.empty()) {
+        // decode next to the sessions that will read the frame
+        for (size_t i = 0; i < config_.session_nodes.size(); ++i) {
+            if (config_.session_nodes[i] == stream.config.node) {
+                pin_current_thread(config_.session_cpus[i]);
+                break;
+            }
+        }
+    }
+    const double source_fps = stream.source->getFps();
+    const clock::duration interval = stream.config.max_fps > 0.0
+        ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / stream.config.max_fps))
+        : clock::duration::zero();
+    // tolerate half a source frame of jitter, otherwise e.g. 30 -> 10 fps capping would fall to 7.5 fps
+    const clock::duration slack = source_fps > 0.0
+        ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(0.5 / source_fps))
+        : clock::duration::zero();
+    clock::time_point next_allowed = clock::now();
+    uint64_t frame_index = 0;
+
+    while (true) {
+        cv::Mat image;  // fresh buffer every time: the previous one may still be in a batch
+        const bool ok = stream.source->read(image);
+        const clock::time_point now = clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!ok || stopping_) {
+            break;
+        }
+        ++stream.stats.read;
+        ++frame_index;
+        if (interval != clock::duration::zero()) {
+            if (now + slack < next_allowed) {
+                ++stream.stats.capped;
+                continue;
+            }
+            next_allowed = std::max(next_allowed + interval, now + interval - slack);
+        }
+
+        if (stream.config.lossless) {
+            slot_cv_.wait(lock, [this, &stream] { return stopping_ || !stream.has_frame; });
+            if (stopping_) {
+                break;
+            }
+        }
+        if (stream.has_frame) {
+            ++stream.stats.replaced;
+        }
+        else if (!stream.in_flight) {
+            // coming back from idle: start at the current virtual time instead of cashing in the idle period
+            stream.pass = std::max(stream.pass, virtual_time_);
+        }
+        stream.pending.stream = index;
+        stream.pending.index = frame_index;
+        stream.pending.image = std::move(image);
+        stream.pending.read_at = now;
+        stream.has_frame = true;
+        lock.unlock();
+        if (config_.session_nodes.empty()) {
+            work_cv_.notify_one();
+        }
+        else {
+            work_cv_.notify_all();  // only workers on the stream's node may take it
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stream.finished = true;
+    }
+    work_cv_.notify_all();
+    done_cv_.notify_all();
+}
+
+void MultiStreamEngine::workLoop(size_t session_index) {
+    AutoBackendOnnx* session = sessions_[session_index];
+    const int node = config_.session_nodes.empty() ? -1 : config_.session_nodes[session_index];
+    if (!config_.session_cpus.empty()) {
+        pin_current_thread(config_.session_cpus[session_index]);
+    }
+    const size_t max_batch = static_cast<size_t>(config_.max_batch);
+    std::vector<Stream*> candidates;
+    std::vector<StreamFrame> frames;
+    std::vector<cv::Mat> images;
+    std::vector<PredictParams> params;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready_count = [this, node]() {
+                return static_cast<size_t>(std::count_if(streams_.begin(), streams_.end(),
+                    [this, node](const std::unique_ptr<Stream>& stream) { return isReady(*stream, node); }));
+            };
+            work_cv_.wait(lock, [&] { return stopping_ || allDone() || ready_count() > 0; });
+            if (stopping_ || (allDone() && ready_count() == 0)) {
+                break;
+            }
+
+            // let the batch fill up, but never hold the oldest ready frame longer than max_delay
+            std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::max();
+            for (const std::unique_ptr<Stream>& stream : streams_) {
+                if (isReady(*stream, node)) {
+                    oldest = std::min(oldest, stream->pending.read_at);
+                }
+            }
+            // streams that could still join this batch (routed here, not already in flight elsewhere, not exhausted)
+            auto joinable_count = [this, node]() {
+                return static_cast<size_t>(std::count_if(streams_.begin(), streams_.end(),
+                    [this, node](const std::unique_ptr<Stream>& stream) {
+                        return isReady(*stream, node) || (!stream->finished && !stream->in_flight
+                            && (node < 0 || stream->config.node < 0 || stream->config.node == node));
+                    }));
+            };
+            work_cv_.wait_until(lock, oldest + config_.max_delay, [&] {
+                const size_t ready = ready_count();
+                return stopping_ || ready >= max_batch || ready >= joinable_count();
+            });
+            if (stopping_) {
+                break;
+            }
+
+            // least weighted service first; ties go to the higher priority
+            candidates.clear();
+            for (std::unique_ptr<Stream>& stream : streams_) {
+                if (isReady(*stream, node)) {
+                    candidates.push_back(stream.get());
+                }
+            }
+            if (candidates.empty()) {
+                continue;  // another worker took them
+            }
+            const size_t n = std::min(candidates.size(), max_batch);
+            std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(), [](const Stream* a, const Stream* b) {
+                return a->pass != b->pass ? a->pass < b->pass : a->config.priority > b->config.priority;
+            });
+
+            frames.clear();
+            images.clear();
+            params.clear();
+            virtual_time_ = std::max(virtual_time_, candidates.front()->pass);
+            for (size_t i = 0; i < n; ++i) {
+                Stream& stream = *candidates[i];
+                frames.push_back(std::move(stream.pending));
+                stream.pending = StreamFrame();
+                stream.has_frame = false;
+                stream.in_flight = true;
+                stream.pass += 1.0 / stream.config.priority;
+                images.push_back(frames.back().image);
+                params.push_back(stream.config.params);
+            }
+        }
+        slot_cv_.notify_all();
+
+        std::vector<std::vector<YoloResults>> results;
+        bool failed = false;
+        try {
+            results = config_.result_cache ? config_.result_cache->predict_batch(*session, images, params)
+                                           : session->predict_batch(images, params);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: MultiStreamEngine batch of " << frames.size() << " frames failed: " << e.what() << std::endl;
+            failed = true;
+        }
+        if (!failed && callback_) {
+            for (size_t i = 0; i < frames.size(); ++i) {
+                try {
+                    callback_(frames[i], results[i]);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Error: MultiStreamEngine result callback threw: " << e.what() << std::endl;
+                }
+            }
+        }
+
+        const std::chrono::steady_clock::time_point done_at = std::chrono::steady_clock::now();
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.batches;
+            stats_.frames += frames.size();
+            for (const StreamFrame& frame : frames) {
+                Stream& stream = *streams_[frame.stream];
+                stream.in_flight = false;
+                if (failed) {
+                    ++stream.stats.failed;
+                    continue;
+                }
+                const double latency_ms = std::chrono::duration<double, std::milli>(done_at - frame.read_at).count();
+                ++stream.stats.processed;
+                stream.total_latency_ms += latency_ms;
+                stream.stats.max_latency_ms = std::max(stream.stats.max_latency_ms, latency_ms);
+            }
+            idle = std::none_of(streams_.begin(), streams_.end(),
+                [this, node](const std::unique_ptr<Stream>& stream) { return isReady(*stream, node); });
+        }
+        work_cv_.notify_all();
+        done_cv_.notify_all();
+        if (idle && session->isLowMemory()) {
+            release_free_memory_after_burst();
+        }
+    }
+    work_cv_.notify_all();
+}
@@ -0,0 +1,144 @@
+#include "pipeline/raw_frame_source.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <opencv2/imgproc.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+RawPixelFormat parse_raw_pixel_format(const std::string& name) {
+    if (name == "bgr24") {
+        return RawPixelFormat::BGR24;
+    }
+    if (name == "nv12") {
+        return RawPixelFormat::NV12;
+    }
+    throw std::invalid_argument("Unsupported raw pixel format '" + name + "' (expected bgr24 or nv12)");
+}
+
+
+RawFrameSource::RawFrameSource(const std::string& path, cv::Size size, RawPixelFormat format, double fps)
+    : name_(path == "-" ? "stdin" : path), size_(size), format_(format), fps_(fps)
+{
+    if (size.width <= 0 || size.height <= 0) {
+        throw std::invalid_argument("RawFrameSource: frame size must be positive");
+    }
+    if (format == RawPixelFormat::NV12) {
+        if (size.width % 2 != 0 || size.height % 2 != 0) {
+            throw std::invalid_argument("RawFrameSource: NV12 frames need an even width and height");
+        }
+        nv12_.create(size.height * 3 / 2, size.width, CV_8UC1);
+        frame_bytes_ = nv12_.total();
+    }
+    else {
+        frame_bytes_ = static_cast<size_t>(size.width) * size.height * 3;
+    }
+#ifndef _WIN32
+    if (path == "-") {
+        fd_ = STDIN_FILENO;
+    }
+    else {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error("RawFrameSource: cannot open " + path + ": " + std::strerror(errno));
+        }
+        owns_fd_ = true;
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);  // no-op on pipes
+#endif
+    }
+#ifdef F_SETPIPE_SZ
+    // the default 64 KiB pipe holds a sliver of a frame: the writer stalls on every frame while we run inference.
+    // Room for a whole frame lets it keep going; capped by /proc/sys/fs/pipe-max-size, so failures are fine
+    const int pipe_size = ::fcntl(fd_, F_GETPIPE_SZ);  // -1 if not a pipe
+    if (pipe_size >= 0 && static_cast<size_t>(pipe_size) < frame_bytes_) {
+        ::fcntl(fd_, F_SETPIPE_SZ, static_cast<int>(std::min<size_t>(frame_bytes_, 1u << 30)));
+    }
+#endif
+#else
+    throw std::runtime_error("NotImplementedError: RawFrameSource requires POSIX file descriptors");
+#endif
+}
+
+RawFrameSource::~RawFrameSource()
+{
+#ifndef _WIN32
+    if (owns_fd_) {
+        ::close(fd_);
+    }
+#endif
+}
+
+size_t RawFrameSource::readFully(uint8_t* data, size_t size)
+{
+    size_t done = 0;
+#ifndef _WIN32
+    while (done < size) {
+        const ssize_t n = ::read(fd_, data + done, size - done);
+        if (n > 0) {
+            done += static_cast<size_t>(n);
+        }
+        else if (n == 0) {
+            break;
+        }
+        else if (errno != EINTR) {
+            throw std::runtime_error("RawFrameSource: read from " + name_ + " failed: " + std::strerror(errno));
+        }
+    }
+#endif
+    return done;
+}
+
+bool RawFrameSource::read(cv::Mat& frame)
+{
+    uint8_t* target;
+    if (format_ == RawPixelFormat::BGR24) {
+        frame.create(size_, CV_8UC3);  // no-op when the caller reuses its Mat
+        if (!frame.isContinuous()) {
+            frame = cv::Mat(size_, CV_8UC3);
+        }
+        target = frame.data;
+    }
+    else {
+        target = nv12_.data;
+    }
+    const size_t got = readFully(target, frame_bytes_);
+    if (got < frame_bytes_) {
+        if (got > 0) {
+            std::cerr << "Warning: " << name_ << " ended in the middle of a frame (" << got << " of " << frame_bytes_
+                      << " bytes), dropping it" << std::endl;
+        }
+        return false;
+    }
+    if (format_ == RawPixelFormat::NV12) {
+        cv::cvtColor(nv12_, frame, cv::COLOR_YUV2BGR_NV12);
+    }
+    return true;
+}
+
+double RawFrameSource::getFps() const
+{
+    return fps_;
+}
+
+cv::Size RawFrameSource::getFrameSize() const
+{
+    return size_;
+}
+
+bool RawFrameSource::isLive() const
+{
+    return true;
+}
+
+const std::string& RawFrameSource::getName() const
+{
+    return name_;
+}
@@ -0,0 +1,119 @@
+#include "pipeline/resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+ResolutionController::ResolutionController(AutoBackendOnnx& model, const ResolutionControllerConfig& config)
+    : config_(config) {
+    if (!model.hasDynamicInputSize()) {
+        throw std::invalid_argument("ResolutionController: " + std::string(model.getModelPath())
+                                    + " has a fixed input size, export it with dynamic=True");
+    }
+    if (config_.sizes.empty()) {
+        throw std::invalid_argument("ResolutionController: at least one candidate size is required");
+    }
+    stride_ = model.getStride() > 0 ? model.getStride() : 32;
+    for (int& size : config_.sizes) {
+        size = std::max(stride_, (size + stride_ - 1) / stride_ * stride_);
+    }
+    std::sort(config_.sizes.begin(), config_.sizes.end());
+    config_.sizes.erase(std::unique(config_.sizes.begin(), config_.sizes.end()), config_.sizes.end());
+    current_ = config_.sizes.size() - 1;  // nothing is known about the objects yet
+    ewma_ms_.assign(config_.sizes.size(), -1.0);
+    stats_.frames_per_size.assign(config_.sizes.size(), 0);
+}
+
+size_t ResolutionController::latencyCap() const {
+    if (config_.target_ms <= 0.0) {
+        return config_.sizes.size() - 1;
+    }
+    size_t cap = 0;
+    for (size_t i = 0; i < config_.sizes.size(); ++i) {
+        double estimate = ewma_ms_[i];
+        if (estimate < 0.0) {
+            // not measured yet: scale the closest measured size by the pixel count
+            for (size_t d = 1; d < config_.sizes.size() && estimate < 0.0; ++d) {
+                for (size_t j : { i - d, i + d }) {
+                    if (j < config_.sizes.size() && ewma_ms_[j] >= 0.0) {
+                        const double ratio = static_cast<double>(config_.sizes[i]) / config_.sizes[j];
+                        estimate = ewma_ms_[j] * ratio * ratio;
+                        break;
+                    }
+                }
+            }
+        }
+        if (estimate < 0.0 || estimate <= config_.target_ms) {
+            cap = i;
+        }
+    }
+    return cap;
+}
+
+cv::Size ResolutionController::next(const cv::Size& frame_size) {
+    const size_t cap = latencyCap();
+    const bool probe = config_.probe_interval > 0 && stats_.frames > 0
+                       && stats_.frames % static_cast<uint64_t>(config_.probe_interval) == 0;
+    last_ = probe ? cap : std::min(current_, cap);
+    stats_.probes += probe ? 1 : 0;
+
+    const int long_side = config_.sizes[last_];
+    if (!config_.match_aspect || frame_size.empty()) {
+        return cv::Size(long_side, long_side);
+    }
+    // letterbox pads the short side up to the input; a matching aspect leaves almost nothing to pad
+    const double ratio = static_cast<double>(std::min(frame_size.width, frame_size.height)) / std::max(frame_size.width, frame_size.height);
+    const int short_side = std::max(stride_, static_cast<int>(std::ceil(long_side * ratio / stride_)) * stride_);
+    return frame_size.width >= frame_size.height ? cv::Size(long_side, short_side) : cv::Size(short_side, long_side);
+}
+
+void ResolutionController::record(const std::vector<YoloResults>& results, const cv::Size& frame_size, double inference_ms) {
+    ++stats_.frames;
+    ++stats_.frames_per_size[last_];
+    ewma_ms_[last_] = ewma_ms_[last_] < 0.0 ? inference_ms
+                                            : config_.smoothing * inference_ms + (1.0 - config_.smoothing) * ewma_ms_[last_];
+    if (results.empty() || frame_size.empty()) {
+        down_count_ = 0;
+        return;
+    }
+
+    std::vector<float> sides;
+    sides.reserve(results.size());
+    for (const YoloResults& result : results) {
+        sides.push_back(std::min(result.bbox.width, result.bbox.height));
+    }
+    const size_t k = static_cast<size_t>(config_.small_quantile * static_cast<float>(sides.size() - 1));
+    std::nth_element(sides.begin(), sides.begin() + k, sides.end());
+    const float small_side = sides[k];
+
+    // both letterbox modes scale the frame's long side to the input's long side
+    const float frame_long = static_cast<float>(std::max(frame_size.width, frame_size.height));
+    size_t wanted = config_.sizes.size() - 1;
+    for (size_t i = 0; i < config_.sizes.size(); ++i) {
+        if (small_side * config_.sizes[i] / frame_long >= config_.min_object_px) {
+            wanted = i;
+            break;
+        }
+    }
+    if (wanted > current_) {
+        current_ = wanted;
+        down_count_ = 0;
+    }
+    else if (wanted < current_) {
+        if (++down_count_ >= config_.down_frames) {
+            current_ = wanted;
+            down_count_ = 0;
+        }
+    }
+    else {
+        down_count_ = 0;
+    }
+}
+
+ResolutionControllerStats ResolutionController::getStats() const {
+    ResolutionControllerStats stats = stats_;
+    stats.sizes = config_.sizes;
+    stats.smoothed_ms_per_size = ewma_ms_;
+    return stats;
+}
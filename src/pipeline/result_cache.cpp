@@ -0,0 +1,225 @@
+#include "pipeline/result_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "utils/serialization.h"
+
+
+namespace {
+    constexpr uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+    constexpr size_t ENTRY_OVERHEAD = 96;  // list node, index slot, vector header
+
+    inline uint64_t mix(uint64_t h, uint64_t word) {
+        h = (h ^ word) * PRIME;
+        return h ^ (h >> 29);
+    }
+
+    template <typename T>
+    uint64_t mix_value(uint64_t h, const T& value) {
+        uint64_t word = 0;
+        std::memcpy(&word, &value, sizeof(T) < sizeof(word) ? sizeof(T) : sizeof(word));
+        return mix(h, word);
+    }
+}
+
+
+ResultCache::ResultCache(const ResultCacheConfig& config)
+    : config_(config) {
+}
+
+uint64_t ResultCache::hashPixels(const cv::Mat& image) {
+    if (image.empty()) {
+        return 0;
+    }
+    // four lanes keep the multiplies independent; a 1280x720 BGR frame hashes in well under a millisecond
+    uint64_t lanes[4] = { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull };
+    const size_t row_bytes = image.cols * image.elemSize();
+    const int rows = image.isContinuous() ? 1 : image.rows;
+    const size_t bytes_per_row = image.isContinuous() ? row_bytes * image.rows : row_bytes;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* data = image.ptr<uint8_t>(r);
+        size_t i = 0;
+        for (; i + 32 <= bytes_per_row; i += 32) {
+            uint64_t words[4];
+            std::memcpy(words, data + i, sizeof(words));
+            lanes[0] = mix(lanes[0], words[0]);
+            lanes[1] = mix(lanes[1], words[1]);
+            lanes[2] = mix(lanes[2], words[2]);
+            lanes[3] = mix(lanes[3], words[3]);
+        }
+        for (; i + 8 <= bytes_per_row; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            lanes[0] = mix(lanes[0], word);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, bytes_per_row - i);
+        lanes[1] = mix(lanes[1], tail ^ (static_cast<uint64_t>(r) << 48));
+    }
+    uint64_t h = mix(mix(mix(mix(0, lanes[0]), lanes[1]), lanes[2]), lanes[3]);
+    return mix(h, static_cast<uint64_t>(image.total() * image.elemSize()));
+}
+
+uint64_t ResultCache::scopeHash(AutoBackendOnnx& model, const PredictParams& params) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (const char* c = model.getModelPath(); *c; ++c) {
+        h = mix(h, static_cast<uint8_t>(*c));
+    }
+    h = mix_value(h, params.conf);
+    h = mix_value(h, params.iou);
+    h = mix_value(h, params.mask_threshold);
+    h = mix_value(h, params.conversionCode);
+    h = mix(h, (params.with_masks ? 1u : 0u) | (params.with_keypoints ? 2u : 0u));
+    h = mix_value(h, model.resolveInputSize(params.imgsz).width);
+    h = mix_value(h, model.resolveInputSize(params.imgsz).height);
+    h = mix(h, params.classes.size());
+    for (int cls : params.classes) {
+        h = mix_value(h, cls);
+    }
+    h = mix(h, params.class_conf.size());
+    for (float conf : params.class_conf) {
+        h = mix_value(h, conf);
+    }
+    return h;
+}
+
+ResultCache::Key ResultCache::makeKey(const cv::Mat& image, uint64_t scope) {
+    const auto start = std::chrono::steady_clock::now();
+    Key key;
+    key.pixels = hashPixels(image);
+    key.scope = scope;
+    key.rows = image.rows;
+    key.cols = image.cols;
+    key.type = image.type();
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.hash_ms += ms;
+    return key;
+}
+
+bool ResultCache::lookup(const Key& key, std::vector<YoloResults>& results) {
+    std::vector<uint8_t> encoded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.lookups;
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        encoded = it->second->encoded;
+    }
+    results.clear();
+    decode_results(encoded.data(), encoded.size(), results);  // mask unpacking outside the lock
+    return true;
+}
+
+void ResultCache::store(const Key& key, const std::vector<YoloResults>& results) {
+    Entry entry;
+    entry.key = key;
+    encode_results(results, entry.encoded);
+    entry.encoded.shrink_to_fit();
+    const size_t bytes = entry.encoded.size() + ENTRY_OVERHEAD;
+    if (bytes > config_.max_bytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        stats_.bytes -= it->second->encoded.size() + ENTRY_OVERHEAD;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front(std::move(entry));
+    index_.emplace(key, lru_.begin());
+    stats_.bytes += bytes;
+    ++stats_.inserts;
+    evict();
+    stats_.entries = index_.size();
+}
+
+void ResultCache::evict() {
+    while (stats_.bytes > config_.max_bytes && !lru_.empty()) {
+        const Entry& victim = lru_.back();
+        stats_.bytes -= victim.encoded.size() + ENTRY_OVERHEAD;
+        index_.erase(victim.key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+std::vector<std::vector<YoloResults>> ResultCache::predict_batch(AutoBackendOnnx& model, const std::vector<cv::Mat>& images,
+                                                                 const std::vector<PredictParams>& params) {
+    if (params.size() != 1 && params.size() != images.size()) {
+        throw std::invalid_argument("ResultCache: expected 1 or " + std::to_string(images.size()) + " PredictParams, got "
+                                    + std::to_string(params.size()));
+    }
+    std::vector<std::vector<YoloResults>> results(images.size());
+    std::vector<Key> keys(images.size());
+    std::vector<size_t> misses;           // indices that go to the model
+    std::vector<size_t> duplicate_of(images.size(), SIZE_MAX);
+    for (size_t i = 0; i < images.size(); ++i) {
+        const PredictParams& p = params.size() == 1 ? params[0] : params[i];
+        keys[i] = makeKey(images[i], scopeHash(model, p));
+        bool pending = false;
+        for (size_t m : misses) {
+            if (keys[m] == keys[i]) {
+                duplicate_of[i] = m;
+                pending = true;
+                break;
+            }
+        }
+        if (pending) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.lookups;
+            ++stats_.hits;
+        }
+        else if (!lookup(keys[i], results[i])) {
+            misses.push_back(i);
+        }
+    }
+    if (!misses.empty()) {
+        std::vector<cv::Mat> miss_images;
+        std::vector<PredictParams> miss_params;
+        for (size_t m : misses) {
+            miss_images.push_back(images[m]);
+            miss_params.push_back(params.size() == 1 ? params[0] : params[m]);
+        }
+        std::vector<std::vector<YoloResults>> computed = model.predict_batch(miss_images, miss_params);
+        for (size_t j = 0; j < misses.size(); ++j) {
+            store(keys[misses[j]], computed[j]);
+            results[misses[j]] = std::move(computed[j]);
+        }
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (duplicate_of[i] != SIZE_MAX) {
+            results[i] = results[duplicate_of[i]];
+            for (YoloResults& result : results[i]) {
+                result.mask = result.mask.clone();  // callers may draw into or rescale their own masks
+            }
+        }
+    }
+    return results;
+}
+
+std::vector<YoloResults> ResultCache::predict(AutoBackendOnnx& model, const cv::Mat& image, const PredictParams& params) {
+    return predict_batch(model, { image }, { params })[0];
+}
+
+ResultCacheStats ResultCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+}
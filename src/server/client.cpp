@@ -0,0 +1,175 @@
+#include "server/client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+#include "server/protocol.h"
+#include "server/socket_io.h"
+#include "utils/serialization.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+HelmsmanClient::HelmsmanClient(const std::string& socket_path)
+{
+#ifdef _WIN32
+    throw std::runtime_error("NotImplementedError: HelmsmanClient requires Unix domain sockets");
+#else
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("HelmsmanClient: socket path is too long: " + socket_path);
+    }
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int err = errno;
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw std::runtime_error("HelmsmanClient: cannot connect to " + socket_path + ": " + std::strerror(err));
+    }
+
+    ServerProtocol::RequestHeader hello{};
+    hello.magic = ServerProtocol::MAGIC;
+    hello.version = ServerProtocol::VERSION;
+    hello.op = ServerProtocol::HELLO;
+    std::vector<uint8_t> payload;
+    try {
+        request(&hello, sizeof(hello), payload);
+        if (payload.size() != sizeof(ServerProtocol::HelloPayload)) {
+            throw std::runtime_error("HelmsmanClient: unexpected HELLO response size " + std::to_string(payload.size()));
+        }
+        ServerProtocol::HelloPayload info{};
+        std::memcpy(&info, payload.data(), sizeof(info));
+        info.shm_name[ServerProtocol::SHM_NAME_MAX - 1] = '\0';
+        client_id_ = info.client_id;
+        ring_ = std::make_unique<SharedFrameRing>(std::string(info.shm_name));
+    }
+    catch (...) {
+        close(fd_);
+        throw;
+    }
+#endif
+}
+
+HelmsmanClient::~HelmsmanClient()
+{
+#ifndef _WIN32
+    if (ring_) {
+        ring_->releaseAll(client_id_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+#endif
+}
+
+cv::Mat HelmsmanClient::acquireFrame(int rows, int cols, int type)
+{
+    const uint64_t bytes = static_cast<uint64_t>(rows) * cols * CV_ELEM_SIZE(type);
+    if (bytes > ring_->getSlotBytes()) {
+        throw std::invalid_argument("HelmsmanClient: frame of " + std::to_string(bytes) + " bytes exceeds the slot size of "
+            + std::to_string(ring_->getSlotBytes()));
+    }
+    int slot = ring_->acquire(client_id_);
+    if (slot < 0) {
+        throw std::runtime_error("HelmsmanClient: all shared-memory slots are busy");
+    }
+    return cv::Mat(rows, cols, type, ring_->getSlotData(static_cast<uint32_t>(slot)));
+}
+
+std::vector<YoloResults> HelmsmanClient::predict(const cv::Mat& image, const PredictParams& params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int slot = slotOf(image);
+    cv::Mat frame = image;
+    if (slot < 0) {
+        frame = acquireFrame(image.rows, image.cols, image.type());
+        image.copyTo(frame);
+        slot = slotOf(frame);
+    }
+
+    ServerProtocol::RequestHeader header{};
+    header.magic = ServerProtocol::MAGIC;
+    header.version = ServerProtocol::VERSION;
+    header.op = ServerProtocol::PREDICT;
+    header.slot = static_cast<uint32_t>(slot);
+    header.rows = frame.rows;
+    header.cols = frame.cols;
+    header.type = frame.type();
+    header.step = frame.step[0];
+    header.conf = params.conf;
+    header.iou = params.iou;
+    header.mask_threshold = params.mask_threshold;
+    header.conversion_code = params.conversionCode;
+    header.with_masks = params.with_masks ? 1 : 0;
+    header.with_keypoints = params.with_keypoints ? 1 : 0;
+    if (has_deadline(params.deadline)) {
+        // the server measures from when it reads the request; a deadline that already passed still gets 1 ms,
+        // one beyond ~49 days is as good as none
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(params.deadline - std::chrono::steady_clock::now());
+        header.timeout_ms = static_cast<uint32_t>(std::clamp<int64_t>(remaining.count(), 1, UINT32_MAX));
+    }
+
+    std::vector<uint8_t> payload;
+    try {
+        request(&header, sizeof(header), payload);
+    }
+    catch (...) {
+        ring_->release(static_cast<uint32_t>(slot), client_id_);
+        throw;
+    }
+    ring_->release(static_cast<uint32_t>(slot), client_id_);
+
+    std::vector<YoloResults> results;
+    decode_results(payload.data(), payload.size(), results);
+    return results;
+}
+
+void HelmsmanClient::request(const void* header, size_t header_size, std::vector<uint8_t>& payload)
+{
+    ServerProtocol::ResponseHeader response{};
+    if (!write_exact(fd_, header, header_size) || !read_exact(fd_, &response, sizeof(response))) {
+        throw std::runtime_error("HelmsmanClient: connection to the server lost");
+    }
+    if (response.magic != ServerProtocol::MAGIC) {
+        throw std::runtime_error("HelmsmanClient: bad response magic");
+    }
+    payload.resize(response.payload_bytes);
+    if (response.payload_bytes > 0 && !read_exact(fd_, payload.data(), payload.size())) {
+        throw std::runtime_error("HelmsmanClient: connection to the server lost");
+    }
+    if (response.status == ServerProtocol::TIMEOUT) {
+        throw DeadlineExceededError("server");
+    }
+    if (response.status != ServerProtocol::OK) {
+        throw std::runtime_error("HelmsmanClient: server error: " + std::string(payload.begin(), payload.end()));
+    }
+}
+
+int HelmsmanClient::slotOf(const cv::Mat& image)
+{
+    if (image.empty()) {
+        return -1;
+    }
+    // the server reads a frame from the start of its slot, so a view into a slot (an ROI) has to be copied
+    for (uint32_t i = 0; i < ring_->getSlotCount(); ++i) {
+        if (image.data == ring_->getSlotData(i) && ring_->isOwnedBy(i, client_id_)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,219 @@
+#include "server/inference_server.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+#include "server/protocol.h"
+#include "server/socket_io.h"
+#include "utils/serialization.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+    constexpr int POLL_INTERVAL_MS = 200;  // how often blocked loops notice stop()
+}
+
+
+InferenceServer::InferenceServer(AutoBackendOnnx& model, InferenceServerConfig config)
+    : model_(model), config_(std::move(config))
+{
+#ifdef _WIN32
+    throw std::runtime_error("NotImplementedError: InferenceServer requires Unix domain sockets");
+#else
+    if (config_.shm_name.empty()) {
+        config_.shm_name = "/helmsman-" + std::to_string(getpid());
+    }
+    if (config_.shm_name.size() >= ServerProtocol::SHM_NAME_MAX) {
+        throw std::invalid_argument("InferenceServer: shm name is too long: " + config_.shm_name);
+    }
+    ring_ = std::make_unique<SharedFrameRing>(config_.shm_name, config_.slot_count, config_.slot_bytes);
+    predictor_ = std::make_unique<AsyncPredictor>(model_, config_.batching);
+#endif
+}
+
+InferenceServer::~InferenceServer()
+{
+    stop();
+    for (Connection& connection : connections_) {
+        if (connection.thread.joinable()) {
+            connection.thread.join();
+        }
+    }
+    predictor_.reset();
+#ifndef _WIN32
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(config_.socket_path.c_str());
+    }
+#endif
+}
+
+void InferenceServer::stop()
+{
+    stopping_.store(true);
+}
+
+#ifndef _WIN32
+
+void InferenceServer::run()
+{
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (config_.socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("InferenceServer: socket path is too long: " + config_.socket_path);
+    }
+    std::strncpy(addr.sun_path, config_.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("InferenceServer: socket() failed: " + std::string(std::strerror(errno)));
+    }
+    unlink(config_.socket_path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd_, 64) != 0) {
+        throw std::runtime_error("InferenceServer: cannot listen on " + config_.socket_path + ": " + std::strerror(errno));
+    }
+    std::cout << "Serving on " << config_.socket_path << " (frames via " << ring_->getName() << ", "
+              << config_.slot_count << " slots of " << config_.slot_bytes << " bytes)" << std::endl;
+
+    while (!stopping_.load()) {
+        pollfd pfd{ listen_fd_, POLLIN, 0 };
+        int ready = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (ready <= 0) {
+            continue;  // timeout or EINTR
+        }
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        // reap finished connections so a long-running daemon doesn't accumulate threads
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (it->done->load()) {
+                it->thread.join();
+                it = connections_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        Connection connection;
+        connection.done = std::make_shared<std::atomic<bool>>(false);
+        uint32_t client_id = next_client_id_++;
+        connection.thread = std::thread([this, fd, client_id, done = connection.done] {
+            serve(fd, client_id);
+            done->store(true);
+        });
+        connections_.push_back(std::move(connection));
+    }
+}
+
+void InferenceServer::serve(int fd, uint32_t client_id)
+{
+    using namespace ServerProtocol;
+    std::vector<uint8_t> payload;
+
+    while (!stopping_.load()) {
+        pollfd pfd{ fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        RequestHeader request{};
+        if (ready < 0 || !read_exact(fd, &request, sizeof(request))) {
+            break;  // client went away
+        }
+        if (request.magic != MAGIC || request.version != VERSION) {
+            const std::string message = "bad magic or protocol version";
+            send_response(fd, BAD_REQUEST, message.data(), static_cast<uint32_t>(message.size()));
+            break;
+        }
+
+        if (request.op == HELLO) {
+            HelloPayload hello{};
+            std::strncpy(hello.shm_name, ring_->getName().c_str(), SHM_NAME_MAX - 1);
+            hello.client_id = client_id;
+            hello.slot_count = ring_->getSlotCount();
+            hello.slot_bytes = ring_->getSlotBytes();
+            if (!send_response(fd, OK, &hello, sizeof(hello))) {
+                break;
+            }
+            continue;
+        }
+        if (request.op != PREDICT) {
+            const std::string message = "unknown op " + std::to_string(request.op);
+            send_response(fd, BAD_REQUEST, message.data(), static_cast<uint32_t>(message.size()));
+            continue;
+        }
+
+        // the frame must sit inside a slot this client claimed: step * (rows - 1) + row_bytes <= slot_bytes,
+        // checked without the multiplication so a huge step can't wrap around
+        const uint64_t row_bytes = static_cast<uint64_t>(request.cols) * CV_ELEM_SIZE(request.type);
+        const uint64_t slot_bytes = ring_->getSlotBytes();
+        if (!ring_->isOwnedBy(request.slot, client_id) || request.rows <= 0 || request.cols <= 0
+            || CV_MAT_DEPTH(request.type) != CV_8U || request.step < row_bytes || request.step > slot_bytes
+            || static_cast<uint64_t>(request.rows) > (slot_bytes - row_bytes) / request.step + 1) {
+            const std::string message = "invalid frame: slot " + std::to_string(request.slot) + ", "
+                + std::to_string(request.cols) + "x" + std::to_string(request.rows) + ", step " + std::to_string(request.step);
+            send_response(fd, BAD_REQUEST, message.data(), static_cast<uint32_t>(message.size()));
+            continue;
+        }
+
+        cv::Mat frame(request.rows, request.cols, request.type, ring_->getSlotData(request.slot), static_cast<size_t>(request.step));
+        PredictParams params;
+        params.conf = request.conf;
+        params.iou = request.iou;
+        params.mask_threshold = request.mask_threshold;
+        params.conversionCode = request.conversion_code;
+        params.with_masks = config_.with_masks && request.with_masks != 0;
+        params.with_keypoints = config_.with_keypoints && request.with_keypoints != 0;
+        params.classes = config_.classes;
+        params.class_conf = config_.class_conf;
+        const std::chrono::milliseconds timeout = request.timeout_ms > 0 ? std::chrono::milliseconds(request.timeout_ms)
+                                                                         : config_.request_timeout;
+        if (timeout.count() > 0) {
+            params.deadline = std::chrono::steady_clock::now() + timeout;
+        }
+        payload.clear();
+        uint16_t status = OK;
+        try {
+            std::vector<YoloResults> results = predictor_->submit(frame, params).get();
+            encode_results(results, payload);
+        }
+        catch (const DeadlineExceededError& e) {
+            status = TIMEOUT;
+            payload.assign(e.what(), e.what() + std::strlen(e.what()));
+        }
+        catch (const std::exception& e) {
+            status = FAILED;
+            payload.assign(e.what(), e.what() + std::strlen(e.what()));
+        }
+        if (!send_response(fd, status, payload.data(), static_cast<uint32_t>(payload.size()))) {
+            break;
+        }
+    }
+
+    ring_->releaseAll(client_id);
+    close(fd);
+}
+
+#else
+
+void InferenceServer::run() {}
+
+void InferenceServer::serve(int, uint32_t) {}
+
+#endif
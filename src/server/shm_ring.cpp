@@ -0,0 +1,184 @@
+#include "server/shm_ring.h"
+
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+    constexpr uint32_t RING_MAGIC = 0x474E5248;  // "HRNG"
+    constexpr size_t OWNERS_OFFSET = 64;
+    constexpr uint64_t PAGE = 4096;
+
+    uint64_t round_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "slot owners must be lock-free to live in shared memory");
+}
+
+
+#ifndef _WIN32
+
+SharedFrameRing::SharedFrameRing(const std::string& name, uint32_t slot_count, uint64_t slot_bytes)
+    : name_(name), owner_(true)
+{
+    if (slot_count == 0 || slot_bytes == 0) {
+        throw std::invalid_argument("SharedFrameRing: slot_count and slot_bytes must be positive");
+    }
+    const uint64_t slot_stride = round_up(slot_bytes, PAGE);
+    const uint64_t data_offset = round_up(OWNERS_OFFSET + sizeof(std::atomic<uint32_t>) * slot_count, PAGE);
+    const size_t size = static_cast<size_t>(data_offset + slot_stride * slot_count);
+
+    shm_unlink(name_.c_str());  // a previous server might have died without cleaning up
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("SharedFrameRing: shm_open(" + name_ + ") failed: " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name_.c_str());
+        throw std::runtime_error("SharedFrameRing: ftruncate failed: " + std::string(std::strerror(err)));
+    }
+    map(fd, size);
+
+    header_->magic = RING_MAGIC;
+    header_->slot_count = slot_count;
+    header_->slot_bytes = slot_bytes;
+    header_->slot_stride = slot_stride;
+    header_->data_offset = data_offset;
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        new (owners() + i) std::atomic<uint32_t>(FREE);
+    }
+}
+
+SharedFrameRing::SharedFrameRing(const std::string& name)
+    : name_(name), owner_(false)
+{
+    int fd = shm_open(name_.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("SharedFrameRing: shm_open(" + name_ + ") failed: " + std::strerror(errno));
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        throw std::runtime_error("SharedFrameRing: " + name_ + " is not a frame ring");
+    }
+    map(fd, static_cast<size_t>(st.st_size));
+    if (header_->magic != RING_MAGIC) {
+        munmap(base_, size_);
+        throw std::runtime_error("SharedFrameRing: " + name_ + " has a bad magic");
+    }
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+    }
+    if (owner_) {
+        shm_unlink(name_.c_str());
+    }
+}
+
+void SharedFrameRing::map(int fd, size_t size)
+{
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+        throw std::runtime_error("SharedFrameRing: mmap failed: " + std::string(std::strerror(err)));
+    }
+    base_ = static_cast<uint8_t*>(base);
+    size_ = size;
+    header_ = reinterpret_cast<Header*>(base_);
+}
+
+#else
+
+SharedFrameRing::SharedFrameRing(const std::string& name, uint32_t, uint64_t) : name_(name)
+{
+    throw std::runtime_error("NotImplementedError: SharedFrameRing requires POSIX shared memory");
+}
+
+SharedFrameRing::SharedFrameRing(const std::string& name) : name_(name)
+{
+    throw std::runtime_error("NotImplementedError: SharedFrameRing requires POSIX shared memory");
+}
+
+SharedFrameRing::~SharedFrameRing() = default;
+
+void SharedFrameRing::map(int, size_t) {}
+
+#endif
+
+
+std::atomic<uint32_t>* SharedFrameRing::owners()
+{
+    return reinterpret_cast<std::atomic<uint32_t>*>(base_ + OWNERS_OFFSET);
+}
+
+const std::string& SharedFrameRing::getName() const
+{
+    return name_;
+}
+
+uint32_t SharedFrameRing::getSlotCount() const
+{
+    return header_->slot_count;
+}
+
+uint64_t SharedFrameRing::getSlotBytes() const
+{
+    return header_->slot_bytes;
+}
+
+uint8_t* SharedFrameRing::getSlotData(uint32_t slot)
+{
+    if (slot >= header_->slot_count) {
+        throw std::out_of_range("SharedFrameRing: slot " + std::to_string(slot) + " out of range");
+    }
+    return base_ + header_->data_offset + header_->slot_stride * slot;
+}
+
+int SharedFrameRing::acquire(uint32_t owner)
+{
+    for (uint32_t i = 0; i < header_->slot_count; ++i) {
+        uint32_t expected = FREE;
+        if (owners()[i].compare_exchange_strong(expected, owner, std::memory_order_acquire)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void SharedFrameRing::release(uint32_t slot, uint32_t owner)
+{
+    uint32_t expected = owner;
+    owners()[slot].compare_exchange_strong(expected, FREE, std::memory_order_release);
+}
+
+void SharedFrameRing::releaseAll(uint32_t owner)
+{
+    for (uint32_t i = 0; i < header_->slot_count; ++i) {
+        release(i, owner);
+    }
+}
+
+bool SharedFrameRing::isOwnedBy(uint32_t slot, uint32_t owner)
+{
+    return slot < header_->slot_count && owners()[slot].load(std::memory_order_acquire) == owner;
+}
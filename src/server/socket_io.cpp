@@ -0,0 +1,65 @@
+#include "server/socket_io.h"
+
+#include "server/protocol.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS: the server ignores SIGPIPE instead
+#endif
+
+
+bool read_exact(int fd, void* buffer, size_t size) {
+    auto* data = static_cast<uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_exact(int fd, const void* buffer, size_t size) {
+    const auto* data = static_cast<const uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+#else
+#include <stdexcept>
+
+bool read_exact(int, void*, size_t) {
+    throw std::runtime_error("NotImplementedError: Unix domain sockets are not supported on Windows");
+}
+
+bool write_exact(int, const void*, size_t) {
+    throw std::runtime_error("NotImplementedError: Unix domain sockets are not supported on Windows");
+}
+
+#endif
+
+
+bool send_response(int fd, uint16_t status, const void* payload, uint32_t payload_bytes) {
+    ServerProtocol::ResponseHeader header{ ServerProtocol::MAGIC, ServerProtocol::VERSION, status, payload_bytes };
+    return write_exact(fd, &header, sizeof(header)) && (payload_bytes == 0 || write_exact(fd, payload, payload_bytes));
+}
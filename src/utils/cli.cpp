@@ -0,0 +1,61 @@
+#include "utils/cli.h"
+
+#include <stdexcept>
+
+
+CliArgs::CliArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg.rfind("--", 0) == 0 && arg.size() > 2) {
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                options_[arg.substr(2)] = "";
+            }
+            else {
+                options_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+        else {
+            positional_.push_back(arg);
+        }
+    }
+}
+
+bool CliArgs::has(const std::string& name) const {
+    return options_.find(name) != options_.end();
+}
+
+std::string CliArgs::get(const std::string& name, const std::string& fallback) const {
+    auto it = options_.find(name);
+    return it == options_.end() ? fallback : it->second;
+}
+
+int CliArgs::getInt(const std::string& name, int fallback) const {
+    auto it = options_.find(name);
+    if (it == options_.end() || it->second.empty()) {
+        return fallback;
+    }
+    try {
+        return std::stoi(it->second);
+    }
+    catch (const std::exception&) {
+        throw std::invalid_argument("Bad argument (cannot cast): --" + name + "=" + it->second);
+    }
+}
+
+float CliArgs::getFloat(const std::string& name, float fallback) const {
+    auto it = options_.find(name);
+    if (it == options_.end() || it->second.empty()) {
+        return fallback;
+    }
+    try {
+        return std::stof(it->second);
+    }
+    catch (const std::exception&) {
+        throw std::invalid_argument("Bad argument (cannot cast): --" + name + "=" + it->second);
+    }
+}
+
+const std::vector<std::string>& CliArgs::positional() const {
+    return positional_;
+}
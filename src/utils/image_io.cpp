@@ -0,0 +1,190 @@
+#include "utils/image_io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace fs = std::filesystem;
+
+
+namespace {
+
+uint32_t read_be16(const std::vector<uchar>& buffer, size_t pos) {
+    return (static_cast<uint32_t>(buffer[pos]) << 8) | buffer[pos + 1];
+}
+
+uint32_t read_be32(const std::vector<uchar>& buffer, size_t pos) {
+    return (read_be16(buffer, pos) << 16) | read_be16(buffer, pos + 2);
+}
+
+bool probe_jpeg_size(const std::vector<uchar>& buffer, cv::Size& size) {
+    size_t pos = 2;  // after SOI
+    while (pos + 4 <= buffer.size()) {
+        if (buffer[pos] != 0xFF) {
+            return false;
+        }
+        uchar marker = buffer[pos + 1];
+        if (marker == 0xFF) {  // fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) {  // markers without a payload
+            pos += 2;
+            continue;
+        }
+        // SOFn carries the frame size (DHT, JPG and DAC share the range but aren't frame headers)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > buffer.size()) {
+                return false;
+            }
+            size = cv::Size(static_cast<int>(read_be16(buffer, pos + 7)), static_cast<int>(read_be16(buffer, pos + 5)));
+            return size.width > 0 && size.height > 0;
+        }
+        pos += 2 + read_be16(buffer, pos + 2);
+    }
+    return false;
+}
+
+}  // namespace
+
+
+bool probe_image_size(const std::vector<uchar>& buffer, cv::Size& size) {
+    static const uchar png_signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    if (buffer.size() >= 24 && std::equal(png_signature, png_signature + 8, buffer.begin())) {
+        size = cv::Size(static_cast<int>(read_be32(buffer, 16)), static_cast<int>(read_be32(buffer, 20)));
+        return size.width > 0 && size.height > 0;
+    }
+    if (buffer.size() >= 4 && buffer[0] == 0xFF && buffer[1] == 0xD8) {
+        return probe_jpeg_size(buffer, size);
+    }
+    return false;
+}
+
+DecodedImage decode_image_for_model(const fs::path& path, const cv::Size& target_size) {
+    DecodedImage decoded;
+    decoded.path = path.string();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        decoded.error = "cannot open file";
+        return decoded;
+    }
+    std::vector<uchar> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    int flags = cv::IMREAD_COLOR;
+    int factor = 1;
+    cv::Size raw_size;
+    if (probe_image_size(buffer, raw_size)) {
+        // letterbox gain of the full-size image; reducing by f multiplies it by f, keep it <= 1 to lose nothing.
+        // The probe sees the stored size, before EXIF orientation: take the larger gain of both orientations
+        auto gain_of = [&target_size](const cv::Size& size) {
+            return std::min(static_cast<double>(target_size.width) / size.width,
+                            static_cast<double>(target_size.height) / size.height);
+        };
+        const double gain = std::max(gain_of(raw_size), gain_of(cv::Size(raw_size.height, raw_size.width)));
+        if (gain * 8.0 <= 1.0) {
+            flags = cv::IMREAD_REDUCED_COLOR_8;
+            factor = 8;
+        }
+        else if (gain * 4.0 <= 1.0) {
+            flags = cv::IMREAD_REDUCED_COLOR_4;
+            factor = 4;
+        }
+        else if (gain * 2.0 <= 1.0) {
+            flags = cv::IMREAD_REDUCED_COLOR_2;
+            factor = 2;
+        }
+    }
+
+    decoded.image = cv::imdecode(buffer, flags);
+    if (decoded.image.empty()) {
+        decoded.error = "cannot decode image";
+        return decoded;
+    }
+    decoded.raw_size = decoded.image.size();
+    if (factor > 1) {
+        // imdecode applies EXIF orientation to reduced decodes as well, so orientations 5-8 come back transposed
+        const cv::Size reduced((raw_size.width + factor - 1) / factor, (raw_size.height + factor - 1) / factor);
+        if (decoded.image.size() == reduced) {
+            decoded.raw_size = raw_size;
+        }
+        else if (decoded.image.size() == cv::Size(reduced.height, reduced.width)) {
+            decoded.raw_size = cv::Size(raw_size.height, raw_size.width);
+        }
+        else {
+            decoded.raw_size = cv::Size(decoded.image.cols * factor, decoded.image.rows * factor);
+        }
+    }
+    return decoded;
+}
+
+void rescale_results(std::vector<YoloResults>& results, const cv::Size& from, const cv::Size& to) {
+    if (from == to) {
+        return;
+    }
+    const float sx = static_cast<float>(to.width) / static_cast<float>(from.width);
+    const float sy = static_cast<float>(to.height) / static_cast<float>(from.height);
+    const cv::Rect_<float> bound(0.0f, 0.0f, static_cast<float>(to.width), static_cast<float>(to.height));
+
+    for (YoloResults& result : results) {
+        result.bbox = cv::Rect_<float>(result.bbox.x * sx, result.bbox.y * sy,
+                                       result.bbox.width * sx, result.bbox.height * sy) & bound;
+        // keypoints are stored as (x, y, visibility) triplets
+        for (size_t i = 0; i + 1 < result.keypoints.size(); i += 3) {
+            result.keypoints[i] *= sx;
+            result.keypoints[i + 1] *= sy;
+        }
+        if (!result.mask.empty()) {
+            // masks always cover exactly the (integer) bbox
+            cv::Size mask_size = cv::Rect(result.bbox).size();
+            if (mask_size.width > 0 && mask_size.height > 0) {
+                cv::resize(result.mask, result.mask, mask_size, 0, 0, cv::INTER_NEAREST);
+            }
+            else {
+                result.mask.release();
+            }
+        }
+    }
+}
+
+std::vector<std::string> collect_image_paths(const fs::path& input) {
+    static const std::set<std::string> image_extensions = {
+        ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".webp"
+    };
+    std::vector<std::string> paths;
+
+    if (fs::is_directory(input)) {
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (image_extensions.count(ext)) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    std::ifstream list(input);
+    if (!list) {
+        throw std::runtime_error("Cannot open image list: " + input.string());
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] != '#') {
+            paths.push_back(line);
+        }
+    }
+    return paths;
+}
@@ -0,0 +1,140 @@
+#include "utils/memory.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+
+size_t current_rss_bytes() {
+#if defined(__linux__)
+    // statm: size resident shared text lib data dt, in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t size_pages = 0;
+    size_t resident_pages = 0;
+    if (statm >> size_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return static_cast<size_t>(info.resident_size);
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+size_t peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);  // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // KiB on Linux
+#endif
+#else
+    return 0;
+#endif
+}
+
+std::string format_bytes(double bytes) {
+    static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    size_t unit = 0;
+    double value = bytes < 0 ? -bytes : bytes;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        ++unit;
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s%.1f %s", bytes < 0 ? "-" : "", value, units[unit]);
+    return buffer;
+}
+
+MemoryBreakdown memory_breakdown() {
+    MemoryBreakdown breakdown;
+    breakdown.rss = current_rss_bytes();
+    breakdown.peak_rss = peak_rss_bytes();
+#if defined(__linux__)
+    // "RssAnon:    123456 kB"
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        size_t kib = 0;
+        if (!(fields >> key >> kib)) {
+            continue;
+        }
+        if (key == "RssAnon:") {
+            breakdown.rss_anon = kib * 1024;
+        }
+        else if (key == "RssFile:") {
+            breakdown.rss_file = kib * 1024;
+        }
+    }
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    breakdown.heap_in_use = info.uordblks + info.hblkhd;
+    breakdown.heap_free = info.fordblks;
+    breakdown.heap_mmapped = info.hblkhd;
+#endif
+    return breakdown;
+}
+
+std::string format_memory_breakdown(const MemoryBreakdown& breakdown) {
+    std::string line = "RSS " + format_bytes(static_cast<double>(breakdown.rss))
+        + " (peak " + format_bytes(static_cast<double>(breakdown.peak_rss)) + ")";
+    if (breakdown.rss_anon || breakdown.rss_file) {
+        line += ": anon " + format_bytes(static_cast<double>(breakdown.rss_anon))
+            + ", file " + format_bytes(static_cast<double>(breakdown.rss_file));
+    }
+    if (breakdown.heap_in_use || breakdown.heap_free) {
+        line += "; heap " + format_bytes(static_cast<double>(breakdown.heap_in_use)) + " in use ("
+            + format_bytes(static_cast<double>(breakdown.heap_mmapped)) + " mmapped), "
+            + format_bytes(static_cast<double>(breakdown.heap_free)) + " free";
+    }
+    return line;
+}
+
+size_t release_free_memory() {
+#if defined(__GLIBC__)
+    const size_t before = current_rss_bytes();
+    malloc_trim(0);
+    const size_t after = current_rss_bytes();
+    return before > after ? before - after : 0;
+#else
+    return 0;
+#endif
+}
+
+size_t release_free_memory_after_burst() {
+    static std::atomic<int64_t> last_trim_ms{ -1000 };
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = last_trim_ms.load();
+    if (now_ms - last < 1000 || !last_trim_ms.compare_exchange_strong(last, now_ms)) {
+        return 0;
+    }
+    return release_free_memory();
+}
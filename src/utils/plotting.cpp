@@ -0,0 +1,121 @@
+#include "utils/plotting.h"
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+
+namespace {
+    const int LABEL_FONT = cv::FONT_HERSHEY_SIMPLEX;
+    const double LABEL_SCALE = 0.6;
+    const int LABEL_THICKNESS = 2;
+    const double FRAME_WEIGHT = 0.6;
+    const double MASK_WEIGHT = 0.4;
+}
+
+
+cv::Scalar generateRandomColor(int numChannels) {
+    if (numChannels < 1 || numChannels > 3)
+        throw std::invalid_argument("Invalid number of channels. Must be between 1 and 3.");
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<int> dis(0, 255);
+
+    cv::Scalar color;
+    for (int i = 0; i < numChannels; i++) {
+        color[i] = dis(gen);
+    }
+    return color;
+}
+
+std::vector<cv::Scalar> generateRandomColors(int class_names_num, int numChannels) {
+    std::vector<cv::Scalar> colors;
+    for (int i = 0; i < class_names_num; i++) {
+        colors.push_back(generateRandomColor(numChannels));
+    }
+    return colors;
+}
+
+
+ResultPlotter::ResultPlotter(const std::unordered_map<int, std::string>& names, const std::vector<cv::Scalar>& colors)
+    : names_(names), colors_(colors) {
+    if (colors_.empty()) {
+        colors_.push_back(cv::Scalar(0, 255, 0));
+    }
+}
+
+const ResultPlotter::Label& ResultPlotter::label(int class_idx) {
+    auto it = labels_.find(class_idx);
+    if (it != labels_.end()) {
+        return it->second;
+    }
+
+    Label label;
+    auto name = names_.find(class_idx);
+    if (name != names_.end()) {
+        label.prefix = name->second + " ";
+    }
+    else {
+        std::cerr << "Warning: class_idx not found in names for class_idx = " << class_idx << std::endl;
+        label.prefix = std::to_string(class_idx) + " ";
+    }
+    // Hershey digits share one advance width, so any two-decimal confidence has the same extent
+    label.text_size = cv::getTextSize(label.prefix + "0.00", LABEL_FONT, LABEL_SCALE, LABEL_THICKNESS, nullptr);
+    return labels_.emplace(class_idx, std::move(label)).first->second;
+}
+
+const cv::Scalar& ResultPlotter::color(int class_idx) const {
+    return colors_[static_cast<size_t>(class_idx) % colors_.size()];
+}
+
+void ResultPlotter::blend_mask(cv::Mat& img, const YoloResults& result, const cv::Scalar& color) const {
+    const cv::Rect box(result.bbox);
+    if (result.mask.size() != box.size()) {
+        return;
+    }
+    const cv::Rect visible = box & cv::Rect(0, 0, img.cols, img.rows);
+    if (visible.empty()) {
+        return;
+    }
+    cv::Mat roi = img(visible);
+    cv::Mat mask = result.mask(visible - box.tl());
+
+    cv::Mat blended;
+    cv::addWeighted(roi, FRAME_WEIGHT, cv::Mat(roi.size(), roi.type(), color), MASK_WEIGHT, 0, blended);
+    blended.copyTo(roi, mask);
+}
+
+void ResultPlotter::draw(cv::Mat& img, const std::vector<YoloResults>& results) {
+    // masks first so boxes and labels of overlapping instances stay on top
+    for (const YoloResults& result : results) {
+        if (!result.mask.empty()) {
+            blend_mask(img, result, color(result.class_idx));
+        }
+    }
+
+    char conf_text[16];
+    for (const YoloResults& result : results) {
+        const cv::Scalar& class_color = color(result.class_idx);
+        const float left = result.bbox.x;
+        const float top = result.bbox.y;
+
+        // Draw bounding box
+        cv::rectangle(img, result.bbox, class_color, 2);
+
+        // Draw label background and text
+        const Label& class_label = label(result.class_idx);
+        std::snprintf(conf_text, sizeof(conf_text), "%.2f", result.conf);
+        cv::Rect rect_to_fill(static_cast<int>(left - 1),
+                              static_cast<int>(top - class_label.text_size.height - 5),
+                              class_label.text_size.width + 2,
+                              class_label.text_size.height + 5);
+        cv::rectangle(img, rect_to_fill, class_color, -1);
+        cv::putText(img, class_label.prefix + conf_text,
+                    cv::Point(static_cast<int>(left - 1.5), static_cast<int>(top - 2.5)),
+                    LABEL_FONT, LABEL_SCALE, cv::Scalar(255, 255, 255), LABEL_THICKNESS);
+    }
+}
@@ -0,0 +1,195 @@
+#include "utils/result_writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "utils/serialization.h"
+
+
+namespace {
+
+void append_json_string(std::string& out, const std::string& value) {
+    out += '"';
+    for (char ch : value) {
+        switch (ch) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(ch) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                out += escaped;
+            }
+            else {
+                out += ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+void append_number(std::string& out, float value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+    out += buffer;
+}
+
+void append_mask_rle(std::string& out, const cv::Mat& mask) {
+    out += "{\"size\": [" + std::to_string(mask.rows) + ", " + std::to_string(mask.cols) + "], \"counts\": [";
+    bool current = false;
+    size_t run = 0;
+    bool first = true;
+    for (int r = 0; r < mask.rows; ++r) {
+        const uchar* row = mask.ptr<uchar>(r);
+        for (int c = 0; c < mask.cols; ++c) {
+            const bool value = row[c] != 0;
+            if (value != current) {
+                out += first ? "" : ", ";
+                out += std::to_string(run);
+                first = false;
+                current = value;
+                run = 0;
+            }
+            ++run;
+        }
+    }
+    out += first ? "" : ", ";
+    out += std::to_string(run);
+    out += "]}";
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+    const size_t pos = out.size();
+    out.resize(pos + sizeof(T));
+    std::memcpy(out.data() + pos, &value, sizeof(T));
+}
+
+}  // namespace
+
+
+std::unique_ptr<ResultWriter> ResultWriter::create(const std::string& format, const std::string& path,
+                                                   const std::unordered_map<int, std::string>& names) {
+    if (format == "jsonl") {
+        return std::make_unique<JsonlResultWriter>(path, names);
+    }
+    if (format == "bin") {
+        if (path == "-") {
+            throw std::runtime_error("Binary results need an output file (--out=...)");
+        }
+        return std::make_unique<BinaryResultWriter>(path);
+    }
+    throw std::runtime_error("NotImplementedError: unsupported result format '" + format + "'");
+}
+
+
+JsonlResultWriter::JsonlResultWriter(const std::string& path, const std::unordered_map<int, std::string>& names)
+    : out_(&std::cout), names_(names) {
+    if (path != "-") {
+        file_.open(path, std::ios::out | std::ios::trunc);
+        if (!file_) {
+            throw std::runtime_error("Cannot open output file: " + path);
+        }
+        out_ = &file_;
+    }
+}
+
+JsonlResultWriter::JsonlResultWriter(std::ostream& out, const std::unordered_map<int, std::string>& names)
+    : out_(&out), names_(names) {
+}
+
+void JsonlResultWriter::write(const std::string& path, const cv::Size& image_size,
+                              const std::vector<YoloResults>& results, const std::string& error) {
+    line_.clear();
+    line_ += "{\"path\": ";
+    append_json_string(line_, path);
+    if (!error.empty()) {
+        line_ += ", \"error\": ";
+        append_json_string(line_, error);
+        line_ += "}\n";
+        *out_ << line_;
+        return;
+    }
+
+    line_ += ", \"width\": " + std::to_string(image_size.width) + ", \"height\": " + std::to_string(image_size.height);
+    line_ += ", \"detections\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const YoloResults& result = results[i];
+        line_ += i ? ", {" : "{";
+        line_ += "\"class\": " + std::to_string(result.class_idx) + ", \"name\": ";
+        auto it = names_.find(result.class_idx);
+        append_json_string(line_, it != names_.end() ? it->second : std::to_string(result.class_idx));
+        line_ += ", \"conf\": ";
+        append_number(line_, result.conf);
+        line_ += ", \"bbox\": [";
+        const float bbox[4] = { result.bbox.x, result.bbox.y, result.bbox.width, result.bbox.height };
+        for (int k = 0; k < 4; ++k) {
+            line_ += k ? ", " : "";
+            append_number(line_, bbox[k]);
+        }
+        line_ += "]";
+        if (result.sub_class_idx >= 0) {
+            line_ += ", \"sub_class\": " + std::to_string(result.sub_class_idx) + ", \"sub_conf\": ";
+            append_number(line_, result.sub_conf);
+        }
+        if (!result.keypoints.empty()) {
+            line_ += ", \"keypoints\": [";
+            for (size_t k = 0; k < result.keypoints.size(); ++k) {
+                line_ += k ? ", " : "";
+                append_number(line_, result.keypoints[k]);
+            }
+            line_ += "]";
+        }
+        if (!result.mask.empty()) {
+            line_ += ", \"mask\": ";
+            append_mask_rle(line_, result.mask);
+        }
+        line_ += "}";
+    }
+    line_ += "]}\n";
+    *out_ << line_;
+}
+
+void JsonlResultWriter::flush() {
+    out_->flush();
+}
+
+
+BinaryResultWriter::BinaryResultWriter(const std::string& path) {
+    file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        throw std::runtime_error("Cannot open output file: " + path);
+    }
+    record_.clear();
+    put(record_, MAGIC);
+    put(record_, VERSION);
+    file_.write(reinterpret_cast<const char*>(record_.data()), static_cast<std::streamsize>(record_.size()));
+}
+
+void BinaryResultWriter::write(const std::string& path, const cv::Size& image_size,
+                               const std::vector<YoloResults>& results, const std::string& error) {
+    record_.clear();
+    put(record_, static_cast<uint32_t>(path.size()));
+    record_.insert(record_.end(), path.begin(), path.end());
+    put(record_, static_cast<int32_t>(error.empty() ? image_size.width : 0));
+    put(record_, static_cast<int32_t>(error.empty() ? image_size.height : 0));
+
+    const size_t length_pos = record_.size();
+    put(record_, uint32_t{ 0 });
+    if (error.empty()) {
+        encode_results(results, record_);
+    }
+    const uint32_t payload_bytes = static_cast<uint32_t>(record_.size() - length_pos - sizeof(uint32_t));
+    std::memcpy(record_.data() + length_pos, &payload_bytes, sizeof(payload_bytes));
+
+    file_.write(reinterpret_cast<const char*>(record_.data()), static_cast<std::streamsize>(record_.size()));
+}
+
+void BinaryResultWriter::flush() {
+    file_.flush();
+}
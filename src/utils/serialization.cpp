@@ -0,0 +1,135 @@
+#include "utils/serialization.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+    const size_t pos = out.size();
+    out.resize(pos + sizeof(T));
+    std::memcpy(out.data() + pos, &value, sizeof(T));
+}
+
+// class, conf, bbox, keypoint count, mask rows and cols: the smallest possible encoded result
+constexpr size_t MIN_RESULT_BYTES = sizeof(int32_t) + 5 * sizeof(float) + 3 * sizeof(uint16_t);
+
+template <typename T>
+T take(const uint8_t* data, size_t size, size_t& pos) {
+    if (pos + sizeof(T) > size) {
+        throw std::runtime_error("decode_results: truncated input at byte " + std::to_string(pos));
+    }
+    T value;
+    std::memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+}  // namespace
+
+
+void pack_mask_bits(const cv::Mat& mask, std::vector<uint8_t>& out) {
+    CV_Assert(mask.type() == CV_8UC1);
+    const size_t pos = out.size();
+    out.resize(pos + (static_cast<size_t>(mask.rows) * mask.cols + 7) / 8, 0);
+    uint8_t* bits = out.data() + pos;
+    size_t bit = 0;
+    for (int r = 0; r < mask.rows; ++r) {
+        const uint8_t* row = mask.ptr<uint8_t>(r);
+        for (int c = 0; c < mask.cols; ++c, ++bit) {
+            if (row[c]) {
+                bits[bit >> 3] |= static_cast<uint8_t>(0x80u >> (bit & 7));
+            }
+        }
+    }
+}
+
+cv::Mat unpack_mask_bits(const uint8_t* bits, int rows, int cols) {
+    cv::Mat mask(rows, cols, CV_8UC1);
+    size_t bit = 0;
+    for (int r = 0; r < rows; ++r) {
+        uint8_t* row = mask.ptr<uint8_t>(r);
+        for (int c = 0; c < cols; ++c, ++bit) {
+            row[c] = (bits[bit >> 3] & (0x80u >> (bit & 7))) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+void encode_results(const std::vector<YoloResults>& results, std::vector<uint8_t>& out) {
+    put<uint32_t>(out, static_cast<uint32_t>(results.size()));
+    for (const YoloResults& result : results) {
+        put<int32_t>(out, result.class_idx);
+        put<float>(out, result.conf);
+        put<float>(out, result.bbox.x);
+        put<float>(out, result.bbox.y);
+        put<float>(out, result.bbox.width);
+        put<float>(out, result.bbox.height);
+
+        if (result.keypoints.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("encode_results: too many keypoint values: " + std::to_string(result.keypoints.size()));
+        }
+        put<uint16_t>(out, static_cast<uint16_t>(result.keypoints.size()));
+        for (float value : result.keypoints) {
+            put<float>(out, value);
+        }
+
+        const bool has_mask = !result.mask.empty();
+        if (has_mask && (result.mask.rows > std::numeric_limits<uint16_t>::max() || result.mask.cols > std::numeric_limits<uint16_t>::max())) {
+            throw std::runtime_error("encode_results: mask of " + std::to_string(result.mask.cols) + "x"
+                                     + std::to_string(result.mask.rows) + " exceeds the format's 65535 px per side");
+        }
+        put<uint16_t>(out, static_cast<uint16_t>(has_mask ? result.mask.rows : 0));
+        put<uint16_t>(out, static_cast<uint16_t>(has_mask ? result.mask.cols : 0));
+        if (has_mask) {
+            pack_mask_bits(result.mask, out);
+        }
+    }
+}
+
+size_t decode_results(const uint8_t* data, size_t size, std::vector<YoloResults>& results) {
+    size_t pos = 0;
+    const uint32_t count = take<uint32_t>(data, size, pos);
+    // the count comes off the wire: don't reserve more results than the remaining bytes can hold
+    if (count > (size - pos) / MIN_RESULT_BYTES) {
+        throw std::runtime_error("decode_results: " + std::to_string(count) + " results can't fit in "
+                                 + std::to_string(size - pos) + " bytes");
+    }
+    results.clear();
+    results.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        YoloResults result;
+        result.class_idx = take<int32_t>(data, size, pos);
+        result.conf = take<float>(data, size, pos);
+        result.bbox.x = take<float>(data, size, pos);
+        result.bbox.y = take<float>(data, size, pos);
+        result.bbox.width = take<float>(data, size, pos);
+        result.bbox.height = take<float>(data, size, pos);
+
+        const uint16_t kpts_num = take<uint16_t>(data, size, pos);
+        if (static_cast<size_t>(kpts_num) * sizeof(float) > size - pos) {
+            throw std::runtime_error("decode_results: truncated keypoints at byte " + std::to_string(pos));
+        }
+        result.keypoints.resize(kpts_num);
+        for (uint16_t k = 0; k < kpts_num; ++k) {
+            result.keypoints[k] = take<float>(data, size, pos);
+        }
+
+        const int rows = take<uint16_t>(data, size, pos);
+        const int cols = take<uint16_t>(data, size, pos);
+        if (rows > 0 && cols > 0) {
+            const size_t mask_bytes = (static_cast<size_t>(rows) * cols + 7) / 8;
+            if (pos + mask_bytes > size) {
+                throw std::runtime_error("decode_results: truncated mask at byte " + std::to_string(pos));
+            }
+            result.mask = unpack_mask_bits(data + pos, rows, cols);
+            pos += mask_bytes;
+        }
+        results.push_back(std::move(result));
+    }
+    return pos;
+}
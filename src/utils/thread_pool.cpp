@@ -0,0 +1,145 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "utils/affinity.h"
+
+
+namespace {
+    // pool whose worker is running on this thread, used to run nested parallel_for() calls inline
+    thread_local const ThreadPool* current_pool = nullptr;
+
+    std::mutex global_mutex;
+    size_t global_threads = 0;
+    bool global_created = false;
+}
+
+
+ThreadPool::ThreadPool(size_t threads)
+    : ThreadPool(threads, std::vector<int>()) {
+}
+
+ThreadPool::ThreadPool(size_t threads, const std::vector<int>& cpus) {
+    if (threads == 0) {
+        threads = cpus.empty() ? std::max<size_t>(1, std::thread::hardware_concurrency()) : cpus.size();
+    }
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::worker, this, cpus);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers_.size();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool* pool = [] {
+        std::lock_guard<std::mutex> lock(global_mutex);
+        global_created = true;
+        return new ThreadPool(global_threads);  // intentionally leaked: usable until the very end of the process
+    }();
+    return *pool;
+}
+
+bool ThreadPool::configureGlobal(size_t threads) {
+    std::lock_guard<std::mutex> lock(global_mutex);
+    if (global_created) {
+        return false;
+    }
+    global_threads = threads;
+    return true;
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t begin, size_t end)>& body, size_t min_chunk) {
+    if (count == 0) {
+        return;
+    }
+    min_chunk = std::max<size_t>(1, min_chunk);
+    const size_t max_chunks = (count + min_chunk - 1) / min_chunk;
+    const size_t participants = std::min(max_chunks, workers_.size() + 1);
+    if (participants <= 1 || current_pool == this) {
+        body(0, count);
+        return;
+    }
+
+    // participants pull chunks from a shared counter instead of getting a fixed share, so one expensive item
+    // (a huge mask, a large image) doesn't leave the others idle
+    std::atomic<size_t> next{ 0 };
+    std::atomic<bool> failed{ false };
+    auto drain = [&]() {
+        size_t begin;
+        while (!failed.load(std::memory_order_relaxed) && (begin = next.fetch_add(min_chunk)) < count) {
+            body(begin, std::min(count, begin + min_chunk));
+        }
+    };
+    std::vector<std::future<void>> pending;
+    pending.reserve(participants - 1);
+    for (size_t i = 1; i < participants; ++i) {
+        pending.push_back(submit([&drain, &failed] {
+            try {
+                drain();
+            }
+            catch (...) {
+                failed.store(true);
+                throw;
+            }
+        }));
+    }
+
+    // the caller drains too instead of idling
+    std::exception_ptr error;
+    try {
+        drain();
+    }
+    catch (...) {
+        failed.store(true);
+        error = std::current_exception();
+    }
+    for (std::future<void>& future : pending) {
+        try {
+            future.get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::worker(const std::vector<int>& cpus) {
+    current_pool = this;
+    if (!cpus.empty()) {
+        pin_current_thread(cpus);
+    }
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;  // stopping and drained
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,207 @@
+#include "utils/tuning_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace {
+    // fingerprint \t cpu \t provider \t key=value ...
+    std::string format_entry(const std::string& fingerprint, const std::string& cpu, const std::string& provider,
+                             const TunedConfig& config) {
+        std::ostringstream line;
+        line << fingerprint << '\t' << cpu << '\t' << provider << '\t' << "intra=" << config.intra_op_threads
+             << " parallel=" << (config.parallel_execution ? 1 : 0) << " batch=" << config.batch_size
+             << " depth=" << config.pipeline_depth << " ips=" << config.images_per_second;
+        return line.str();
+    }
+
+    bool parse_settings(const std::string& settings, TunedConfig& config) {
+        std::istringstream tokens(settings);
+        std::string token;
+        while (tokens >> token) {
+            const size_t eq = token.find('=');
+            if (eq == std::string::npos) {
+                return false;
+            }
+            const std::string key = token.substr(0, eq);
+            const std::string value = token.substr(eq + 1);
+            if (key == "intra") {
+                config.intra_op_threads = std::stoi(value);
+            }
+            else if (key == "parallel") {
+                config.parallel_execution = value == "1";
+            }
+            else if (key == "batch") {
+                config.batch_size = std::stoi(value);
+            }
+            else if (key == "depth") {
+                config.pipeline_depth = std::stoi(value);
+            }
+            else if (key == "ips") {
+                config.images_per_second = std::stod(value);
+            }
+        }
+        return true;
+    }
+
+    // rewrites `path` through a temporary file, so readers never see half of it
+    void replace_file(const std::string& path, const std::vector<std::string>& lines) {
+        const std::filesystem::path target(path);
+        if (target.has_parent_path()) {
+            std::filesystem::create_directories(target.parent_path());
+        }
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            for (const std::string& line : lines) {
+                out << line << '\n';
+            }
+            if (!out) {
+                throw std::runtime_error("TuningCache: cannot write " + temp);
+            }
+        }
+        std::filesystem::rename(temp, target);
+    }
+}
+
+
+std::string model_fingerprint(const std::string& model_path) {
+    std::ifstream file(model_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("model_fingerprint: cannot read " + model_path);
+    }
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> buffer(1 << 20);
+    while (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0) {
+        const std::streamsize n = file.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+        }
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+std::string cpu_signature() {
+    std::string model = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        // x86: "model name", most ARM kernels: "Model" or "Hardware"
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, colon);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        const size_t value = line.find_first_not_of(" \t", colon + 1);
+        if ((key == "model name" || key == "Model" || key == "Hardware") && value != std::string::npos) {
+            model = line.substr(value);
+            break;
+        }
+    }
+    return model + " x" + std::to_string(std::thread::hardware_concurrency());
+}
+
+std::string default_tuning_cache_path() {
+    std::filesystem::path dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+        dir = std::filesystem::path(xdg) / "helmsman";
+    }
+    else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        dir = std::filesystem::path(home) / ".cache" / "helmsman";
+    }
+    return (dir / "autotune.tsv").string();
+}
+
+
+TuningCache::TuningCache(const std::string& path)
+    : path_(path) {
+}
+
+bool TuningCache::lookup(const std::string& fingerprint, const std::string& cpu, const std::string& provider,
+                         TunedConfig& config) const {
+    std::ifstream file(path_);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string entry_fingerprint, entry_cpu, entry_provider, settings;
+        if (std::getline(fields, entry_fingerprint, '\t') && std::getline(fields, entry_cpu, '\t')
+            && std::getline(fields, entry_provider, '\t') && std::getline(fields, settings)
+            && entry_fingerprint == fingerprint && entry_cpu == cpu && entry_provider == provider) {
+            TunedConfig parsed;
+            if (parse_settings(settings, parsed)) {
+                config = parsed;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TuningCache::store(const std::string& fingerprint, const std::string& cpu, const std::string& provider,
+                        const TunedConfig& config) const {
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path_);
+        std::string line;
+        const std::string prefix = fingerprint + '\t' + cpu + '\t' + provider + '\t';
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.compare(0, prefix.size(), prefix) != 0) {
+                lines.push_back(line);
+            }
+        }
+    }
+    lines.push_back(format_entry(fingerprint, cpu, provider, config));
+    replace_file(path_, lines);
+}
+
+std::string TuningCache::fingerprint(const std::string& model_path) const {
+    // absolute path \t size \t mtime \t fingerprint
+    std::error_code error;
+    const std::string path = std::filesystem::absolute(model_path, error).string();
+    const uintmax_t size = std::filesystem::file_size(model_path, error);
+    if (error) {
+        return model_fingerprint(model_path);  // throws with a proper message
+    }
+    const auto mtime = std::filesystem::last_write_time(model_path, error).time_since_epoch().count();
+    const std::string key = path + '\t' + std::to_string(size) + '\t' + std::to_string(mtime) + '\t';
+
+    const std::string models_path = path_ + ".models";
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(models_path);
+        std::string line;
+        const std::string path_prefix = path + '\t';
+        while (std::getline(file, line)) {
+            if (line.compare(0, key.size(), key) == 0) {
+                return line.substr(key.size());
+            }
+            if (!line.empty() && line.compare(0, path_prefix.size(), path_prefix) != 0) {
+                lines.push_back(line);  // other models; a stale entry of this one is dropped
+            }
+        }
+    }
+    const std::string hash = model_fingerprint(model_path);
+    lines.push_back(key + hash);
+    try {
+        replace_file(models_path, lines);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Warning: cannot remember the model fingerprint: " << e.what() << std::endl;
+    }
+    return hash;
+}
+
+const std::string& TuningCache::getPath() const {
+    return path_;
+}